@@ -0,0 +1,133 @@
+# frozen_string_literal: true
+
+=begin
+Measures how quickly Puma serves bursts of new connections, all connecting at
+the same time, as with a load balancer reconnecting or a thundering herd.
+Doesn't need hey or wrk, one Ruby thread opens the connections with
+non-blocking connects, sends the requests, and reads the responses.
+
+From the repo root:
+
+ruby -Ilib benchmarks/local/accept_burst.rb
+ruby -Ilib benchmarks/local/accept_burst.rb -w2 -t5 -n500 -b20
+
+-w Puma workers, default 0
+-t Puma max threads per worker, default 5
+-n connections per burst, default 200
+-b bursts, default 50
+-C extra Puma config file
+
+Run it on each git ref being compared, with the same arguments.  Times are in
+milliseconds, 'burst' is the time from the first connect until the last
+response of a burst, 'conn' the time from the first connect until each
+response.
+=end
+
+require 'optparse'
+require 'socket'
+
+module AcceptBurst
+
+  CLK_MONO = Process::CLOCK_MONOTONIC
+
+  HOST = '127.0.0.1'
+
+  REQ = "GET / HTTP/1.1\r\nHost: #{HOST}\r\nConnection: close\r\n\r\n"
+
+  class << self
+    def run
+      opts = { workers: 0, threads: 5, conns: 200, bursts: 50 }
+      OptionParser.new do |o|
+        o.on('-w N', Integer) { |v| opts[:workers] = v }
+        o.on('-t N', Integer) { |v| opts[:threads] = v }
+        o.on('-n N', Integer) { |v| opts[:conns] = v }
+        o.on('-b N', Integer) { |v| opts[:bursts] = v }
+        o.on('-C PATH')       { |v| opts[:config] = v }
+      end.parse!
+
+      port = TCPServer.open(HOST, 0) { |s| s.addr[1] }
+      pid = start_puma opts, port
+      addr = Socket.sockaddr_in port, HOST
+
+      begin
+        bursts = []
+        conns = []
+        opts[:bursts].times do
+          times = burst addr, opts[:conns]
+          bursts << times.max
+          conns.concat times
+        end
+      ensure
+        Process.kill :TERM, pid
+        Process.wait pid
+      end
+
+      report opts, bursts.sort!, conns.sort!
+    end
+
+    def start_puma(opts, port)
+      config = opts[:config] ? "-C #{opts[:config]}" : ''
+      cmd = "#{Gem.ruby} -Ilib bin/puma -q -w #{opts[:workers]} -t #{opts[:threads]}:#{opts[:threads]} " \
+        "#{config} -b tcp://#{HOST}:#{port} test/rackup/hello.ru"
+      pid = spawn cmd, out: File::NULL, err: File::NULL
+
+      t_end = Process.clock_gettime(CLK_MONO) + 30
+      until Process.clock_gettime(CLK_MONO) > t_end
+        begin
+          TCPSocket.open(HOST, port) { |s| s.syswrite REQ; s.read }
+          sleep 1 # let all workers boot
+          return pid
+        rescue SystemCallError
+          sleep 0.1
+        end
+      end
+      raise 'Puma failed to boot'
+    end
+
+    # @return [Array<Float>] the time until each response was read
+    def burst(addr, count)
+      t_st = Process.clock_gettime CLK_MONO
+      socks = Array.new(count) do
+        sock = Socket.new :INET, :STREAM
+        sock.connect_nonblock addr, exception: false
+        sock
+      end
+
+      writing = socks.dup
+      until writing.empty?
+        _, writable = IO.select nil, writing, nil, 10
+        raise 'timeout connecting' unless writable
+        writable.each do |sock|
+          sock.syswrite REQ
+          writing.delete sock
+        end
+      end
+
+      times = []
+      reading = socks
+      until reading.empty?
+        readable, = IO.select reading, nil, nil, 10
+        raise 'timeout reading' unless readable
+        readable.each do |sock|
+          next unless sock.read_nonblock(16_384, exception: false).nil?
+
+          times << Process.clock_gettime(CLK_MONO) - t_st
+          sock.close
+          reading.delete sock
+        end
+      end
+      times
+    end
+
+    def report(opts, bursts, conns)
+      pct = ->(ary, p) { 1000 * ary[(p * ary.length).floor.clamp(0, ary.length - 1)] }
+      ref = %x[git log -1 --format=format:%h].strip
+
+      STDOUT.syswrite format("%s -w%d -t%d -n%d  %6.0f conn/s   burst p50 %7.2f   p90 %7.2f   " \
+        "conn p50 %7.2f   p99 %7.2f\n", ref, opts[:workers], opts[:threads], opts[:conns],
+        conns.length / bursts.sum, pct[bursts, 0.5], pct[bursts, 0.9], pct[conns, 0.5], pct[conns, 0.99])
+    end
+  end
+end
+
+AcceptBurst.run
@@ -0,0 +1,102 @@
+# frozen_string_literal: true
+
+=begin
+Compares request latency of `Puma::ThreadPool` with and without the
+`adaptive_threads` option, for work bound by Ruby code, where more threads
+only share the GVL between more requests.  Requests arrive at random at a
+fixed average rate, each runs a busy loop and then sleeps, like a request
+waiting on a database.
+
+From the repo root:
+
+ruby -Ilib benchmarks/local/adaptive_threads.rb
+ruby -Ilib benchmarks/local/adaptive_threads.rb -t16 -r40 -c0.02 -i0.005
+
+-t max threads, default 16
+-r requests per second, default 12
+-c CPU seconds per request, default 0.05
+-i IO (sleep) seconds per request, default 0
+-D duration in seconds, default 20
+-a target p99 queue delay in seconds for `adaptive_threads`, default 0.025
+
+The adaptive pool starts at max threads, like the other, the first seconds
+are spent finding the number of threads.  Latencies are in milliseconds.
+Needs Ruby 3.3 or later.
+=end
+
+require 'optparse'
+require 'puma'
+require 'puma/puma_http11'
+require 'puma/thread_pool'
+
+module AdaptiveThreads
+
+  CLK_MONO = Process::CLOCK_MONOTONIC
+
+  class << self
+    def run
+      opts = { threads: 16, rate: 12.0, cpu: 0.05, io: 0.0, duration: 20.0, target: 0.025 }
+      OptionParser.new do |o|
+        o.on('-t N', Integer) { |v| opts[:threads] = v }
+        o.on('-r N', Float)   { |v| opts[:rate] = v }
+        o.on('-c N', Float)   { |v| opts[:cpu] = v }
+        o.on('-i N', Float)   { |v| opts[:io] = v }
+        o.on('-D N', Float)   { |v| opts[:duration] = v }
+        o.on('-a N', Float)   { |v| opts[:target] = v }
+      end.parse!
+
+      unless Puma::QueueDelayController.available?
+        STDOUT.syswrite "Puma::GVLMeter isn't available, needs Ruby 3.3 or later\n"
+        exit 1
+      end
+
+      [nil, opts[:target]].each do |target|
+        latencies, max = load_pool opts, target
+        report opts, target, latencies, max
+      end
+    end
+
+    # @return [Array(Array<Float>, Integer)] the latencies, and the max threads
+    #   at the end
+    def load_pool(opts, target)
+      done = Queue.new
+      options = { min_threads: 1, max_threads: opts[:threads], adaptive_threads: target }
+      pool = Puma::ThreadPool.new('bench', options) do |_, t_st|
+        t_end = Process.clock_gettime(CLK_MONO) + opts[:cpu]
+        nil while Process.clock_gettime(CLK_MONO) < t_end
+        sleep opts[:io] if opts[:io] > 0
+        done << Process.clock_gettime(CLK_MONO) - t_st
+      end
+      pool.auto_adapt!
+
+      rnd = Random.new 1234
+      requests = 0
+      t_st = Process.clock_gettime CLK_MONO
+      next_at = t_st
+      while (now = Process.clock_gettime(CLK_MONO)) < t_st + opts[:duration]
+        if now < next_at
+          sleep next_at - now
+          next
+        end
+        pool << next_at
+        requests += 1
+        next_at += -Math.log(1.0 - rnd.rand) / opts[:rate]
+      end
+
+      max = pool.max
+      pool.shutdown(-1)
+      [Array.new(requests) { done.pop }.sort!, max]
+    end
+
+    def report(opts, target, latencies, max)
+      pct = ->(p) { 1000 * latencies[(p * latencies.length).floor.clamp(0, latencies.length - 1)] }
+      ref = %x[git log -1 --format=format:%h].strip
+      mode = target ? format('adaptive %.3f', target) : 'fixed         '
+
+      STDOUT.syswrite format("%s -t%d -r%.0f  %s  max %2d   p50 %7.2f   p90 %7.2f   " \
+        "p99 %7.2f\n", ref, opts[:threads], opts[:rate], mode, max, pct[0.5], pct[0.9], pct[0.99])
+    end
+  end
+end
+
+AdaptiveThreads.run
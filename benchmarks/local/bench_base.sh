@@ -10,6 +10,7 @@
 # -d app delay
 #
 # -s Puma bind socket type, default ssl, also tcp or unix
+# -P Puma bind with reuse_port, tcp and ssl only
 # -t Puma threads
 # -w Puma workers
 # -r Puma rackup file
@@ -33,7 +34,7 @@ if [ -z "$PUMA_TEST_STATE" ]; then export PUMA_TEST_STATE=tmp/bench_test_puma.st
 
 export PUMA_CTRL=$PUMA_TEST_HOST4:$PUMA_TEST_CTRL
 
-while getopts :b:C:c:D:d:kR:r:s:T:t:w:Y option
+while getopts :b:C:c:D:d:kPR:r:s:T:t:w:Y option
 do
 case "${option}" in
 #———————————————————— RUBY options
@@ -43,6 +44,7 @@ C) conf=${OPTARG};;
 t) threads=${OPTARG};;
 w) workers=${OPTARG};;
 r) rackup_file=${OPTARG};;
+P) reuse_port=true;;
 #———————————————————— app/common options
 b) body_conf=${OPTARG};;
 s) skt_type=${OPTARG};;
@@ -171,6 +173,13 @@ case $skt_type in
   ;;
 esac
 
+if [ -n "$reuse_port" ]; then
+  case $skt_type in
+    ssl*) bind="$bind&reuse_port=true";;
+    tcp*) bind="$bind?reuse_port=true";;
+  esac
+fi
+
 StartPuma()
 {
   if [ -n "$1" ]; then
@@ -0,0 +1,125 @@
+# frozen_string_literal: true
+
+=begin
+Measures request latency percentiles of a Puma cluster, for comparing how
+workers share new connections.  Doesn't need hey or wrk, the clients are Ruby
+threads, each opening a new connection per request.
+
+From the repo root:
+
+ruby -Ilib benchmarks/local/cluster_accept_balance.rb
+ruby -Ilib benchmarks/local/cluster_accept_balance.rb -w4 -t5 -c24 -D10
+
+-w Puma workers, default 4
+-t Puma max threads per worker, default 5
+-c client threads, default workers * threads
+-D duration in seconds, default 10
+-d app delay in seconds, default 0.005, every 20th request sleeps 10 times longer
+-C extra Puma config file
+
+Run it on each git ref being compared, with the same arguments.  Percentiles
+are in milliseconds, 'spread' is the requests served by the busiest worker
+divided by those served by the least busy one.
+=end
+
+require 'optparse'
+require 'socket'
+
+module ClusterAcceptBalance
+
+  CLK_MONO = Process::CLOCK_MONOTONIC
+
+  HOST = '127.0.0.1'
+
+  class << self
+    def run
+      opts = { workers: 4, threads: 5, duration: 10.0, delay: 0.005 }
+      OptionParser.new do |o|
+        o.on('-w N', Integer) { |v| opts[:workers] = v }
+        o.on('-t N', Integer) { |v| opts[:threads] = v }
+        o.on('-c N', Integer) { |v| opts[:clients] = v }
+        o.on('-D N', Float)   { |v| opts[:duration] = v }
+        o.on('-d N', Float)   { |v| opts[:delay] = v }
+        o.on('-C PATH')       { |v| opts[:config] = v }
+      end.parse!
+      opts[:clients] ||= opts[:workers] * opts[:threads]
+
+      port = TCPServer.open(HOST, 0) { |s| s.addr[1] }
+      pid = start_puma opts, port
+
+      begin
+        latencies, pids = load_clients opts, port
+      ensure
+        Process.kill :TERM, pid
+        Process.wait pid
+      end
+
+      report opts, latencies, pids
+    end
+
+    def start_puma(opts, port)
+      config = opts[:config] ? "-C #{opts[:config]}" : ''
+      cmd = "#{Gem.ruby} -Ilib bin/puma -q -w #{opts[:workers]} -t #{opts[:threads]}:#{opts[:threads]} " \
+        "#{config} -b tcp://#{HOST}:#{port} test/rackup/sleep_pid.ru"
+      pid = spawn cmd, out: File::NULL, err: File::NULL
+
+      t_end = Process.clock_gettime(CLK_MONO) + 30
+      until Process.clock_gettime(CLK_MONO) > t_end
+        begin
+          request port, 0
+          sleep 1 # let all workers boot
+          return pid
+        rescue SystemCallError
+          sleep 0.1
+        end
+      end
+      raise 'Puma failed to boot'
+    end
+
+    # @return [Array(Array<Float>, Hash)] the latencies, requests per worker pid
+    def load_clients(opts, port)
+      t_end = Process.clock_gettime(CLK_MONO) + opts[:duration]
+      threads = Array.new(opts[:clients]) do |i|
+        Thread.new do
+          latencies = []
+          pids = Hash.new 0
+          n = i
+          while Process.clock_gettime(CLK_MONO) < t_end
+            delay = (n += 1) % 20 == 0 ? 10 * opts[:delay] : opts[:delay]
+            t_st = Process.clock_gettime CLK_MONO
+            pids[request(port, delay)] += 1
+            latencies << Process.clock_gettime(CLK_MONO) - t_st
+          end
+          [latencies, pids]
+        end
+      end
+
+      results = threads.map(&:value)
+      pids = results.map(&:last).inject { |a, b| a.merge(b) { |_, x, y| x + y } }
+      [results.flat_map(&:first).sort!, pids]
+    end
+
+    # @return [String] the pid of the worker
+    def request(port, delay)
+      socket = TCPSocket.new HOST, port
+      socket.syswrite "GET /sleep#{delay} HTTP/1.1\r\nHost: #{HOST}\r\nConnection: close\r\n\r\n"
+      body = socket.read.split("\r\n\r\n", 2).last
+      body[/\ASlept \S+ (\d+)\z/, 1] || raise("unexpected response: #{body}")
+    ensure
+      socket&.close
+    end
+
+    def report(opts, latencies, pids)
+      pct = ->(p) { 1000 * latencies[(p * latencies.length).floor.clamp(0, latencies.length - 1)] }
+      ref = %x[git log -1 --format=format:%h].strip
+      spread = pids.values.max.to_f / pids.values.min
+
+      STDOUT.syswrite format("%s -w%d -t%d -c%d  %6.0f req/s   p50 %6.2f   p90 %6.2f   " \
+        "p99 %6.2f   p99.9 %7.2f   spread %4.2f\n", ref, opts[:workers], opts[:threads],
+        opts[:clients], latencies.length / opts[:duration], pct[0.5], pct[0.9], pct[0.99],
+        pct[0.999], spread)
+    end
+  end
+end
+
+ClusterAcceptBalance.run
@@ -0,0 +1,101 @@
+# frozen_string_literal: true
+
+=begin
+Micro-benchmark for `Puma::Compression`, compares the time to gzip a
+response body with `Zlib::GzipWriter` writing each part and flushing, as
+`Rack::Deflater` does, with `Puma::Compression#compress` for Array bodies,
+and with `Puma::Compression::Body` for streamed bodies.  Each is run on one
+thread, and on `-t` threads at once, where the time is per response of all
+threads.
+
+Compile the extension, then from the repo root:
+
+ruby -Ilib benchmarks/local/compression.rb
+ruby -Ilib benchmarks/local/compression.rb -t8 -n200
+
+-t threads, default 4
+-n responses per body size and thread, default 100
+
+Bodies are HTML made of 4 kB parts, parts of 16 kB and larger are compressed
+without the GVL by `Puma::Compressor`.
+=end
+
+require 'optparse'
+require 'stringio'
+require 'zlib'
+require 'puma'
+require 'puma/puma_http11'
+require 'puma/compression'
+
+module CompressionBench
+
+  CLK_MONO = Process::CLOCK_MONOTONIC
+
+  PART = (<<~HTML * 20).byteslice(0, 4_096)
+    <tr class="row"><td><a href="/products/42">Product 42</a></td><td>$19.99</td></tr>
+    <tr class="row odd"><td><a href="/products/43">Product 43</a></td><td>$24.50</td></tr>
+  HTML
+
+  SIZES = { '4 kB' => 1, '64 kB' => 16, '1 MB' => 256 }.freeze
+
+  class << self
+    def run
+      opts = { threads: 4, count: 100 }
+      OptionParser.new do |o|
+        o.on('-t N', Integer) { |v| opts[:threads] = v }
+        o.on('-n N', Integer) { |v| opts[:count] = v }
+      end.parse!
+
+      unless defined?(Puma::Compressor)
+        STDOUT.syswrite "Puma::Compressor isn't available\n"
+        exit 1
+      end
+
+      compression = Puma::Compression.new
+      ways = {
+        'deflater' => ->(body) { deflater body },
+        'array'    => ->(body) { compression.compress body, 'gzip' },
+        'stream'   => ->(body) { stream body },
+      }
+
+      STDOUT.syswrite "Body     Parts  Way        µs 1 thread   µs #{opts[:threads]} threads\n"
+      SIZES.each do |name, parts|
+        # in 4 kB parts, and in one part
+        [Array.new(parts) { PART.dup }, [PART * parts]].uniq(&:length).each do |body|
+          ways.each do |way, compress|
+            t1 = time(1, opts[:count]) { compress.call body }
+            tn = time(opts[:threads], opts[:count]) { compress.call body }
+            STDOUT.syswrite format("%-7s  %5d  %-8s  %12.0f   %12.0f\n", name, body.length, way, t1, tn)
+          end
+        end
+      end
+    end
+
+    # @return [Float] µs per response
+    def time(threads, count, &block)
+      t_st = Process.clock_gettime CLK_MONO
+      Array.new(threads) { Thread.new { count.times(&block) } }.each(&:join)
+      1_000_000.0 * (Process.clock_gettime(CLK_MONO) - t_st) / (threads * count)
+    end
+
+    # like Rack::Deflater::GzipStream
+    def deflater(body)
+      io = StringIO.new(+'')
+      gzip = Zlib::GzipWriter.new io
+      body.each do |part|
+        gzip.write part
+        gzip.flush
+      end
+      gzip.close
+      io.string
+    end
+
+    def stream(body)
+      out = +''
+      Puma::Compression::Body.new(body.each, Puma::Compressor.new('gzip'), false).each { |part| out << part }
+      out
+    end
+  end
+end
+
+CompressionBench.run
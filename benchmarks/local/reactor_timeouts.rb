@@ -0,0 +1,105 @@
+# frozen_string_literal: true
+
+=begin
+Micro-benchmark for the client timeouts kept by `Puma::Reactor`, reports the
+cost per registration and per timeout with 1k, 10k and 100k idle keep-alive
+connections already in the reactor.
+
+From the repo root:
+
+ruby -Ilib benchmarks/local/reactor_timeouts.rb
+ruby -Ilib benchmarks/local/reactor_timeouts.rb 20000
+
+The optional argument is the number of registrations and timeouts measured.
+
+'heap' is `Puma::TimeoutHeap`, 'array' is the sorted Array the reactor used
+before, kept here for comparison.  Each registration is a client that was
+woken for a request and is added back, as keep-alive clients are.  Only the
+timeout bookkeeping is measured, not NIO.
+=end
+
+require 'puma/timeout_heap'
+
+module ReactorTimeouts
+
+  CLK_MONO = Process::CLOCK_MONOTONIC
+
+  Client = Struct.new :timeout_at
+
+  # The reactor before `Puma::TimeoutHeap`, sorted once per select loop
+  # after new clients arrive
+  class SortedArray
+    def initialize
+      @timeouts = []
+      @sorted = true
+    end
+
+    def add(client)
+      @timeouts << client
+      @sorted = false
+    end
+
+    def delete(client)
+      @timeouts.delete client
+    end
+
+    def next_timeout_at
+      unless @sorted
+        @timeouts.sort_by!(&:timeout_at)
+        @sorted = true
+      end
+      @timeouts.first&.timeout_at
+    end
+
+    def pop_expired(now)
+      next_timeout_at
+      timed_out = @timeouts.take_while { |client| client.timeout_at <= now }
+      timed_out.each { |client| @timeouts.delete client }
+    end
+  end
+
+  class << self
+    def run(loops)
+      STDOUT.syswrite "Type    Clients   ns/registration   ns/timeout\n"
+      [1_000, 10_000, 100_000].each do |size|
+        { 'heap' => Puma::TimeoutHeap, 'array' => SortedArray }.each do |name, klass|
+          # the array is slow with many clients, measure fewer
+          n = name == 'array' ? [loops, 10_000_000 / size].min : loops
+          reg, tmo = measure klass, size, n
+          STDOUT.syswrite format("%-6s  %7d   %15.0f   %10.0f\n", name, size, reg, tmo)
+        end
+      end
+    end
+
+    # @return [Array<Float>] ns per registration and per timeout
+    def measure(klass, size, loops)
+      timeouts = klass.new
+      clients = Array.new(size) { |i| Client.new(1_000.0 + i) }
+      clients.each { |c| timeouts.add c }
+      timeouts.next_timeout_at
+
+      # a random idle client makes a request, is deleted, then added back
+      # with a new keep-alive timeout
+      now = 2_000.0
+      t_st = Process.clock_gettime CLK_MONO
+      loops.times do |i|
+        client = clients[rand(size)]
+        timeouts.delete client
+        client.timeout_at = now + i
+        timeouts.add client
+        timeouts.next_timeout_at # each pass of the select loop
+      end
+      reg = Process.clock_gettime(CLK_MONO) - t_st
+
+      # clients time out one at a time
+      expire = clients.map(&:timeout_at).sort.first(loops)
+      t_st = Process.clock_gettime CLK_MONO
+      expire.each { |at| timeouts.pop_expired at }
+      tmo = Process.clock_gettime(CLK_MONO) - t_st
+
+      [1_000_000_000.0 * reg / loops, 1_000_000_000.0 * tmo / expire.length]
+    end
+  end
+end
+
+ReactorTimeouts.run (ARGV[0] || 10_000).to_i
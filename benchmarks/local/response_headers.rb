@@ -0,0 +1,101 @@
+# frozen_string_literal: true
+
+=begin
+Micro-benchmark for `Puma::Response#str_headers`, reports the time spent
+writing the status line and headers of a response, with the Ruby code, with
+`Puma::NativeHeaders`, and with its `LineCache`, and the objects allocated
+per response.
+
+Compile the extension, then from the repo root:
+
+ruby -Ilib benchmarks/local/response_headers.rb
+ruby -Ilib benchmarks/local/response_headers.rb 500000
+
+The optional argument is the number of responses written per header set,
+the responses cycle through the statuses 200, 404 and 304.
+
+The 'realistic' set is the one of test/rackup/realistic_response.ru, see
+benchmarks/wrk/realistic_response.sh, its values aren't frozen so the cache
+doesn't apply.  The values of the other sets are frozen literals.
+=end
+
+require 'securerandom'
+require 'puma'
+require 'puma/server'
+
+module ResponseHeaders
+
+  CLK_MONO = Process::CLOCK_MONOTONIC
+
+  ENV_11 = { 'REQUEST_METHOD' => 'GET', 'SERVER_PROTOCOL' => 'HTTP/1.1' }.freeze
+
+  RAILS = {
+    'content-type' => 'text/html; charset=utf-8',
+    'cache-control' => 'max-age=0, private, must-revalidate',
+    'etag' => 'W/"5e15153d120f9c2a0b1d5c3c2a118f14"',
+    'x-frame-options' => 'SAMEORIGIN',
+    'x-content-type-options' => 'nosniff',
+    'referrer-policy' => 'strict-origin-when-cross-origin',
+    'x-request-id' => '8f14e45f-ceea-467f-a8f2-0b1d5c3c2a11',
+    'x-runtime' => '0.012345',
+    'set-cookie' => "_session_id=0123456789abcdef; path=/; HttpOnly\ntheme=dark; path=/",
+    'content-length' => '4821',
+  }.freeze
+
+  API = {
+    'Content-Type' => 'application/json',
+    'Content-Length' => '128',
+    'Vary' => ['Accept', 'Origin'],
+  }.freeze
+
+  REALISTIC = Array.new(25) { |i| ["X-My-Header-#{i}", SecureRandom.hex(25)] }.to_h.freeze
+
+  SETS = { 'rails' => RAILS, 'api' => API, 'realistic' => REALISTIC }.freeze
+
+  STATUSES = [200, 404, 304].freeze
+
+  ROUNDS = 5
+
+  class << self
+    def run(loops)
+      server = Puma::Server.new ->(_) {}, nil, { log_writer: Puma::LogWriter.strings }
+      io_buffer = Puma::IOBuffer.new
+      paths = { 'ruby' => [nil, nil] }
+      if Puma::Response::NATIVE_HEADERS
+        paths['native'] = [Puma::Response::Info.new, nil]
+        paths['cached'] = [Puma::Response::Info.new, Puma::NativeHeaders::LineCache.new(256)]
+      end
+
+      STDOUT.syswrite "Set        Path      Headers   ns/response   objects\n"
+      SETS.each do |name, headers|
+        paths.each do |path, (info, cache)|
+          server.instance_variable_set :@header_cache, cache
+          i = 0
+          write = lambda do
+            status = STATUSES[(i += 1) % STATUSES.size]
+            server.send :str_headers, ENV_11, status, headers, nil, io_buffer, true, info
+            io_buffer.reset
+          end
+
+          # warm up
+          10_000.times { write.call }
+
+          # the fastest of ROUNDS, the others are more likely to be slowed
+          # down by other processes
+          objects = GC.stat :total_allocated_objects
+          time = Array.new(ROUNDS) do
+            t_st = Process.clock_gettime CLK_MONO
+            (loops / ROUNDS).times { write.call }
+            Process.clock_gettime(CLK_MONO) - t_st
+          end.min
+          objects = GC.stat(:total_allocated_objects) - objects
+
+          STDOUT.syswrite format("%-9s  %-8s  %7d   %11.0f   %7.1f\n", name, path, headers.size,
+            1_000_000_000.0 * time * ROUNDS / loops, objects.to_f / loops)
+        end
+      end
+    end
+  end
+end
+
+ResponseHeaders.run (ARGV[0] || 200_000).to_i
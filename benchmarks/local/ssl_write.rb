@@ -0,0 +1,114 @@
+# frozen_string_literal: true
+
+=begin
+Micro-benchmark for `Puma::MiniSSL::Engine#write` and `#extract`, the TLS
+encryption of responses.  Each thread has its own engine, connected to an
+OpenSSL client, and encrypts bodies as `MiniSSL::Socket#write` does, the
+encrypted data is discarded.
+
+Compile the extension, then from the repo root:
+
+ruby -Ilib benchmarks/local/ssl_write.rb
+ruby -Ilib benchmarks/local/ssl_write.rb -t8 -n200
+
+-t threads, default 4
+-n bodies per thread, default 100
+
+The 'mixed' rows run one thread writing 1 kB bodies while the others write
+1 MB bodies, like benchmarks/wrk/ssl_realistic_response.sh with large
+responses among the small ones.  They report the time per small body, which
+grows while the large ones are encrypted with the GVL held.
+=end
+
+require 'optparse'
+require 'openssl'
+require 'socket'
+require 'puma'
+require 'puma/minissl'
+
+module SSLWriteBench
+
+  CLK_MONO = Process::CLOCK_MONOTONIC
+
+  SIZES = { '1 kB' => 1_024, '16 kB' => 1_024 * 16, '1 MB' => 1_024 * 1_024 }.freeze
+
+  class << self
+    def run
+      opts = { threads: 4, count: 100 }
+      OptionParser.new do |o|
+        o.on('-t N', Integer) { |v| opts[:threads] = v }
+        o.on('-n N', Integer) { |v| opts[:count] = v }
+      end.parse!
+
+      threads = opts[:threads]
+      count = opts[:count]
+      engines = Array.new(threads) { engine }
+
+      STDOUT.syswrite "Body     µs 1 thread   µs #{threads} threads\n"
+      SIZES.each do |name, size|
+        body = Random.bytes size
+        t1 = time(engines.first(1), count) { |e| write e, body }
+        tn = time(engines, count) { |e| write e, body }
+        STDOUT.syswrite format("%-7s  %11.1f   %12.1f\n", name, t1, tn)
+      end
+
+      small = Random.bytes 1_024
+      large = Random.bytes 1_024 * 1_024
+      alone = time(engines.first(1), count * 10) { |e| write e, small }
+      large_threads = engines.drop(1).map do |e|
+        Thread.new { (count / 4).times { write e, large } }
+      end
+      sleep 0.01
+      mixed = time(engines.first(1), count * 10) { |e| write e, small }
+      large_threads.each(&:join)
+      STDOUT.syswrite format("mixed    1 kB alone %8.1f µs, with %d threads writing 1 MB %8.1f µs\n",
+        alone, threads - 1, mixed)
+    end
+
+    # @return [Float] µs per body, of all threads
+    def time(engines, count)
+      t_st = Process.clock_gettime CLK_MONO
+      engines.map { |e| Thread.new { count.times { yield e } } }.each(&:join)
+      1_000_000.0 * (Process.clock_gettime(CLK_MONO) - t_st) / (engines.length * count)
+    end
+
+    # like MiniSSL::Socket#write
+    def write(engine, data)
+      until data.empty?
+        wrote = engine.write data
+        while engine.extract; end
+        data = data.byteslice(wrote..-1)
+      end
+    end
+
+    # @return [Puma::MiniSSL::Engine] after the handshake with a client
+    def engine
+      ctx = Puma::MiniSSL::Context.new
+      ctx.key  = File.expand_path '../../examples/puma/puma_keypair.pem', __dir__
+      ctx.cert = File.expand_path '../../examples/puma/cert_puma.pem', __dir__
+      ctx.verify_mode = Puma::MiniSSL::VERIFY_NONE
+      engine = Puma::MiniSSL::Engine.server Puma::MiniSSL::SSLContext.new(ctx)
+
+      rd, wr = UNIXSocket.pair
+      client_ctx = OpenSSL::SSL::SSLContext.new
+      client_ctx.verify_mode = OpenSSL::SSL::VERIFY_NONE
+      client = OpenSSL::SSL::SSLSocket.new wr, client_ctx
+
+      thread = Thread.new { client.connect }
+      while thread.alive? || rd.wait_readable(0.05)
+        next unless rd.wait_readable 0.05
+        engine.inject rd.read_nonblock(100_000)
+        engine.read
+        while (data = engine.extract)
+          rd.write data
+        end
+      end
+      thread.join
+      client.close
+      rd.close
+      engine
+    end
+  end
+end
+
+SSLWriteBench.run
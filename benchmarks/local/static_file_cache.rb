@@ -0,0 +1,105 @@
+# frozen_string_literal: true
+
+=begin
+Benchmark for `Puma::StaticFileCache`, runs a server whose app answers with
+a `to_path` body, like `Rack::Files`, and reports the time per request of
+one keep-alive client, without the cache, with it, and for conditional
+requests answered with 304 before the app is called.
+
+Compile the extension, then from the repo root:
+
+ruby -Ilib benchmarks/local/static_file_cache.rb
+ruby -Ilib benchmarks/local/static_file_cache.rb 20000
+
+The optional argument is the number of requests per file size and way.
+=end
+
+require 'socket'
+require 'tmpdir'
+require 'puma'
+require 'puma/server'
+
+module StaticFileCacheBench
+
+  CLK_MONO = Process::CLOCK_MONOTONIC
+
+  SIZES = { '1 kB' => 1_024, '16 kB' => 1_024 * 16, '128 kB' => 1_024 * 128 }.freeze
+
+  # like Rack::Files::Iterator, the file is opened in each
+  class FileBody
+    def initialize(path)
+      @path = path
+    end
+
+    def to_path
+      @path
+    end
+
+    def each
+      File.open(@path, 'rb') { |f| while (chunk = f.read 16_384) do yield chunk end }
+    end
+  end
+
+  class << self
+    def run(count)
+      Dir.mktmpdir do |dir|
+        STDOUT.syswrite "File     Way        µs/request\n"
+        SIZES.each do |name, size|
+          path = File.join dir, "#{size}.css"
+          File.write path, 'a' * size
+          app = lambda do |env|
+            stat = File.stat path
+            [200, { 'content-type' => 'text/css', 'content-length' => stat.size.to_s,
+              'last-modified' => stat.mtime.httpdate }, FileBody.new(path)]
+          end
+
+          ways = {
+            'file'   => [{}, nil],
+            'cached' => [{ static_file_cache: {} }, nil],
+            '304'    => [{ static_file_cache: {} }, true],
+          }
+          ways.each do |way, (options, conditional)|
+            STDOUT.syswrite format("%-7s  %-8s  %12.1f\n", name, way, time(app, options, conditional, count))
+          end
+        end
+      end
+    end
+
+    # @return [Float] µs per request
+    def time(app, options, conditional, count)
+      server = Puma::Server.new app, nil, { log_writer: Puma::LogWriter.strings,
+        min_threads: 1, max_threads: 1, max_keep_alive: 2 * count, **options }
+      port = server.add_tcp_listener('127.0.0.1', 0).addr[1]
+      server.run
+
+      socket = TCPSocket.new '127.0.0.1', port
+      request = "GET /app.css HTTP/1.1\r\nHost: localhost\r\n\r\n"
+      etag = get(socket, request)[/^etag: (.+)\r$/, 1]
+      if conditional
+        request = "GET /app.css HTTP/1.1\r\nHost: localhost\r\nIf-None-Match: #{etag}\r\n\r\n"
+        get socket, request
+      end
+
+      (count / 10).times { get socket, request }
+      t_st = Process.clock_gettime CLK_MONO
+      count.times { get socket, request }
+      1_000_000.0 * (Process.clock_gettime(CLK_MONO) - t_st) / count
+    ensure
+      socket&.close
+      server&.stop true
+    end
+
+    # @return [String] the headers
+    def get(socket, request)
+      socket.write request
+      headers = +''
+      headers << socket.readpartial(65_536) until headers.include? "\r\n\r\n"
+      headers, body = headers.split "\r\n\r\n", 2
+      length = headers[/^content-length: (\d+)/i, 1].to_i
+      body << socket.readpartial(65_536) while body.bytesize < length
+      headers
+    end
+  end
+end
+
+StaticFileCacheBench.run (ARGV[0] || 5_000).to_i
@@ -0,0 +1,45 @@
+# frozen_string_literal: true
+
+=begin
+Micro-benchmark for handing work to `Puma::ThreadPool`, reports the work
+items processed per second with one producer, like the reactor, and 8, 32
+and 64 threads.  The work is a short busy loop, so the time is mostly spent
+handing work to and taking it from the pool.
+
+From the repo root:
+
+ruby -Ilib benchmarks/local/thread_pool_queue.rb
+ruby -Ilib benchmarks/local/thread_pool_queue.rb 500000
+
+The optional argument is the number of work items per thread count.  The
+results are most interesting on JRuby and TruffleRuby, where pool threads
+run in parallel.
+=end
+
+require 'puma'
+require 'puma/thread_pool'
+
+module ThreadPoolQueue
+
+  CLK_MONO = Process::CLOCK_MONOTONIC
+
+  class << self
+    def run(items)
+      STDOUT.syswrite "Threads      items/sec\n"
+      [8, 32, 64].each do |threads|
+        pool = Puma::ThreadPool.new('bench', { min_threads: threads, max_threads: threads }) do
+          10.times { } # a little work
+        end
+
+        t_st = Process.clock_gettime CLK_MONO
+        items.times { |i| pool << i }
+        pool.shutdown(-1) # threads exit once all work is done
+        time = Process.clock_gettime(CLK_MONO) - t_st
+
+        STDOUT.syswrite format("%7d   %12.0f\n", threads, items / time)
+      end
+    end
+  end
+end
+
+ThreadPoolQueue.run (ARGV[0] || 200_000).to_i
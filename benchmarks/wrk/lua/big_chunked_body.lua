@@ -0,0 +1,11 @@
+-- 4 MB body sent as 16 kB chunks, the same size as big_body.lua
+local chunk = string.rep("body", 4096)
+local chunks = {}
+for i = 1, 244 do
+  chunks[i] = string.format("%x\r\n%s\r\n", #chunk, chunk)
+end
+
+wrk.method = "POST"
+wrk.body   = table.concat(chunks) .. "0\r\n\r\n"
+wrk.headers["Content-Type"] = "application/x-www-form-urlencoded"
+wrk.headers["Transfer-Encoding"] = "chunked"
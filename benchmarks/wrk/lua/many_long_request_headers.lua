@@ -0,0 +1,9 @@
+-- 30 request headers with 2000 byte values, the request side counterpart of
+-- test/rackup/many_long_headers.ru
+for i = 0, 29 do
+  local hex = {}
+  for j = 1, 1000 do
+    hex[j] = string.format("%02x", math.random(0, 255))
+  end
+  wrk.headers["X-My-Header-" .. i] = table.concat(hex)
+end
@@ -0,0 +1,6 @@
+bundle exec bin/puma -t 4 test/rackup/hello.ru &
+PID1=$!
+sleep 5
+wrk -c 4 -d 30 -s benchmarks/wrk/lua/many_long_request_headers.lua --latency http://localhost:9292
+
+kill $PID1
@@ -0,0 +1,10 @@
+# You are encouraged to use @ioquatix's wrk fork, located here: https://github.com/ioquatix/wrk
+
+bundle exec ruby bin/puma \
+                 -t 4 -b "ssl://localhost:9292?key=examples%2Fpuma%2Fpuma_keypair.pem&cert=examples%2Fpuma%2Fcert_puma.pem&verify_mode=none" \
+                 test/rackup/hello.ru &
+PID1=$!
+sleep 5
+wrk -c 4 -d 30 -s benchmarks/wrk/lua/big_body.lua --latency https://localhost:9292
+
+kill $PID1
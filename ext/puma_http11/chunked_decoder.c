@@ -0,0 +1,324 @@
+#define RSTRING_NOT_MODIFIED 1
+
+#include <ruby.h>
+#include <string.h>
+
+/*
+ * Decoder for request bodies with Transfer-Encoding: chunked, keeps its state
+ * between reads so it can be fed whatever the socket returned.  Chunk
+ * extensions and trailers are skipped.  The limits are passed from
+ * Puma::Client, MAX_CHUNK_HEADER_SIZE and MAX_CHUNK_EXCESS.
+ */
+
+/* Longest chunk size kept for validation and error messages */
+#define SIZE_BUF_LEN 64
+
+enum chunked_state {
+  CS_SIZE,          /* chunk size */
+  CS_EXT,           /* chunk extension, after ';' */
+  CS_SIZE_LF,       /* LF ending the size line */
+  CS_DATA,
+  CS_DATA_CR,
+  CS_DATA_LF,
+  CS_TRAILER_START, /* start of a trailer line, CR here ends the body */
+  CS_TRAILER,
+  CS_TRAILER_LF,
+  CS_END_LF,        /* LF ending the body */
+  CS_DONE
+};
+
+typedef struct {
+  enum chunked_state state;
+  unsigned long long remain;
+  long long excess;
+  size_t line_len;
+  size_t size_len;
+  int has_ext;
+  char size_buf[SIZE_BUF_LEN];
+  size_t max_header_size;
+  long long max_excess;
+} chunked_decoder;
+
+static VALUE eHttpParserError;
+
+static const rb_data_type_t ChunkedDecoder_data_type = {
+    .wrap_struct_name = "Puma::ChunkedDecoder",
+    .function = {
+      .dmark = NULL,
+      .dfree = RUBY_TYPED_DEFAULT_FREE,
+      .dsize = NULL,
+    },
+    .flags = RUBY_TYPED_FREE_IMMEDIATELY,
+};
+
+static void decoder_reset(chunked_decoder *dec)
+{
+  dec->state = CS_SIZE;
+  dec->remain = 0;
+  dec->excess = 0;
+  dec->line_len = 0;
+  dec->size_len = 0;
+  dec->has_ext = 0;
+}
+
+static VALUE ChunkedDecoder_alloc(VALUE klass)
+{
+  chunked_decoder *dec = ALLOC_N(chunked_decoder, 1);
+
+  decoder_reset(dec);
+  dec->max_header_size = 0;
+  dec->max_excess = 0;
+  return TypedData_Wrap_Struct(klass, &ChunkedDecoder_data_type, dec);
+}
+
+static inline chunked_decoder *ChunkedDecoder_unwrap(VALUE self)
+{
+  chunked_decoder *dec;
+  TypedData_Get_Struct(self, chunked_decoder, &ChunkedDecoder_data_type, dec);
+  return dec;
+}
+
+/* Same as Ruby's String#strip */
+static inline int is_strip_char(char c)
+{
+  return c == '\0' || c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+static inline void add_line_len(chunked_decoder *dec, size_t n)
+{
+  dec->line_len += n;
+  if (dec->line_len >= dec->max_header_size) {
+    rb_raise(eHttpParserError, "%s", "maximum size of chunk header exceeded");
+  }
+}
+
+static inline void add_excess(chunked_decoder *dec, long long n)
+{
+  dec->excess += n;
+  if (dec->excess >= dec->max_excess) {
+    rb_raise(eHttpParserError, "%s", "Maximum chunk excess detected");
+  }
+}
+
+/*
+ * Validates the size line read so far and sets the length of the chunk.
+ * Leading whitespace is allowed, trailing whitespace only without an
+ * extension.
+ */
+static void size_line_done(chunked_decoder *dec)
+{
+  const char *hex = dec->size_buf;
+  size_t len = dec->size_len < SIZE_BUF_LEN ? dec->size_len : SIZE_BUF_LEN;
+  size_t i, digits = 0;
+  unsigned long long size = 0;
+  char c;
+
+  while (len > 0 && is_strip_char(*hex)) {
+    hex++;
+    len--;
+  }
+  if (!dec->has_ext) {
+    while (len > 0 && is_strip_char(hex[len - 1])) len--;
+  }
+
+  if (len == 0) {
+    rb_raise(eHttpParserError, "%s", "Chunk size cannot be empty or nil");
+  }
+
+  for (i = 0; i < len; i++) {
+    c = hex[i];
+    if (c >= '0' && c <= '9') c -= '0';
+    else if (c >= 'a' && c <= 'f') c -= 'a' - 10;
+    else if (c >= 'A' && c <= 'F') c -= 'A' - 10;
+    else break;
+
+    if (size || c) digits++;
+    size = (size << 4) | (unsigned char)c;
+  }
+
+  /* 15 digits is more than any body Puma could buffer */
+  if (i < len || dec->size_len > SIZE_BUF_LEN || digits > 15) {
+    rb_raise(eHttpParserError, "Invalid chunk size: '%.*s'", (int)len, hex);
+  }
+
+  add_excess(dec, (long long)(dec->line_len - len) - (long long)size);
+
+  dec->remain = size;
+  dec->line_len = 0;
+  dec->size_len = 0;
+  dec->has_ext = 0;
+}
+
+/**
+ * call-seq:
+ *    Puma::ChunkedDecoder.new(max_header_size, max_excess) -> decoder
+ *
+ * +max_header_size+ limits the bytes of a chunk size line or trailer line,
+ * +max_excess+ the extension and trailer bytes sent beyond the body bytes.
+ */
+static VALUE ChunkedDecoder_init(VALUE self, VALUE max_header_size, VALUE max_excess)
+{
+  chunked_decoder *dec = ChunkedDecoder_unwrap(self);
+
+  decoder_reset(dec);
+  dec->max_header_size = NUM2SIZET(max_header_size);
+  dec->max_excess = NUM2LL(max_excess);
+  return self;
+}
+
+/**
+ * call-seq:
+ *    decoder.reset -> nil
+ *
+ * Resets the decoder for the body of the next request.
+ */
+static VALUE ChunkedDecoder_reset(VALUE self)
+{
+  decoder_reset(ChunkedDecoder_unwrap(self));
+  return Qnil;
+}
+
+/**
+ * call-seq:
+ *    decoder.decode(data, out) -> Integer or nil
+ *
+ * Decodes +data+, the next bytes of the body, appending the chunk data to
+ * the String +out+.  Returns +nil+ if more data is needed, or the number of
+ * bytes of +data+ used once the body is complete.  Bytes after that are the
+ * next request.
+ *
+ * Raises Puma::HttpParserError if the body is invalid or exceeds a limit.
+ */
+static VALUE ChunkedDecoder_decode(VALUE self, VALUE data, VALUE out)
+{
+  chunked_decoder *dec = ChunkedDecoder_unwrap(self);
+  const char *start, *p, *pe, *q;
+  size_t n;
+
+  StringValue(data);
+  StringValue(out);
+
+  start = p = RSTRING_PTR(data);
+  pe = p + RSTRING_LEN(data);
+
+  while (p < pe && dec->state != CS_DONE) {
+    switch (dec->state) {
+    case CS_SIZE:
+      if (*p == '\r') {
+        size_line_done(dec);
+        dec->state = CS_SIZE_LF;
+      } else if (*p == ';') {
+        dec->has_ext = 1;
+        dec->state = CS_EXT;
+        add_line_len(dec, 1);
+      } else {
+        if (dec->size_len < SIZE_BUF_LEN) dec->size_buf[dec->size_len] = *p;
+        dec->size_len++;
+        add_line_len(dec, 1);
+      }
+      p++;
+      break;
+
+    case CS_EXT:
+      q = memchr(p, '\r', pe - p);
+      n = (q ? q : pe) - p;
+      add_line_len(dec, n);
+      p += n;
+      if (q) {
+        size_line_done(dec);
+        dec->state = CS_SIZE_LF;
+        p++;
+      }
+      break;
+
+    case CS_SIZE_LF:
+      if (*p != '\n') {
+        rb_raise(eHttpParserError, "%s", "Invalid chunk size line ending");
+      }
+      dec->state = dec->remain ? CS_DATA : CS_TRAILER_START;
+      p++;
+      break;
+
+    case CS_DATA:
+      n = pe - p;
+      if ((unsigned long long)n > dec->remain) n = (size_t)dec->remain;
+      rb_str_cat(out, p, n);
+      dec->remain -= n;
+      p += n;
+      if (dec->remain == 0) dec->state = CS_DATA_CR;
+      break;
+
+    case CS_DATA_CR:
+    case CS_DATA_LF:
+      if (*p != (dec->state == CS_DATA_CR ? '\r' : '\n')) {
+        rb_raise(eHttpParserError, "%s", "Chunk size mismatch");
+      }
+      dec->state = dec->state == CS_DATA_CR ? CS_DATA_LF : CS_SIZE;
+      p++;
+      break;
+
+    case CS_TRAILER_START:
+      if (*p == '\r') {
+        dec->state = CS_END_LF;
+        p++;
+      } else {
+        dec->state = CS_TRAILER;
+      }
+      break;
+
+    case CS_TRAILER:
+      q = memchr(p, '\r', pe - p);
+      n = (q ? q + 1 : pe) - p;
+      add_line_len(dec, n);
+      add_excess(dec, (long long)n);
+      p += n;
+      if (q) dec->state = CS_TRAILER_LF;
+      break;
+
+    case CS_TRAILER_LF:
+      if (*p == '\n') {
+        dec->line_len = 0;
+        dec->state = CS_TRAILER_START;
+        p++;
+      } else {
+        dec->state = CS_TRAILER;
+      }
+      break;
+
+    case CS_END_LF:
+      if (*p != '\n') {
+        rb_raise(eHttpParserError, "%s", "Invalid chunked body ending");
+      }
+      dec->state = CS_DONE;
+      p++;
+      break;
+
+    case CS_DONE:
+      break;
+    }
+  }
+
+  return dec->state == CS_DONE ? LONG2NUM(p - start) : Qnil;
+}
+
+/**
+ * call-seq:
+ *    decoder.finished? -> true/false
+ */
+static VALUE ChunkedDecoder_is_finished(VALUE self)
+{
+  return ChunkedDecoder_unwrap(self)->state == CS_DONE ? Qtrue : Qfalse;
+}
+
+void Init_chunked_decoder(VALUE puma) {
+  VALUE cChunkedDecoder = rb_define_class_under(puma, "ChunkedDecoder", rb_cObject);
+
+  rb_global_variable(&eHttpParserError);
+  eHttpParserError = rb_const_get(puma, rb_intern("HttpParserError"));
+
+  rb_define_alloc_func(cChunkedDecoder, ChunkedDecoder_alloc);
+  rb_define_method(cChunkedDecoder, "initialize", ChunkedDecoder_init, 2);
+  rb_define_method(cChunkedDecoder, "reset", ChunkedDecoder_reset, 0);
+  rb_define_method(cChunkedDecoder, "decode", ChunkedDecoder_decode, 2);
+  rb_define_method(cChunkedDecoder, "finished?", ChunkedDecoder_is_finished, 0);
+}
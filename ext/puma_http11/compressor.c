@@ -0,0 +1,325 @@
+#include <ruby.h>
+
+/*
+ * Puma::Compressor, a gzip or zstd stream that compresses response bodies
+ * for `Puma::Compression`.  Inputs of at least NOGVL_MIN bytes are
+ * compressed without the GVL, from a frozen String sharing the input's
+ * bytes, so they can't change meanwhile, and the output is written to a
+ * String only the calling thread references.
+ */
+
+#if defined(HAVE_ZLIB_H) && defined(HAVE_DEFLATE)
+#include <ruby/thread.h>
+#include <limits.h>
+#include <string.h>
+#include <zlib.h>
+#ifdef HAVE_ZSTD_H
+#include <zstd.h>
+#endif
+
+/* smaller inputs are compressed faster than the GVL is released */
+#define NOGVL_MIN 16384
+#define OUT_MIN 4096
+
+enum { GZIP, ZSTD };
+enum { CONTINUE, FLUSH, END };
+
+typedef struct {
+  int type;
+  int busy;
+  int initialized;
+  z_stream z;
+#ifdef HAVE_ZSTD_H
+  ZSTD_CCtx *zstd;
+#endif
+} compressor;
+
+typedef struct {
+  compressor *c;
+  VALUE in_str;
+  VALUE out;
+  const char *in;
+  size_t in_len;
+  char *dst;
+  size_t dst_len;
+  size_t consumed;
+  size_t produced;
+  int mode;
+  int done;
+  int error;
+} step_args;
+
+static VALUE eCompressorError;
+
+static void compressor_end(compressor *c)
+{
+  if (!c->initialized) return;
+  c->initialized = 0;
+  if (c->type == GZIP) {
+    deflateEnd(&c->z);
+  }
+#ifdef HAVE_ZSTD_H
+  else {
+    ZSTD_freeCCtx(c->zstd);
+    c->zstd = NULL;
+  }
+#endif
+}
+
+static void Compressor_free(void *ptr)
+{
+  compressor_end(ptr);
+  xfree(ptr);
+}
+
+static size_t Compressor_memsize(const void *ptr)
+{
+  return sizeof(compressor);
+}
+
+static const rb_data_type_t Compressor_data_type = {
+    .wrap_struct_name = "Puma::Compressor",
+    .function = {
+      .dfree = Compressor_free,
+      .dsize = Compressor_memsize,
+    },
+    .flags = RUBY_TYPED_FREE_IMMEDIATELY,
+};
+
+static VALUE Compressor_alloc(VALUE klass)
+{
+  compressor *c;
+  return TypedData_Make_Struct(klass, compressor, &Compressor_data_type, c);
+}
+
+/* runs with or without the GVL, compresses until dst is full or done */
+static void *compress_step(void *ptr)
+{
+  step_args *a = ptr;
+  compressor *c = a->c;
+
+  if (c->type == GZIP) {
+    int ret;
+
+    c->z.next_in = (Bytef *)a->in;
+    c->z.avail_in = (uInt)a->in_len;
+    c->z.next_out = (Bytef *)a->dst;
+    c->z.avail_out = (uInt)a->dst_len;
+    ret = deflate(&c->z, a->mode == END ? Z_FINISH : a->mode == FLUSH ? Z_SYNC_FLUSH : Z_NO_FLUSH);
+    a->consumed = a->in_len - c->z.avail_in;
+    a->produced = a->dst_len - c->z.avail_out;
+    if (ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR) {
+      a->error = 1;
+    } else if (a->mode == END) {
+      a->done = ret == Z_STREAM_END;
+    } else if (a->mode == FLUSH) {
+      a->done = c->z.avail_out != 0;
+    } else {
+      a->done = c->z.avail_in == 0;
+    }
+  }
+#ifdef HAVE_ZSTD_H
+  else {
+    ZSTD_inBuffer in = { a->in, a->in_len, 0 };
+    ZSTD_outBuffer out = { a->dst, a->dst_len, 0 };
+    size_t ret = ZSTD_compressStream2(c->zstd, &out, &in,
+      a->mode == END ? ZSTD_e_end : a->mode == FLUSH ? ZSTD_e_flush : ZSTD_e_continue);
+
+    a->consumed = in.pos;
+    a->produced = out.pos;
+    if (ZSTD_isError(ret)) {
+      a->error = 1;
+    } else if (a->mode == CONTINUE) {
+      a->done = in.pos == in.size;
+    } else {
+      a->done = ret == 0;
+    }
+  }
+#endif
+  return NULL;
+}
+
+static VALUE compress_loop(VALUE ptr)
+{
+  step_args *a = (step_args *)ptr;
+  int nogvl = a->in_len >= NOGVL_MIN;
+  long len;
+
+  for (;;) {
+    len = RSTRING_LEN(a->out);
+    if ((long)rb_str_capacity(a->out) - len < OUT_MIN) {
+      rb_str_modify_expand(a->out, len < OUT_MIN ? OUT_MIN : len);
+    }
+    /* zlib counts in uInt */
+    a->in_len = a->in_len > UINT_MAX ? UINT_MAX : a->in_len;
+    a->dst = RSTRING_PTR(a->out) + len;
+    a->dst_len = rb_str_capacity(a->out) - len;
+    a->consumed = a->produced = 0;
+    a->done = 0;
+
+    if (nogvl) {
+      rb_thread_call_without_gvl(compress_step, a, NULL, NULL);
+    } else {
+      compress_step(a);
+    }
+
+    rb_str_set_len(a->out, len + a->produced);
+    if (a->error) rb_raise(eCompressorError, "compression failed");
+    a->in += a->consumed;
+    a->in_len = RSTRING_LEN(a->in_str) - (a->in - RSTRING_PTR(a->in_str));
+    if (a->done && a->in_len == 0) break;
+  }
+  return a->out;
+}
+
+static VALUE compress_ensure(VALUE ptr)
+{
+  ((step_args *)ptr)->c->busy = 0;
+  return Qnil;
+}
+
+static inline compressor *Compressor_unwrap(VALUE self)
+{
+  compressor *c;
+  TypedData_Get_Struct(self, compressor, &Compressor_data_type, c);
+  if (!c->initialized) rb_raise(eCompressorError, "stream closed");
+  return c;
+}
+
+static VALUE compressor_run(VALUE self, VALUE str, int mode)
+{
+  compressor *c = Compressor_unwrap(self);
+  step_args a = { 0 };
+
+  StringValue(str);
+  if (c->busy) rb_raise(eCompressorError, "compressor used by another thread");
+
+  /* a copy only when str is modified later */
+  str = rb_str_new_frozen(str);
+  a.c = c;
+  a.in_str = str;
+  c->busy = 1;
+  a.in = RSTRING_PTR(str);
+  a.in_len = RSTRING_LEN(str);
+  a.out = rb_str_buf_new(a.in_len / 2 > OUT_MIN ? a.in_len / 2 : OUT_MIN);
+  a.mode = mode;
+  rb_ensure(compress_loop, (VALUE)&a, compress_ensure, (VALUE)&a);
+
+  RB_GC_GUARD(self);
+  RB_GC_GUARD(str);
+  return a.out;
+}
+
+/**
+ * call-seq:
+ *    Puma::Compressor.new(encoding, level = nil)
+ *
+ * A stream that compresses with +encoding+, "gzip" or "zstd", one of
+ * +ENCODINGS+.  +level+ defaults to the library's default.
+ */
+static VALUE Compressor_initialize(int argc, VALUE *argv, VALUE self)
+{
+  compressor *c;
+  VALUE encoding, level;
+  const char *name;
+
+  TypedData_Get_Struct(self, compressor, &Compressor_data_type, c);
+  if (c->initialized) rb_raise(eCompressorError, "already initialized");
+
+  rb_scan_args(argc, argv, "11", &encoding, &level);
+  name = StringValueCStr(encoding);
+
+  if (strcmp(name, "gzip") == 0) {
+    c->type = GZIP;
+    /* 16 + 15, a gzip header and trailer with the largest window */
+    if (deflateInit2(&c->z, NIL_P(level) ? Z_DEFAULT_COMPRESSION : NUM2INT(level),
+        Z_DEFLATED, 16 + 15, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+      rb_raise(eCompressorError, "deflateInit2 failed");
+    }
+  }
+#ifdef HAVE_ZSTD_H
+  else if (strcmp(name, "zstd") == 0) {
+    c->type = ZSTD;
+    c->zstd = ZSTD_createCCtx();
+    if (!c->zstd) rb_memerror();
+    if (!NIL_P(level)) ZSTD_CCtx_setParameter(c->zstd, ZSTD_c_compressionLevel, NUM2INT(level));
+  }
+#endif
+  else {
+    rb_raise(rb_eArgError, "unsupported encoding: %s", name);
+  }
+  c->initialized = 1;
+  return self;
+}
+
+/**
+ * call-seq:
+ *    compressor.compress(str, flush = false) -> String
+ *
+ * Compresses +str+, returns the output so far, which may be empty.  With
+ * +flush+, all of +str+ is in the output, the client can decompress it
+ * before the stream ends.
+ */
+static VALUE Compressor_compress(int argc, VALUE *argv, VALUE self)
+{
+  VALUE str, flush;
+
+  rb_scan_args(argc, argv, "11", &str, &flush);
+  return compressor_run(self, str, RTEST(flush) ? FLUSH : CONTINUE);
+}
+
+/**
+ * call-seq:
+ *    compressor.finish(str = "") -> String
+ *
+ * Compresses +str+ and ends the stream, returns the rest of the output.
+ * Frees the stream, it can't be used again.
+ */
+static VALUE Compressor_finish(int argc, VALUE *argv, VALUE self)
+{
+  VALUE str, out;
+
+  rb_scan_args(argc, argv, "01", &str);
+  out = compressor_run(self, NIL_P(str) ? rb_str_new(0, 0) : str, END);
+  compressor_end(Compressor_unwrap(self));
+  return out;
+}
+
+/**
+ * call-seq:
+ *    compressor.close -> nil
+ *
+ * Frees the stream, without ending it.
+ */
+static VALUE Compressor_close(VALUE self)
+{
+  compressor *c;
+
+  TypedData_Get_Struct(self, compressor, &Compressor_data_type, c);
+  if (c->busy) rb_raise(eCompressorError, "compressor used by another thread");
+  compressor_end(c);
+  return Qnil;
+}
+#endif
+
+void Init_compressor(VALUE puma) {
+#if defined(HAVE_ZLIB_H) && defined(HAVE_DEFLATE)
+  VALUE cCompressor = rb_define_class_under(puma, "Compressor", rb_cObject);
+  VALUE encodings = rb_ary_new();
+
+  /* the encodings available, the one preferred first */
+#ifdef HAVE_ZSTD_H
+  rb_ary_push(encodings, rb_obj_freeze(rb_str_new_cstr("zstd")));
+#endif
+  rb_ary_push(encodings, rb_obj_freeze(rb_str_new_cstr("gzip")));
+  rb_define_const(cCompressor, "ENCODINGS", rb_obj_freeze(encodings));
+
+  eCompressorError = rb_define_class_under(cCompressor, "Error", rb_eStandardError);
+
+  rb_define_alloc_func(cCompressor, Compressor_alloc);
+  rb_define_method(cCompressor, "initialize", Compressor_initialize, -1);
+  rb_define_method(cCompressor, "compress", Compressor_compress, -1);
+  rb_define_method(cCompressor, "finish", Compressor_finish, -1);
+  rb_define_method(cCompressor, "close", Compressor_close, 0);
+#endif
+}
@@ -0,0 +1,348 @@
+#define RSTRING_NOT_MODIFIED 1
+
+#include <ruby.h>
+#include <ruby/io.h>
+#include <ruby/thread.h>
+
+/*
+ * Puma::EPollSelector, the `:native` io_selector_backend of Puma::Reactor on
+ * Linux.  A level-triggered epoll set, ready clients are yielded directly,
+ * without NIO::Monitor objects.  Waits with the GVL released and is woken
+ * with an eventfd.
+ */
+
+#if defined(HAVE_SYS_EPOLL_H) && defined(HAVE_SYS_EVENTFD_H)
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <errno.h>
+#include <limits.h>
+#include <math.h>
+#include <string.h>
+#include <unistd.h>
+
+/* Events harvested by each epoll_wait call */
+#define EVENTS_MAX 1024
+
+typedef struct {
+  int epfd;
+  int wakefd;
+  /* indexed by fd, the registered IO and its value */
+  VALUE *ios;
+  VALUE *values;
+  int slots_len;
+  /* registered IO => fd, the fd of a closed IO can't be read */
+  VALUE fds;
+  struct epoll_event events[EVENTS_MAX];
+} epoll_selector;
+
+struct wait_args {
+  epoll_selector *sel;
+  int timeout;
+  int ret;
+  int err;
+};
+
+static void EPollSelector_mark(void *ptr)
+{
+  epoll_selector *sel = ptr;
+  int i;
+
+  rb_gc_mark(sel->fds);
+  for (i = 0; i < sel->slots_len; i++) {
+    rb_gc_mark(sel->ios[i]);
+    rb_gc_mark(sel->values[i]);
+  }
+}
+
+static void selector_close(epoll_selector *sel)
+{
+  if (sel->epfd >= 0) close(sel->epfd);
+  if (sel->wakefd >= 0) close(sel->wakefd);
+  sel->epfd = sel->wakefd = -1;
+}
+
+static void EPollSelector_free(void *ptr)
+{
+  epoll_selector *sel = ptr;
+
+  selector_close(sel);
+  xfree(sel->ios);
+  xfree(sel->values);
+  xfree(sel);
+}
+
+static size_t EPollSelector_memsize(const void *ptr)
+{
+  const epoll_selector *sel = ptr;
+  return sizeof(*sel) + 2 * sizeof(VALUE) * sel->slots_len;
+}
+
+static const rb_data_type_t EPollSelector_data_type = {
+    .wrap_struct_name = "Puma::EPollSelector",
+    .function = {
+      .dmark = EPollSelector_mark,
+      .dfree = EPollSelector_free,
+      .dsize = EPollSelector_memsize,
+    },
+    .flags = RUBY_TYPED_FREE_IMMEDIATELY,
+};
+
+static VALUE EPollSelector_alloc(VALUE klass)
+{
+  epoll_selector *sel = ALLOC(epoll_selector);
+
+  sel->epfd = sel->wakefd = -1;
+  sel->ios = sel->values = NULL;
+  sel->slots_len = 0;
+  sel->fds = Qnil;
+  return TypedData_Wrap_Struct(klass, &EPollSelector_data_type, sel);
+}
+
+static inline epoll_selector *EPollSelector_unwrap(VALUE self)
+{
+  epoll_selector *sel;
+  TypedData_Get_Struct(self, epoll_selector, &EPollSelector_data_type, sel);
+  return sel;
+}
+
+static epoll_selector *open_selector(VALUE self)
+{
+  epoll_selector *sel = EPollSelector_unwrap(self);
+
+  if (sel->epfd < 0) rb_raise(rb_eIOError, "selector is closed");
+  return sel;
+}
+
+static VALUE EPollSelector_init(VALUE self)
+{
+  epoll_selector *sel = EPollSelector_unwrap(self);
+  struct epoll_event ev;
+
+  sel->fds = rb_hash_new(); /* IO#hash is the object identity */
+
+  if ((sel->epfd = epoll_create1(EPOLL_CLOEXEC)) < 0) rb_sys_fail("epoll_create1");
+  if ((sel->wakefd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)) < 0) {
+    selector_close(sel);
+    rb_sys_fail("eventfd");
+  }
+
+  memset(&ev, 0, sizeof(ev));
+  ev.events = EPOLLIN;
+  ev.data.fd = sel->wakefd;
+  if (epoll_ctl(sel->epfd, EPOLL_CTL_ADD, sel->wakefd, &ev) < 0) {
+    selector_close(sel);
+    rb_sys_fail("epoll_ctl");
+  }
+  return self;
+}
+
+static ID id_closed_p;
+
+/* fd of an open IO, or -1 */
+static int open_fd(VALUE io)
+{
+  if (RTEST(rb_funcall(io, id_closed_p, 0))) return -1;
+#ifdef HAVE_RB_IO_DESCRIPTOR
+  return rb_io_descriptor(io);
+#else
+  rb_io_t *fptr;
+  GetOpenFile(io, fptr);
+  return fptr->fd;
+#endif
+}
+
+static void clear_slot(epoll_selector *sel, int fd)
+{
+  sel->ios[fd] = Qnil;
+  sel->values[fd] = Qnil;
+}
+
+/**
+ * call-seq:
+ *    selector.register(io, value) -> value
+ *
+ * Monitors +io+ for reading, #select yields +value+ when it's readable.
+ *
+ * Raises ArgumentError if +io+ is closed, already registered, or can't be
+ * monitored, like NIO::Selector#register.
+ */
+static VALUE EPollSelector_register(VALUE self, VALUE io, VALUE value)
+{
+  epoll_selector *sel = open_selector(self);
+  struct epoll_event ev;
+  int fd, len;
+
+  io = rb_io_get_io(io);
+  if ((fd = open_fd(io)) < 0) rb_raise(rb_eArgError, "closed IO");
+
+  if (fd >= sel->slots_len) {
+    len = sel->slots_len ? sel->slots_len : 64;
+    while (len <= fd) len *= 2;
+    REALLOC_N(sel->ios, VALUE, len);
+    REALLOC_N(sel->values, VALUE, len);
+    while (sel->slots_len < len) clear_slot(sel, sel->slots_len++);
+  }
+
+  memset(&ev, 0, sizeof(ev));
+  ev.events = EPOLLIN;
+  ev.data.fd = fd;
+  if (epoll_ctl(sel->epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+    rb_raise(rb_eArgError, "can't register IO: %s", strerror(errno));
+  }
+
+  /* a closed IO that wasn't deregistered may have had the same fd */
+  if (!NIL_P(sel->ios[fd])) rb_hash_delete(sel->fds, sel->ios[fd]);
+
+  sel->ios[fd] = io;
+  sel->values[fd] = value;
+  rb_hash_aset(sel->fds, io, INT2FIX(fd));
+  return value;
+}
+
+/**
+ * call-seq:
+ *    selector.deregister(io) -> value or nil
+ *
+ * Stops monitoring +io+, which may be closed already.  Returns the value
+ * it was registered with.
+ */
+static VALUE EPollSelector_deregister(VALUE self, VALUE io)
+{
+  epoll_selector *sel = EPollSelector_unwrap(self);
+  VALUE fd_num, value;
+  int fd;
+
+  fd_num = rb_hash_delete(sel->fds, io);
+  if (NIL_P(fd_num)) return Qnil;
+
+  fd = FIX2INT(fd_num);
+  value = sel->values[fd];
+  clear_slot(sel, fd);
+
+  /* closed fds are removed from the epoll set by the kernel */
+  if (sel->epfd >= 0 && open_fd(io) >= 0) {
+    epoll_ctl(sel->epfd, EPOLL_CTL_DEL, fd, NULL);
+  }
+  return value;
+}
+
+static void *wait_nogvl(void *ptr)
+{
+  struct wait_args *args = ptr;
+
+  args->ret = epoll_wait(args->sel->epfd, args->sel->events, EVENTS_MAX, args->timeout);
+  args->err = errno;
+  return NULL;
+}
+
+/**
+ * call-seq:
+ *    selector.select(timeout = nil) { |value| ... } -> Integer
+ *
+ * Waits up to +timeout+ seconds, forever if +nil+, until a registered IO is
+ * readable or #wakeup is called.  Yields the value of each readable IO and
+ * returns how many were yielded.
+ */
+static VALUE EPollSelector_select(int argc, VALUE *argv, VALUE self)
+{
+  epoll_selector *sel = open_selector(self);
+  struct wait_args args;
+  VALUE timeout, value;
+  double secs;
+  uint64_t buf;
+  int i, fd, yielded = 0;
+
+  rb_scan_args(argc, argv, "01", &timeout);
+  rb_need_block();
+
+  if (NIL_P(timeout)) {
+    args.timeout = -1;
+  } else {
+    secs = ceil(NUM2DBL(timeout) * 1000);
+    args.timeout = secs <= 0 ? 0 : secs >= INT_MAX ? INT_MAX : (int)secs;
+  }
+  args.sel = sel;
+
+  rb_thread_call_without_gvl(wait_nogvl, &args, RUBY_UBF_IO, NULL);
+
+  if (args.ret < 0) {
+    if (args.err == EINTR) {
+      rb_thread_check_ints();
+      return INT2FIX(0);
+    }
+    errno = args.err;
+    rb_sys_fail("epoll_wait");
+  }
+
+  for (i = 0; i < args.ret; i++) {
+    fd = sel->events[i].data.fd;
+    if (fd == sel->wakefd) {
+      if (read(fd, &buf, sizeof(buf)) < 0) { /* already drained */ }
+      continue;
+    }
+    /* the block may have deregistered or closed it, or closed the selector */
+    if (sel->epfd < 0) break;
+    if (fd >= sel->slots_len || NIL_P(value = sel->values[fd])) continue;
+
+    rb_yield(value);
+    yielded++;
+  }
+  return INT2FIX(yielded);
+}
+
+/**
+ * call-seq:
+ *    selector.wakeup -> nil
+ *
+ * Makes a #select waiting in another thread return.
+ */
+static VALUE EPollSelector_wakeup(VALUE self)
+{
+  epoll_selector *sel = open_selector(self);
+  uint64_t one = 1;
+
+  if (write(sel->wakefd, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+    rb_sys_fail("write");
+  }
+  return Qnil;
+}
+
+static VALUE EPollSelector_close(VALUE self)
+{
+  epoll_selector *sel = EPollSelector_unwrap(self);
+  int i;
+
+  selector_close(sel);
+  for (i = 0; i < sel->slots_len; i++) clear_slot(sel, i);
+  rb_hash_clear(sel->fds);
+  return Qnil;
+}
+
+static VALUE EPollSelector_is_closed(VALUE self)
+{
+  return EPollSelector_unwrap(self)->epfd < 0 ? Qtrue : Qfalse;
+}
+
+static VALUE EPollSelector_is_empty(VALUE self)
+{
+  return RHASH_SIZE(EPollSelector_unwrap(self)->fds) == 0 ? Qtrue : Qfalse;
+}
+#endif
+
+void Init_epoll_selector(VALUE puma) {
+#if defined(HAVE_SYS_EPOLL_H) && defined(HAVE_SYS_EVENTFD_H)
+  VALUE cEPollSelector = rb_define_class_under(puma, "EPollSelector", rb_cObject);
+
+  id_closed_p = rb_intern("closed?");
+
+  rb_define_alloc_func(cEPollSelector, EPollSelector_alloc);
+  rb_define_method(cEPollSelector, "initialize", EPollSelector_init, 0);
+  rb_define_method(cEPollSelector, "register", EPollSelector_register, 2);
+  rb_define_method(cEPollSelector, "deregister", EPollSelector_deregister, 1);
+  rb_define_method(cEPollSelector, "select", EPollSelector_select, -1);
+  rb_define_method(cEPollSelector, "wakeup", EPollSelector_wakeup, 0);
+  rb_define_method(cEPollSelector, "close", EPollSelector_close, 0);
+  rb_define_method(cEPollSelector, "closed?", EPollSelector_is_closed, 0);
+  rb_define_method(cEPollSelector, "empty?", EPollSelector_is_empty, 0);
+#endif
+}
@@ -55,6 +55,32 @@ unless ENV["PUMA_DISABLE_SSL"]
   end
 end
 
+# Puma::NativeIO
+have_header "sys/uio.h"
+have_func "rb_io_descriptor", "ruby/io.h"
+have_func "sendfile", "sys/sendfile.h"
+have_func "accept4", "sys/socket.h"
+
+# Puma::EPollSelector
+have_header "sys/epoll.h"
+have_header "sys/eventfd.h"
+
+# Puma::SharedTable
+have_header "sys/mman.h"
+have_func "mmap", "sys/mman.h"
+
+# Puma::GVLMeter, Ruby 3.3 and later
+have_func "rb_internal_thread_specific_get", "ruby/thread.h"
+
+# Puma::Compressor, zstd is optional
+if have_library("z", "deflate", "zlib.h") && have_header("zlib.h")
+  have_func "deflate", "zlib.h"
+  have_header "zstd.h" if have_library("zstd", "ZSTD_compressStream2", "zstd.h")
+end
+
+# Puma::FileWatcher
+have_header "sys/inotify.h"
+
 if ENV["PUMA_MAKE_WARNINGS_INTO_ERRORS"]
   # Make all warnings into errors
   # Except `implicit-fallthrough` since most failures comes from ragel state machine generated code
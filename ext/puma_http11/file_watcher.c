@@ -0,0 +1,164 @@
+#include <ruby.h>
+
+/*
+ * Puma::FileWatcher, reports files that changed with inotify, for
+ * `Puma::StaticFileCache` on Linux.  The inotify descriptor is non-blocking,
+ * `#changes` only reads the events already queued.
+ */
+
+#ifdef HAVE_SYS_INOTIFY_H
+#include <sys/inotify.h>
+#include <errno.h>
+#include <unistd.h>
+
+/* any change to the file's contents, or to the path naming it */
+#define WATCH_MASK (IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE | IN_MOVE_SELF | IN_DELETE_SELF)
+
+typedef struct {
+  int fd;
+} file_watcher;
+
+static void watcher_close(file_watcher *w)
+{
+  if (w->fd >= 0) close(w->fd);
+  w->fd = -1;
+}
+
+static void FileWatcher_free(void *ptr)
+{
+  watcher_close(ptr);
+  xfree(ptr);
+}
+
+static size_t FileWatcher_memsize(const void *ptr)
+{
+  return sizeof(file_watcher);
+}
+
+static const rb_data_type_t FileWatcher_data_type = {
+    .wrap_struct_name = "Puma::FileWatcher",
+    .function = {
+      .dfree = FileWatcher_free,
+      .dsize = FileWatcher_memsize,
+    },
+    .flags = RUBY_TYPED_FREE_IMMEDIATELY,
+};
+
+static VALUE FileWatcher_alloc(VALUE klass)
+{
+  file_watcher *w;
+  VALUE obj = TypedData_Make_Struct(klass, file_watcher, &FileWatcher_data_type, w);
+
+  w->fd = -1;
+  return obj;
+}
+
+static inline file_watcher *FileWatcher_unwrap(VALUE self)
+{
+  file_watcher *w;
+  TypedData_Get_Struct(self, file_watcher, &FileWatcher_data_type, w);
+  if (w->fd < 0) rb_raise(rb_eIOError, "closed watcher");
+  return w;
+}
+
+static VALUE FileWatcher_initialize(VALUE self)
+{
+  file_watcher *w;
+
+  TypedData_Get_Struct(self, file_watcher, &FileWatcher_data_type, w);
+  if ((w->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) < 0) rb_sys_fail("inotify_init1");
+  return self;
+}
+
+/**
+ * call-seq:
+ *    watcher.watch(path) -> Integer
+ *
+ * Watches the file at +path+, returns its watch descriptor, the same for
+ * paths of the same file.
+ */
+static VALUE FileWatcher_watch(VALUE self, VALUE path)
+{
+  file_watcher *w = FileWatcher_unwrap(self);
+  int wd;
+
+  FilePathValue(path);
+  if ((wd = inotify_add_watch(w->fd, StringValueCStr(path), WATCH_MASK)) < 0) {
+    rb_sys_fail_str(path);
+  }
+  return INT2NUM(wd);
+}
+
+/**
+ * call-seq:
+ *    watcher.unwatch(wd) -> nil
+ *
+ * Stops watching the file of +wd+, it may already have been removed.
+ */
+static VALUE FileWatcher_unwatch(VALUE self, VALUE wd)
+{
+  inotify_rm_watch(FileWatcher_unwrap(self)->fd, NUM2INT(wd));
+  return Qnil;
+}
+
+/**
+ * call-seq:
+ *    watcher.changes -> Array or nil
+ *
+ * The watch descriptors of the files that changed since the last call,
+ * nil when none did.  -1 means events were lost, any file may have changed.
+ */
+static VALUE FileWatcher_changes(VALUE self)
+{
+  file_watcher *w = FileWatcher_unwrap(self);
+  char buf[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+  const struct inotify_event *ev;
+  VALUE wds = Qnil;
+  ssize_t len;
+  char *p;
+
+  for (;;) {
+    len = read(w->fd, buf, sizeof(buf));
+    if (len < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+      if (errno == EINTR) continue;
+      rb_sys_fail("read");
+    }
+    if (len == 0) break;
+
+    if (NIL_P(wds)) wds = rb_ary_new();
+    for (p = buf; p < buf + len; p += sizeof(struct inotify_event) + ev->len) {
+      ev = (const struct inotify_event *)p;
+      rb_ary_push(wds, INT2NUM(ev->wd));
+    }
+  }
+  if (!NIL_P(wds)) rb_funcall(wds, rb_intern("uniq!"), 0);
+  return wds;
+}
+
+/**
+ * call-seq:
+ *    watcher.close -> nil
+ */
+static VALUE FileWatcher_close(VALUE self)
+{
+  file_watcher *w;
+
+  TypedData_Get_Struct(self, file_watcher, &FileWatcher_data_type, w);
+  watcher_close(w);
+  return Qnil;
+}
+#endif
+
+void Init_file_watcher(VALUE puma) {
+#ifdef HAVE_SYS_INOTIFY_H
+  VALUE cFileWatcher = rb_define_class_under(puma, "FileWatcher", rb_cObject);
+
+  rb_define_alloc_func(cFileWatcher, FileWatcher_alloc);
+  rb_define_method(cFileWatcher, "initialize", FileWatcher_initialize, 0);
+  rb_define_method(cFileWatcher, "watch", FileWatcher_watch, 1);
+  rb_define_method(cFileWatcher, "unwatch", FileWatcher_unwatch, 1);
+  rb_define_method(cFileWatcher, "changes", FileWatcher_changes, 0);
+  rb_define_method(cFileWatcher, "close", FileWatcher_close, 0);
+#endif
+}
@@ -0,0 +1,206 @@
+#include <ruby.h>
+
+/*
+ * Puma::GVLMeter, measures how long the threads it tracks wait for the GVL,
+ * from the time a thread is ready to run until it acquires the GVL, and how
+ * long they hold it.  Uses the thread event hooks and thread specific storage
+ * of Ruby 3.3, the hook only reads the clock for threads that are tracked.
+ *
+ * Each tracked thread stores when it became ready or acquired the GVL in its
+ * own slot, so the hook doesn't need the GVL.  The totals are shared by the
+ * threads of one meter, updated atomically, and freed when the meter and all
+ * of its threads are gone.
+ */
+
+#ifdef HAVE_RB_INTERNAL_THREAD_SPECIFIC_GET
+#include <ruby/thread.h>
+#include <stdint.h>
+#include <time.h>
+
+typedef struct {
+  uint64_t wait_ns;
+  uint64_t waits;
+  uint64_t run_ns;
+  long refs;
+} gvl_totals;
+
+typedef struct {
+  uint64_t ready_at;
+  uint64_t resumed_at;
+  gvl_totals *totals;
+} gvl_thread;
+
+static rb_internal_thread_specific_key_t thread_key;
+static rb_internal_thread_event_hook_t *hook;
+
+static inline uint64_t now_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void totals_release(gvl_totals *totals)
+{
+  if (__atomic_sub_fetch(&totals->refs, 1, __ATOMIC_ACQ_REL) == 0) free(totals);
+}
+
+static inline void add_run_time(gvl_thread *th, uint64_t now)
+{
+  if (th->resumed_at) {
+    __atomic_add_fetch(&th->totals->run_ns, now - th->resumed_at, __ATOMIC_RELAXED);
+    th->resumed_at = 0;
+  }
+}
+
+/* runs in the thread the event is for, READY without the GVL */
+static void gvl_event(rb_event_flag_t event, const rb_internal_thread_event_data_t *data, void *arg)
+{
+  gvl_thread *th = rb_internal_thread_specific_get(data->thread, thread_key);
+  uint64_t now;
+
+  if (!th) return;
+
+  switch (event) {
+    case RUBY_INTERNAL_THREAD_EVENT_READY:
+      th->ready_at = now_ns();
+      break;
+    case RUBY_INTERNAL_THREAD_EVENT_RESUMED:
+      now = th->resumed_at = now_ns();
+      if (th->ready_at) {
+        __atomic_add_fetch(&th->totals->wait_ns, now - th->ready_at, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&th->totals->waits, 1, __ATOMIC_RELAXED);
+        th->ready_at = 0;
+      }
+      break;
+    case RUBY_INTERNAL_THREAD_EVENT_SUSPENDED:
+      add_run_time(th, now_ns());
+      break;
+    case RUBY_INTERNAL_THREAD_EVENT_EXITED:
+      add_run_time(th, now_ns());
+      rb_internal_thread_specific_set(data->thread, thread_key, NULL);
+      totals_release(th->totals);
+      free(th);
+      break;
+  }
+}
+
+static void GVLMeter_free(void *ptr)
+{
+  totals_release(ptr);
+}
+
+static size_t GVLMeter_memsize(const void *ptr)
+{
+  return sizeof(gvl_totals);
+}
+
+static const rb_data_type_t GVLMeter_data_type = {
+    .wrap_struct_name = "Puma::GVLMeter",
+    .function = {
+      .dfree = GVLMeter_free,
+      .dsize = GVLMeter_memsize,
+    },
+    .flags = RUBY_TYPED_FREE_IMMEDIATELY,
+};
+
+static VALUE GVLMeter_alloc(VALUE klass)
+{
+  gvl_totals *totals = calloc(1, sizeof(gvl_totals));
+
+  if (!totals) rb_memerror();
+  totals->refs = 1;
+
+  if (!hook) {
+    hook = rb_internal_thread_add_event_hook(gvl_event,
+      RUBY_INTERNAL_THREAD_EVENT_READY | RUBY_INTERNAL_THREAD_EVENT_RESUMED |
+      RUBY_INTERNAL_THREAD_EVENT_SUSPENDED | RUBY_INTERNAL_THREAD_EVENT_EXITED, NULL);
+  }
+  return TypedData_Wrap_Struct(klass, &GVLMeter_data_type, totals);
+}
+
+static inline gvl_totals *GVLMeter_unwrap(VALUE self)
+{
+  gvl_totals *totals;
+  TypedData_Get_Struct(self, gvl_totals, &GVLMeter_data_type, totals);
+  return totals;
+}
+
+/**
+ * call-seq:
+ *    meter.track_current_thread -> meter
+ *
+ * Adds the calling thread's GVL waits and holds to this meter, until it
+ * exits.  A thread is tracked by one meter at a time.
+ */
+static VALUE GVLMeter_track_current_thread(VALUE self)
+{
+  gvl_totals *totals = GVLMeter_unwrap(self);
+  VALUE thread = rb_thread_current();
+  gvl_thread *th = rb_internal_thread_specific_get(thread, thread_key);
+
+  if (th && th->totals == totals) return self;
+
+  if (!th) {
+    th = malloc(sizeof(gvl_thread));
+    if (!th) rb_memerror();
+  } else {
+    add_run_time(th, now_ns());
+    totals_release(th->totals);
+  }
+  __atomic_add_fetch(&totals->refs, 1, __ATOMIC_ACQ_REL);
+  th->ready_at = 0;
+  th->resumed_at = now_ns(); /* the calling thread holds the GVL */
+  th->totals = totals;
+  rb_internal_thread_specific_set(thread, thread_key, th);
+  return self;
+}
+
+/**
+ * call-seq:
+ *    meter.wait_time -> Float
+ *
+ * The seconds the tracked threads have waited for the GVL, in total.
+ */
+static VALUE GVLMeter_wait_time(VALUE self)
+{
+  return DBL2NUM(__atomic_load_n(&GVLMeter_unwrap(self)->wait_ns, __ATOMIC_RELAXED) / 1e9);
+}
+
+/**
+ * call-seq:
+ *    meter.run_time -> Float
+ *
+ * The seconds the tracked threads have held the GVL, in total, not counting
+ * the current hold of each thread.
+ */
+static VALUE GVLMeter_run_time(VALUE self)
+{
+  return DBL2NUM(__atomic_load_n(&GVLMeter_unwrap(self)->run_ns, __ATOMIC_RELAXED) / 1e9);
+}
+
+/**
+ * call-seq:
+ *    meter.waits -> Integer
+ *
+ * How many times the tracked threads have acquired the GVL after waiting.
+ */
+static VALUE GVLMeter_waits(VALUE self)
+{
+  return ULL2NUM(__atomic_load_n(&GVLMeter_unwrap(self)->waits, __ATOMIC_RELAXED));
+}
+#endif
+
+void Init_gvl_meter(VALUE puma) {
+#ifdef HAVE_RB_INTERNAL_THREAD_SPECIFIC_GET
+  VALUE cGVLMeter = rb_define_class_under(puma, "GVLMeter", rb_cObject);
+
+  thread_key = rb_internal_thread_specific_key_create();
+
+  rb_define_alloc_func(cGVLMeter, GVLMeter_alloc);
+  rb_define_method(cGVLMeter, "track_current_thread", GVLMeter_track_current_thread, 0);
+  rb_define_method(cGVLMeter, "wait_time", GVLMeter_wait_time, 0);
+  rb_define_method(cGVLMeter, "run_time", GVLMeter_run_time, 0);
+  rb_define_method(cGVLMeter, "waits", GVLMeter_waits, 0);
+#endif
+}
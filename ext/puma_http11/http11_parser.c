@@ -26,6 +26,93 @@ static void snake_upcase_char(char *c)
       *c = '_';
 }
 
+/*
+ * Field values are scanned in blocks of 16 (SSE2) or 32 (AVX2) bytes instead
+ * of stepping the state machine over every byte.  Define PUMA_DISABLE_SIMD to
+ * only use the scalar loop.
+ */
+#if defined(__SSE2__) && !defined(PUMA_DISABLE_SIMD)
+#include <emmintrin.h>
+#define PUMA_SCAN_SSE2 1
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define PUMA_SCAN_AVX2 1
+#endif
+#endif
+
+/* A CTL other than HTAB ends a field value, either CR or an invalid byte */
+static inline int is_value_end(unsigned char c)
+{
+    return (c < 0x20 && c != '\t') || c == 0x7F;
+}
+
+#ifdef PUMA_SCAN_AVX2
+static int has_avx2 = -1;
+
+__attribute__((target("avx2")))
+static const char *scan_field_value_avx2(const char *p, const char *pe)
+{
+    const __m256i max_ctl = _mm256_set1_epi8(0x1F);
+    const __m256i tab = _mm256_set1_epi8('\t');
+    const __m256i del = _mm256_set1_epi8(0x7F);
+    __m256i v, end;
+    unsigned int mask;
+
+    while (pe - p >= 32) {
+      v = _mm256_loadu_si256((const __m256i *)p);
+      end = _mm256_cmpeq_epi8(_mm256_min_epu8(v, max_ctl), v);
+      end = _mm256_andnot_si256(_mm256_cmpeq_epi8(v, tab), end);
+      end = _mm256_or_si256(end, _mm256_cmpeq_epi8(v, del));
+      mask = (unsigned int)_mm256_movemask_epi8(end);
+      if (mask) return p + __builtin_ctz(mask);
+      p += 32;
+    }
+    return p;
+}
+#endif
+
+#ifdef PUMA_SCAN_SSE2
+static const char *scan_field_value_sse2(const char *p, const char *pe)
+{
+    const __m128i max_ctl = _mm_set1_epi8(0x1F);
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i del = _mm_set1_epi8(0x7F);
+    __m128i v, end;
+    unsigned int mask;
+
+    while (pe - p >= 16) {
+      v = _mm_loadu_si128((const __m128i *)p);
+      end = _mm_cmpeq_epi8(_mm_min_epu8(v, max_ctl), v);
+      end = _mm_andnot_si128(_mm_cmpeq_epi8(v, tab), end);
+      end = _mm_or_si128(end, _mm_cmpeq_epi8(v, del));
+      mask = (unsigned int)_mm_movemask_epi8(end);
+      if (mask) return p + __builtin_ctz(mask);
+      p += 16;
+    }
+    return p;
+}
+#endif
+
+/*
+ * Returns a pointer to the first byte in [p, pe) that ends a field value, or
+ * pe if the value continues past the data read so far.
+ */
+static const char *scan_field_value(const char *p, const char *pe)
+{
+#ifdef PUMA_SCAN_AVX2
+    if (has_avx2 < 0) {
+      __builtin_cpu_init();
+      has_avx2 = __builtin_cpu_supports("avx2") ? 1 : 0;
+    }
+    if (has_avx2) p = scan_field_value_avx2(p, pe);
+#endif
+#ifdef PUMA_SCAN_SSE2
+    p = scan_field_value_sse2(p, pe);
+#endif
+    while (p < pe && !is_value_end((unsigned char)*p)) p++;
+    return p;
+}
+
 #define LEN(AT, FPC) (FPC - buffer - parser->AT)
 #define MARK(M,FPC) (parser->M = (FPC) - buffer)
 #define PTR_TO(F) (buffer + parser->F)
@@ -33,28 +120,28 @@ static void snake_upcase_char(char *c)
 /** Machine **/
 
 
-#line 81 "ext/puma_http11/http11_parser.rl"
+#line 175 "ext/puma_http11/http11_parser.rl"
 
 
 /** Data **/
 
-#line 42 "ext/puma_http11/http11_parser.c"
+#line 129 "ext/puma_http11/http11_parser.c"
 static const int puma_parser_start = 1;
 static const int puma_parser_first_final = 46;
 static const int puma_parser_error = 0;
 
 
-#line 85 "ext/puma_http11/http11_parser.rl"
+#line 179 "ext/puma_http11/http11_parser.rl"
 
 int puma_parser_init(puma_parser *parser)  {
   int cs = 0;
   
-#line 53 "ext/puma_http11/http11_parser.c"
+#line 140 "ext/puma_http11/http11_parser.c"
 	{
 	cs = puma_parser_start;
 	}
 
-#line 89 "ext/puma_http11/http11_parser.rl"
+#line 183 "ext/puma_http11/http11_parser.rl"
   parser->cs = cs;
   parser->body_start = 0;
   parser->content_len = 0;
@@ -83,7 +170,7 @@ size_t puma_parser_execute(puma_parser *parser, const char *buffer, size_t len,
   assert((size_t) (pe - p) == len - off && "pointers aren't same distance");
 
   
-#line 87 "ext/puma_http11/http11_parser.c"
+#line 174 "ext/puma_http11/http11_parser.c"
 	{
 	if ( p == pe )
 		goto _test_eof;
@@ -107,14 +194,14 @@ st0:
 cs = 0;
 	goto _out;
 tr0:
-#line 37 "ext/puma_http11/http11_parser.rl"
+#line 124 "ext/puma_http11/http11_parser.rl"
 	{ MARK(mark, p); }
 	goto st2;
 st2:
 	if ( ++p == pe )
 		goto _test_eof2;
 case 2:
-#line 118 "ext/puma_http11/http11_parser.c"
+#line 205 "ext/puma_http11/http11_parser.c"
 	switch( (*p) ) {
 		case 32: goto tr2;
 		case 36: goto st27;
@@ -130,7 +217,7 @@ case 2:
 		goto st27;
 	goto st0;
 tr2:
-#line 50 "ext/puma_http11/http11_parser.rl"
+#line 144 "ext/puma_http11/http11_parser.rl"
 	{
     parser->request_method(parser, PTR_TO(mark), LEN(mark, p));
   }
@@ -139,7 +226,7 @@ st3:
 	if ( ++p == pe )
 		goto _test_eof3;
 case 3:
-#line 143 "ext/puma_http11/http11_parser.c"
+#line 230 "ext/puma_http11/http11_parser.c"
 	switch( (*p) ) {
 		case 42: goto tr4;
 		case 43: goto tr5;
@@ -156,67 +243,67 @@ case 3:
 		goto tr5;
 	goto st0;
 tr4:
-#line 37 "ext/puma_http11/http11_parser.rl"
+#line 124 "ext/puma_http11/http11_parser.rl"
 	{ MARK(mark, p); }
 	goto st4;
 st4:
 	if ( ++p == pe )
 		goto _test_eof4;
 case 4:
-#line 167 "ext/puma_http11/http11_parser.c"
+#line 254 "ext/puma_http11/http11_parser.c"
 	switch( (*p) ) {
 		case 32: goto tr8;
 		case 35: goto tr9;
 	}
 	goto st0;
 tr8:
-#line 53 "ext/puma_http11/http11_parser.rl"
+#line 147 "ext/puma_http11/http11_parser.rl"
 	{
     parser->request_uri(parser, PTR_TO(mark), LEN(mark, p));
   }
 	goto st5;
 tr31:
-#line 37 "ext/puma_http11/http11_parser.rl"
+#line 124 "ext/puma_http11/http11_parser.rl"
 	{ MARK(mark, p); }
-#line 56 "ext/puma_http11/http11_parser.rl"
+#line 150 "ext/puma_http11/http11_parser.rl"
 	{
     parser->fragment(parser, PTR_TO(mark), LEN(mark, p));
   }
 	goto st5;
 tr33:
-#line 56 "ext/puma_http11/http11_parser.rl"
+#line 150 "ext/puma_http11/http11_parser.rl"
 	{
     parser->fragment(parser, PTR_TO(mark), LEN(mark, p));
   }
 	goto st5;
 tr37:
-#line 69 "ext/puma_http11/http11_parser.rl"
+#line 163 "ext/puma_http11/http11_parser.rl"
 	{
     parser->request_path(parser, PTR_TO(mark), LEN(mark,p));
   }
-#line 53 "ext/puma_http11/http11_parser.rl"
+#line 147 "ext/puma_http11/http11_parser.rl"
 	{
     parser->request_uri(parser, PTR_TO(mark), LEN(mark, p));
   }
 	goto st5;
 tr41:
-#line 60 "ext/puma_http11/http11_parser.rl"
+#line 154 "ext/puma_http11/http11_parser.rl"
 	{ MARK(query_start, p); }
-#line 61 "ext/puma_http11/http11_parser.rl"
+#line 155 "ext/puma_http11/http11_parser.rl"
 	{
     parser->query_string(parser, PTR_TO(query_start), LEN(query_start, p));
   }
-#line 53 "ext/puma_http11/http11_parser.rl"
+#line 147 "ext/puma_http11/http11_parser.rl"
 	{
     parser->request_uri(parser, PTR_TO(mark), LEN(mark, p));
   }
 	goto st5;
 tr44:
-#line 61 "ext/puma_http11/http11_parser.rl"
+#line 155 "ext/puma_http11/http11_parser.rl"
 	{
     parser->query_string(parser, PTR_TO(query_start), LEN(query_start, p));
   }
-#line 53 "ext/puma_http11/http11_parser.rl"
+#line 147 "ext/puma_http11/http11_parser.rl"
 	{
     parser->request_uri(parser, PTR_TO(mark), LEN(mark, p));
   }
@@ -225,19 +312,19 @@ st5:
 	if ( ++p == pe )
 		goto _test_eof5;
 case 5:
-#line 229 "ext/puma_http11/http11_parser.c"
+#line 316 "ext/puma_http11/http11_parser.c"
 	if ( (*p) == 72 )
 		goto tr10;
 	goto st0;
 tr10:
-#line 37 "ext/puma_http11/http11_parser.rl"
+#line 124 "ext/puma_http11/http11_parser.rl"
 	{ MARK(mark, p); }
 	goto st6;
 st6:
 	if ( ++p == pe )
 		goto _test_eof6;
 case 6:
-#line 241 "ext/puma_http11/http11_parser.c"
+#line 328 "ext/puma_http11/http11_parser.c"
 	if ( (*p) == 84 )
 		goto st7;
 	goto st0;
@@ -295,21 +382,24 @@ case 13:
 		goto st13;
 	goto st0;
 tr18:
-#line 65 "ext/puma_http11/http11_parser.rl"
+#line 159 "ext/puma_http11/http11_parser.rl"
 	{
     parser->server_protocol(parser, PTR_TO(mark), LEN(mark, p));
   }
 	goto st14;
 tr26:
-#line 46 "ext/puma_http11/http11_parser.rl"
-	{ MARK(mark, p); }
-#line 47 "ext/puma_http11/http11_parser.rl"
+#line 137 "ext/puma_http11/http11_parser.rl"
+	{
+    MARK(mark, p);
+    if (*p != ' ' && *p != '\r') {p = (( scan_field_value(p + 1, pe)))-1;}
+  }
+#line 141 "ext/puma_http11/http11_parser.rl"
 	{
     parser->http_field(parser, PTR_TO(field_start), parser->field_len, PTR_TO(mark), LEN(mark, p));
   }
 	goto st14;
 tr29:
-#line 47 "ext/puma_http11/http11_parser.rl"
+#line 141 "ext/puma_http11/http11_parser.rl"
 	{
     parser->http_field(parser, PTR_TO(field_start), parser->field_len, PTR_TO(mark), LEN(mark, p));
   }
@@ -318,7 +408,7 @@ st14:
 	if ( ++p == pe )
 		goto _test_eof14;
 case 14:
-#line 322 "ext/puma_http11/http11_parser.c"
+#line 412 "ext/puma_http11/http11_parser.c"
 	if ( (*p) == 10 )
 		goto st15;
 	goto st0;
@@ -358,7 +448,7 @@ case 16:
 		goto tr22;
 	goto st0;
 tr22:
-#line 73 "ext/puma_http11/http11_parser.rl"
+#line 167 "ext/puma_http11/http11_parser.rl"
 	{
     parser->body_start = p - buffer + 1;
     parser->header_done(parser, p + 1, pe - p - 1);
@@ -369,23 +459,23 @@ st46:
 	if ( ++p == pe )
 		goto _test_eof46;
 case 46:
-#line 373 "ext/puma_http11/http11_parser.c"
+#line 463 "ext/puma_http11/http11_parser.c"
 	goto st0;
 tr21:
-#line 40 "ext/puma_http11/http11_parser.rl"
+#line 127 "ext/puma_http11/http11_parser.rl"
 	{ MARK(field_start, p); }
-#line 41 "ext/puma_http11/http11_parser.rl"
+#line 128 "ext/puma_http11/http11_parser.rl"
 	{ snake_upcase_char((char *)p); }
 	goto st17;
 tr23:
-#line 41 "ext/puma_http11/http11_parser.rl"
+#line 128 "ext/puma_http11/http11_parser.rl"
 	{ snake_upcase_char((char *)p); }
 	goto st17;
 st17:
 	if ( ++p == pe )
 		goto _test_eof17;
 case 17:
-#line 389 "ext/puma_http11/http11_parser.c"
+#line 479 "ext/puma_http11/http11_parser.c"
 	switch( (*p) ) {
 		case 33: goto tr23;
 		case 58: goto tr24;
@@ -411,20 +501,23 @@ case 17:
 		goto tr23;
 	goto st0;
 tr24:
-#line 42 "ext/puma_http11/http11_parser.rl"
+#line 129 "ext/puma_http11/http11_parser.rl"
 	{
     parser->field_len = LEN(field_start, p);
   }
 	goto st18;
 tr27:
-#line 46 "ext/puma_http11/http11_parser.rl"
-	{ MARK(mark, p); }
+#line 137 "ext/puma_http11/http11_parser.rl"
+	{
+    MARK(mark, p);
+    if (*p != ' ' && *p != '\r') {p = (( scan_field_value(p + 1, pe)))-1;}
+  }
 	goto st18;
 st18:
 	if ( ++p == pe )
 		goto _test_eof18;
 case 18:
-#line 428 "ext/puma_http11/http11_parser.c"
+#line 521 "ext/puma_http11/http11_parser.c"
 	switch( (*p) ) {
 		case 13: goto tr26;
 		case 32: goto tr27;
@@ -437,14 +530,17 @@ case 18:
 		goto st0;
 	goto tr25;
 tr25:
-#line 46 "ext/puma_http11/http11_parser.rl"
-	{ MARK(mark, p); }
+#line 137 "ext/puma_http11/http11_parser.rl"
+	{
+    MARK(mark, p);
+    if (*p != ' ' && *p != '\r') {p = (( scan_field_value(p + 1, pe)))-1;}
+  }
 	goto st19;
 st19:
 	if ( ++p == pe )
 		goto _test_eof19;
 case 19:
-#line 448 "ext/puma_http11/http11_parser.c"
+#line 544 "ext/puma_http11/http11_parser.c"
 	switch( (*p) ) {
 		case 13: goto tr29;
 		case 127: goto st0;
@@ -456,39 +552,39 @@ case 19:
 		goto st0;
 	goto st19;
 tr9:
-#line 53 "ext/puma_http11/http11_parser.rl"
+#line 147 "ext/puma_http11/http11_parser.rl"
 	{
     parser->request_uri(parser, PTR_TO(mark), LEN(mark, p));
   }
 	goto st20;
 tr38:
-#line 69 "ext/puma_http11/http11_parser.rl"
+#line 163 "ext/puma_http11/http11_parser.rl"
 	{
     parser->request_path(parser, PTR_TO(mark), LEN(mark,p));
   }
-#line 53 "ext/puma_http11/http11_parser.rl"
+#line 147 "ext/puma_http11/http11_parser.rl"
 	{
     parser->request_uri(parser, PTR_TO(mark), LEN(mark, p));
   }
 	goto st20;
 tr42:
-#line 60 "ext/puma_http11/http11_parser.rl"
+#line 154 "ext/puma_http11/http11_parser.rl"
 	{ MARK(query_start, p); }
-#line 61 "ext/puma_http11/http11_parser.rl"
+#line 155 "ext/puma_http11/http11_parser.rl"
 	{
     parser->query_string(parser, PTR_TO(query_start), LEN(query_start, p));
   }
-#line 53 "ext/puma_http11/http11_parser.rl"
+#line 147 "ext/puma_http11/http11_parser.rl"
 	{
     parser->request_uri(parser, PTR_TO(mark), LEN(mark, p));
   }
 	goto st20;
 tr45:
-#line 61 "ext/puma_http11/http11_parser.rl"
+#line 155 "ext/puma_http11/http11_parser.rl"
 	{
     parser->query_string(parser, PTR_TO(query_start), LEN(query_start, p));
   }
-#line 53 "ext/puma_http11/http11_parser.rl"
+#line 147 "ext/puma_http11/http11_parser.rl"
 	{
     parser->request_uri(parser, PTR_TO(mark), LEN(mark, p));
   }
@@ -497,7 +593,7 @@ st20:
 	if ( ++p == pe )
 		goto _test_eof20;
 case 20:
-#line 501 "ext/puma_http11/http11_parser.c"
+#line 597 "ext/puma_http11/http11_parser.c"
 	switch( (*p) ) {
 		case 32: goto tr31;
 		case 60: goto st0;
@@ -511,14 +607,14 @@ case 20:
 		goto st0;
 	goto tr30;
 tr30:
-#line 37 "ext/puma_http11/http11_parser.rl"
+#line 124 "ext/puma_http11/http11_parser.rl"
 	{ MARK(mark, p); }
 	goto st21;
 st21:
 	if ( ++p == pe )
 		goto _test_eof21;
 case 21:
-#line 522 "ext/puma_http11/http11_parser.c"
+#line 618 "ext/puma_http11/http11_parser.c"
 	switch( (*p) ) {
 		case 32: goto tr33;
 		case 60: goto st0;
@@ -532,14 +628,14 @@ case 21:
 		goto st0;
 	goto st21;
 tr5:
-#line 37 "ext/puma_http11/http11_parser.rl"
+#line 124 "ext/puma_http11/http11_parser.rl"
 	{ MARK(mark, p); }
 	goto st22;
 st22:
 	if ( ++p == pe )
 		goto _test_eof22;
 case 22:
-#line 543 "ext/puma_http11/http11_parser.c"
+#line 639 "ext/puma_http11/http11_parser.c"
 	switch( (*p) ) {
 		case 43: goto st22;
 		case 58: goto st23;
@@ -557,14 +653,14 @@ case 22:
 		goto st22;
 	goto st0;
 tr7:
-#line 37 "ext/puma_http11/http11_parser.rl"
+#line 124 "ext/puma_http11/http11_parser.rl"
 	{ MARK(mark, p); }
 	goto st23;
 st23:
 	if ( ++p == pe )
 		goto _test_eof23;
 case 23:
-#line 568 "ext/puma_http11/http11_parser.c"
+#line 664 "ext/puma_http11/http11_parser.c"
 	switch( (*p) ) {
 		case 32: goto tr8;
 		case 34: goto st0;
@@ -577,14 +673,14 @@ case 23:
 		goto st0;
 	goto st23;
 tr6:
-#line 37 "ext/puma_http11/http11_parser.rl"
+#line 124 "ext/puma_http11/http11_parser.rl"
 	{ MARK(mark, p); }
 	goto st24;
 st24:
 	if ( ++p == pe )
 		goto _test_eof24;
 case 24:
-#line 588 "ext/puma_http11/http11_parser.c"
+#line 684 "ext/puma_http11/http11_parser.c"
 	switch( (*p) ) {
 		case 32: goto tr37;
 		case 34: goto st0;
@@ -598,7 +694,7 @@ case 24:
 		goto st0;
 	goto st24;
 tr39:
-#line 69 "ext/puma_http11/http11_parser.rl"
+#line 163 "ext/puma_http11/http11_parser.rl"
 	{
     parser->request_path(parser, PTR_TO(mark), LEN(mark,p));
   }
@@ -607,7 +703,7 @@ st25:
 	if ( ++p == pe )
 		goto _test_eof25;
 case 25:
-#line 611 "ext/puma_http11/http11_parser.c"
+#line 707 "ext/puma_http11/http11_parser.c"
 	switch( (*p) ) {
 		case 32: goto tr41;
 		case 34: goto st0;
@@ -620,14 +716,14 @@ case 25:
 		goto st0;
 	goto tr40;
 tr40:
-#line 60 "ext/puma_http11/http11_parser.rl"
+#line 154 "ext/puma_http11/http11_parser.rl"
 	{ MARK(query_start, p); }
 	goto st26;
 st26:
 	if ( ++p == pe )
 		goto _test_eof26;
 case 26:
-#line 631 "ext/puma_http11/http11_parser.c"
+#line 727 "ext/puma_http11/http11_parser.c"
 	switch( (*p) ) {
 		case 32: goto tr44;
 		case 34: goto st0;
@@ -1021,7 +1117,7 @@ case 45:
 	_out: {}
 	}
 
-#line 117 "ext/puma_http11/http11_parser.rl"
+#line 211 "ext/puma_http11/http11_parser.rl"
 
   if (!puma_parser_has_error(parser))
     parser->cs = cs;
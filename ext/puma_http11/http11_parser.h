@@ -18,6 +18,17 @@
 
 #define BUFFER_LEN 1024
 
+/* Number of interned keys cached per parser for uncommon headers, power of 2 */
+#define FIELD_CACHE_LEN 32
+
+/*
+ * Span of a header value in the parsed data with lazy_env, offset in the
+ * high 32 bits and length in the low 32 bits, see lazy_env.c.
+ */
+#define SPAN(off, len) (((unsigned long long)(off) << 32) | (unsigned long long)(len))
+#define SPAN_OFFSET(span) ((span) >> 32)
+#define SPAN_LEN(span) ((span) & 0xffffffffULL)
+
 struct puma_parser;
 
 typedef void (*element_cb)(struct puma_parser* hp,
@@ -50,7 +61,16 @@ typedef struct puma_parser {
   element_cb header_done;
 
   char buf[BUFFER_LEN];
-  
+
+  VALUE field_cache[FIELD_CACHE_LEN];
+  size_t field_cache_hits;
+  size_t field_cache_misses;
+
+  /* lazy env, header values are recorded as spans of data */
+  int lazy;
+  const char *data;
+  VALUE spans;
+
 } puma_parser;
 
 int puma_parser_init(puma_parser *parser);
@@ -24,6 +24,93 @@ static void snake_upcase_char(char *c)
       *c = '_';
 }
 
+/*
+ * Field values are scanned in blocks of 16 (SSE2) or 32 (AVX2) bytes instead
+ * of stepping the state machine over every byte.  Define PUMA_DISABLE_SIMD to
+ * only use the scalar loop.
+ */
+#if defined(__SSE2__) && !defined(PUMA_DISABLE_SIMD)
+#include <emmintrin.h>
+#define PUMA_SCAN_SSE2 1
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define PUMA_SCAN_AVX2 1
+#endif
+#endif
+
+/* A CTL other than HTAB ends a field value, either CR or an invalid byte */
+static inline int is_value_end(unsigned char c)
+{
+    return (c < 0x20 && c != '\t') || c == 0x7F;
+}
+
+#ifdef PUMA_SCAN_AVX2
+static int has_avx2 = -1;
+
+__attribute__((target("avx2")))
+static const char *scan_field_value_avx2(const char *p, const char *pe)
+{
+    const __m256i max_ctl = _mm256_set1_epi8(0x1F);
+    const __m256i tab = _mm256_set1_epi8('\t');
+    const __m256i del = _mm256_set1_epi8(0x7F);
+    __m256i v, end;
+    unsigned int mask;
+
+    while (pe - p >= 32) {
+      v = _mm256_loadu_si256((const __m256i *)p);
+      end = _mm256_cmpeq_epi8(_mm256_min_epu8(v, max_ctl), v);
+      end = _mm256_andnot_si256(_mm256_cmpeq_epi8(v, tab), end);
+      end = _mm256_or_si256(end, _mm256_cmpeq_epi8(v, del));
+      mask = (unsigned int)_mm256_movemask_epi8(end);
+      if (mask) return p + __builtin_ctz(mask);
+      p += 32;
+    }
+    return p;
+}
+#endif
+
+#ifdef PUMA_SCAN_SSE2
+static const char *scan_field_value_sse2(const char *p, const char *pe)
+{
+    const __m128i max_ctl = _mm_set1_epi8(0x1F);
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i del = _mm_set1_epi8(0x7F);
+    __m128i v, end;
+    unsigned int mask;
+
+    while (pe - p >= 16) {
+      v = _mm_loadu_si128((const __m128i *)p);
+      end = _mm_cmpeq_epi8(_mm_min_epu8(v, max_ctl), v);
+      end = _mm_andnot_si128(_mm_cmpeq_epi8(v, tab), end);
+      end = _mm_or_si128(end, _mm_cmpeq_epi8(v, del));
+      mask = (unsigned int)_mm_movemask_epi8(end);
+      if (mask) return p + __builtin_ctz(mask);
+      p += 16;
+    }
+    return p;
+}
+#endif
+
+/*
+ * Returns a pointer to the first byte in [p, pe) that ends a field value, or
+ * pe if the value continues past the data read so far.
+ */
+static const char *scan_field_value(const char *p, const char *pe)
+{
+#ifdef PUMA_SCAN_AVX2
+    if (has_avx2 < 0) {
+      __builtin_cpu_init();
+      has_avx2 = __builtin_cpu_supports("avx2") ? 1 : 0;
+    }
+    if (has_avx2) p = scan_field_value_avx2(p, pe);
+#endif
+#ifdef PUMA_SCAN_SSE2
+    p = scan_field_value_sse2(p, pe);
+#endif
+    while (p < pe && !is_value_end((unsigned char)*p)) p++;
+    return p;
+}
+
 #define LEN(AT, FPC) (FPC - buffer - parser->AT)
 #define MARK(M,FPC) (parser->M = (FPC) - buffer)
 #define PTR_TO(F) (buffer + parser->F)
@@ -43,7 +130,14 @@ static void snake_upcase_char(char *c)
     parser->field_len = LEN(field_start, fpc);
   }
 
-  action start_value { MARK(mark, fpc); }
+  # Every byte up to the end of the value loops in the same state, so once
+  # the first byte that isn't OWS is seen, jump straight to the value's end.
+  # CR and invalid bytes are left for the machine.  Leading spaces and empty
+  # values (fpc is CR) are stepped normally.
+  action start_value {
+    MARK(mark, fpc);
+    if (*fpc != ' ' && *fpc != '\r') fexec scan_field_value(fpc + 1, pe);
+  }
   action write_value {
     parser->http_field(parser, PTR_TO(field_start), parser->field_len, PTR_TO(mark), LEN(mark, fpc));
   }
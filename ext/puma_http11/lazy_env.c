@@ -0,0 +1,145 @@
+#define RSTRING_NOT_MODIFIED 1
+
+#include <ruby.h>
+#include "http11_parser.h"
+
+/*
+ * The methods of Puma::LazyEnv that are called for most env reads, the rest
+ * are in lib/puma/lazy_env.rb.  Pending header values are in @lazy_spans,
+ * a Hash of key to span into the request buffer @lazy_data, see
+ * HttpParser#lazy_spans.
+ */
+
+static ID id_lazy_data;
+static ID id_lazy_spans;
+
+static VALUE span_string(VALUE data, VALUE span)
+{
+  unsigned long long s = NUM2ULL(span);
+
+  if (SPAN_OFFSET(s) + SPAN_LEN(s) > (unsigned long long)RSTRING_LEN(data)) {
+    rb_raise(rb_eIndexError, "%s", "header span is outside of the request buffer");
+  }
+  return rb_str_new(RSTRING_PTR(data) + SPAN_OFFSET(s), SPAN_LEN(s));
+}
+
+static void lazy_release(VALUE self)
+{
+  rb_ivar_set(self, id_lazy_data, Qnil);
+  rb_ivar_set(self, id_lazy_spans, Qnil);
+}
+
+/* Creates and stores the value of key if it's pending, Qundef otherwise */
+static VALUE lazy_value(VALUE self, VALUE key)
+{
+  VALUE spans = rb_ivar_get(self, id_lazy_spans);
+  VALUE span, v;
+
+  if (NIL_P(spans)) return Qundef;
+
+  span = rb_hash_lookup2(spans, key, Qundef);
+  if (span == Qundef) return Qundef;
+
+  v = span_string(rb_ivar_get(self, id_lazy_data), span);
+  rb_hash_aset(self, key, v);
+  rb_hash_delete(spans, key);
+  if (RHASH_SIZE(spans) == 0) lazy_release(self);
+  return v;
+}
+
+static int lazy_values_i(VALUE key, VALUE span, VALUE ary)
+{
+  VALUE self = rb_ary_entry(ary, 0);
+
+  rb_hash_aset(self, key, span_string(rb_ary_entry(ary, 1), span));
+  return ST_CONTINUE;
+}
+
+/**
+ * call-seq:
+ *    env.lazy_headers(data, spans) -> nil
+ *
+ * Sets the pending header values, +spans+ is HttpParser#lazy_spans and
+ * +data+ the String passed to HttpParser#execute.
+ */
+static VALUE LazyEnv_lazy_headers(VALUE self, VALUE data, VALUE spans)
+{
+  if (NIL_P(spans) || RHASH_SIZE(spans) == 0) return Qnil;
+
+  StringValue(data);
+  Check_Type(spans, T_HASH);
+  rb_ivar_set(self, id_lazy_data, data);
+  rb_ivar_set(self, id_lazy_spans, spans);
+  return Qnil;
+}
+
+/**
+ * call-seq:
+ *    env[key] -> value
+ *
+ * Hash#[], creating the value if it's a pending header.
+ */
+static VALUE LazyEnv_aref(VALUE self, VALUE key)
+{
+  VALUE v = rb_hash_lookup2(self, key, Qundef);
+
+  if (v != Qundef) return v;
+
+  v = lazy_value(self, key);
+  if (v != Qundef) return v;
+
+  return rb_hash_aref(self, key);
+}
+
+/**
+ * call-seq:
+ *    env.key?(key) -> true/false
+ *
+ * Hash#key?, true for pending headers without creating their value.
+ */
+static VALUE LazyEnv_has_key(VALUE self, VALUE key)
+{
+  VALUE spans;
+
+  if (rb_hash_lookup2(self, key, Qundef) != Qundef) return Qtrue;
+
+  spans = rb_ivar_get(self, id_lazy_spans);
+  if (!NIL_P(spans) && rb_hash_lookup2(spans, key, Qundef) != Qundef) return Qtrue;
+
+  return Qfalse;
+}
+
+/* Creates the value of key if it's pending, returns nil */
+static VALUE LazyEnv_lazy_value(VALUE self, VALUE key)
+{
+  lazy_value(self, key);
+  return Qnil;
+}
+
+/* Creates all pending values, returns nil */
+static VALUE LazyEnv_lazy_values(VALUE self)
+{
+  VALUE spans = rb_ivar_get(self, id_lazy_spans);
+
+  if (NIL_P(spans)) return Qnil;
+
+  rb_hash_foreach(spans, lazy_values_i, rb_assoc_new(self, rb_ivar_get(self, id_lazy_data)));
+  lazy_release(self);
+  return Qnil;
+}
+
+void Init_lazy_env(VALUE puma) {
+  VALUE cLazyEnv = rb_define_class_under(puma, "LazyEnv", rb_cHash);
+
+  id_lazy_data = rb_intern("@lazy_data");
+  id_lazy_spans = rb_intern("@lazy_spans");
+
+  rb_define_method(cLazyEnv, "lazy_headers", LazyEnv_lazy_headers, 2);
+  rb_define_method(cLazyEnv, "[]", LazyEnv_aref, 1);
+  rb_define_method(cLazyEnv, "key?", LazyEnv_has_key, 1);
+  rb_define_method(cLazyEnv, "has_key?", LazyEnv_has_key, 1);
+  rb_define_method(cLazyEnv, "include?", LazyEnv_has_key, 1);
+  rb_define_method(cLazyEnv, "member?", LazyEnv_has_key, 1);
+  rb_define_private_method(cLazyEnv, "lazy_value", LazyEnv_lazy_value, 1);
+  rb_define_protected_method(cLazyEnv, "lazy_values", LazyEnv_lazy_values, 0);
+}
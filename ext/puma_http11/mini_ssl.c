@@ -3,6 +3,8 @@
 #include <ruby.h>
 #include <ruby/version.h>
 #include <ruby/io.h>
+#include <ruby/encoding.h>
+#include <ruby/thread.h>
 
 #ifdef HAVE_OPENSSL_BIO_H
 
@@ -11,16 +13,23 @@
 #include <openssl/dh.h>
 #include <openssl/err.h>
 #include <openssl/x509.h>
+#include <limits.h>
 
 #ifndef SSL_OP_NO_COMPRESSION
 #define SSL_OP_NO_COMPRESSION 0
 #endif
 
+/* kernel TLS, OpenSSL 3.0 on Linux, see `MiniSSL::Context#ktls=` */
+#if defined(SSL_OP_ENABLE_KTLS) && !defined(OPENSSL_NO_KTLS) && defined(__linux__)
+#define PUMA_HAS_KTLS 1
+#endif
+
 typedef struct {
   BIO* read;
   BIO* write;
   SSL* ssl;
   SSL_CTX* ctx;
+  int busy;
 } ms_conn;
 
 typedef struct {
@@ -230,7 +239,8 @@ sslctx_initialize(VALUE self, VALUE mini_ssl_ctx) {
   SSL_CTX* ctx;
   int ssl_options;
   VALUE key, cert, ca, verify_mode, ssl_cipher_filter, ssl_ciphersuites, no_tlsv1, no_tlsv1_1,
-    verification_flags, session_id_bytes, cert_pem, key_pem, key_password_command, key_password;
+    verification_flags, session_id_bytes, cert_pem, key_pem, key_password_command, key_password,
+    ktls;
   BIO *bio;
   X509 *x509 = NULL;
   EVP_PKEY *pkey;
@@ -275,6 +285,8 @@ sslctx_initialize(VALUE self, VALUE mini_ssl_ctx) {
 
   no_tlsv1_1 = rb_funcall(mini_ssl_ctx, rb_intern_const("no_tlsv1_1"), 0);
 
+  ktls = rb_funcall(mini_ssl_ctx, rb_intern_const("ktls"), 0);
+
   TypedData_Get_Struct(self, SSL_CTX, &sslctx_type, ctx);
 
   if (!NIL_P(cert)) {
@@ -436,6 +448,13 @@ sslctx_initialize(VALUE self, VALUE mini_ssl_ctx) {
   }
 #endif
 
+#ifdef PUMA_HAS_KTLS
+  /* only used by engines created with a socket, see engine_init_server */
+  if (RTEST(ktls)) {
+    ssl_options |= SSL_OP_ENABLE_KTLS;
+  }
+#endif
+
   SSL_CTX_set_options(ctx, ssl_options);
 
   if (!NIL_P(ssl_cipher_filter)) {
@@ -494,12 +513,22 @@ sslctx_initialize(VALUE self, VALUE mini_ssl_ctx) {
   return self;
 }
 
-VALUE engine_init_server(VALUE self, VALUE sslctx) {
+/*
+ * call-seq:
+ *    Engine.server(sslctx, fd = nil) -> engine
+ *
+ * Without +fd+, data is passed through memory BIOs with #inject and
+ * #extract.  With the file descriptor of the accepted socket, OpenSSL reads
+ * and writes it directly, which kTLS needs, and #inject can't be used.
+ */
+VALUE engine_init_server(int argc, VALUE *argv, VALUE self) {
   ms_conn* conn;
-  VALUE obj;
+  VALUE obj, sslctx, fd;
   SSL_CTX* ctx;
   SSL* ssl;
 
+  rb_scan_args(argc, argv, "11", &sslctx, &fd);
+
   conn = engine_alloc(self, &obj);
 
   TypedData_Get_Struct(sslctx, SSL_CTX, &sslctx_type, ctx);
@@ -507,7 +536,17 @@ VALUE engine_init_server(VALUE self, VALUE sslctx) {
   ssl = SSL_new(ctx);
   conn->ssl = ssl;
   SSL_set_app_data(ssl, NULL);
-  SSL_set_bio(ssl, conn->read, conn->write);
+  if (NIL_P(fd)) {
+    SSL_set_bio(ssl, conn->read, conn->write);
+  } else {
+    BIO_free(conn->read);
+    BIO_free(conn->write);
+    conn->read = NULL;
+    conn->write = NULL;
+    if (SSL_set_fd(ssl, NUM2INT(fd)) != 1) {
+      raise_param_error("SSL_set_fd", "fd");
+    }
+  }
   SSL_set_accept_state(ssl);
   return obj;
 }
@@ -530,11 +569,86 @@ VALUE engine_init_client(VALUE klass) {
   return obj;
 }
 
+/*
+ * Writes and extracts of four TLS records or more run without the GVL, see
+ * engine_nogvl.  Fewer bytes are encrypted or copied faster than the GVL is
+ * released and taken again.
+ */
+#define ENGINE_NOGVL_MIN 65536
+
+/*
+ * Partial writes are enabled, SSL_write encrypts one record per call, so
+ * without the GVL it's called for up to this many bytes at once.  More
+ * grows the write BIO past the CPU caches.
+ */
+#define ENGINE_NOGVL_WRITE_MAX 262144
+
+typedef struct {
+  ms_conn* conn;
+  void *(*func)(void *);
+  char* buf;
+  int len;
+  int bytes;
+} engine_nogvl_args;
+
+static VALUE engine_nogvl_call(VALUE ptr) {
+  engine_nogvl_args* args = (engine_nogvl_args*)ptr;
+
+  rb_thread_call_without_gvl(args->func, args, NULL, NULL);
+  return Qnil;
+}
+
+static VALUE engine_nogvl_ensure(VALUE ptr) {
+  ((engine_nogvl_args*)ptr)->conn->busy = 0;
+  return Qnil;
+}
+
+/*
+ * Runs args->func without the GVL, the engine isn't used by other threads
+ * meanwhile, see engine_check_busy.  OpenSSL's error queue is per native
+ * thread, so errors are read after it as usual.
+ */
+static void engine_nogvl(ms_conn* conn, engine_nogvl_args* args) {
+  args->conn = conn;
+  conn->busy = 1;
+  rb_ensure(engine_nogvl_call, (VALUE)args, engine_nogvl_ensure, (VALUE)args);
+}
+
+static void engine_check_busy(ms_conn* conn) {
+  if (conn->busy) rb_raise(eError, "%s", "engine used by another thread");
+}
+
+static void *engine_write_nogvl(void *ptr) {
+  engine_nogvl_args* args = ptr;
+  int ret, total = 0;
+
+  do {
+    ret = SSL_write(args->conn->ssl, args->buf + total, args->len - total);
+    if (ret > 0) total += ret;
+  } while (ret > 0 && total < args->len);
+
+  /* an error after some bytes is returned by the next call */
+  args->bytes = total > 0 ? total : ret;
+  return NULL;
+}
+
+static void *engine_extract_nogvl(void *ptr) {
+  engine_nogvl_args* args = ptr;
+
+  args->bytes = BIO_read(args->conn->write, args->buf, args->len);
+  return NULL;
+}
+
 VALUE engine_inject(VALUE self, VALUE str) {
   ms_conn* conn;
   long used;
 
   TypedData_Get_Struct(self, ms_conn, &engine_data_type, conn);
+  engine_check_busy(conn);
+
+  if (!conn->read) {
+    rb_raise(eError, "%s", "inject can't be used when the engine reads the socket");
+  }
 
   StringValue(str);
 
@@ -581,26 +695,82 @@ void raise_error(SSL* ssl, int result) {
   rb_raise(eError, "%s", msg);
 }
 
-VALUE engine_read(VALUE self) {
+/*
+ * Plaintext is read a TLS record at a time, 16 kB is the largest record, see
+ * SSL3_RT_MAX_PLAIN_LENGTH.
+ */
+#define ENGINE_READ_SIZE 16384
+
+/*
+ * call-seq:
+ *    engine.read(buffer = nil) -> String or nil
+ *
+ * Returns all the plaintext that can be decrypted from the injected data in
+ * one String, or nil if none.  If +buffer+ is given, its contents are
+ * replaced and it is returned.
+ */
+VALUE engine_read(int argc, VALUE *argv, VALUE self) {
   ms_conn* conn;
-  char buf[512];
+  char buf[ENGINE_READ_SIZE];
+  VALUE str;
+  long len = 0, want;
   int bytes, error;
 
+  rb_scan_args(argc, argv, "01", &str);
+
   TypedData_Get_Struct(self, ms_conn, &engine_data_type, conn);
+  engine_check_busy(conn);
 
   ERR_clear_error();
 
-  bytes = SSL_read(conn->ssl, (void*)buf, sizeof(buf));
+  if (NIL_P(str)) {
+    /* the first record is read before a String is created */
+    bytes = SSL_read(conn->ssl, (void*)buf, sizeof(buf));
+    if (bytes > 0) {
+      str = rb_str_buf_new(bytes + SSL_pending(conn->ssl));
+      rb_str_cat(str, buf, bytes);
+      len = bytes;
+    }
+  } else {
+    StringValue(str);
+    rb_str_modify(str);
+    rb_enc_associate_index(str, rb_ascii8bit_encindex());
+    rb_str_set_len(str, 0);
+    bytes = 1;
+  }
 
-  if(bytes > 0) {
-    return rb_str_new(buf, bytes);
+  /* read directly into the String until no records are left */
+  while (bytes > 0) {
+    want = SSL_pending(conn->ssl);
+    if (want == 0) {
+      if (len > 0 && (!conn->read || BIO_ctrl_pending(conn->read) == 0)) break;
+      want = ENGINE_READ_SIZE;
+    }
+    if (rb_str_capacity(str) - len < (size_t)want) {
+      rb_str_modify_expand(str, want);
+    }
+    bytes = SSL_read(conn->ssl, RSTRING_PTR(str) + len, (int)want);
+    if (bytes > 0) {
+      len += bytes;
+      rb_str_set_len(str, len);
+    }
+  }
+
+  if (len > 0) {
+    /* an error after some data is returned by the next call */
+    ERR_clear_error();
+    return str;
   }
 
   if(SSL_want_read(conn->ssl)) return Qnil;
 
+  /* only when reading a socket, a handshake write would block */
+  if(SSL_want_write(conn->ssl)) return ID2SYM(rb_intern("wait_writable"));
+
   error = SSL_get_error(conn->ssl, bytes);
 
-  if(error == SSL_ERROR_ZERO_RETURN) {
+  /* a socket closed without a close_notify alert */
+  if(error == SSL_ERROR_ZERO_RETURN || (error == SSL_ERROR_SYSCALL && bytes == 0 && !conn->read)) {
     rb_eof_error();
   } else {
     raise_error(conn->ssl, bytes);
@@ -609,17 +779,40 @@ VALUE engine_read(VALUE self) {
   return Qnil;
 }
 
+/*
+ * call-seq:
+ *    engine.write(str) -> Integer or nil
+ *
+ * Encrypts +str+, returns the bytes written, or nil when the socket the
+ * engine writes to isn't writable.  A +str+ of ENGINE_NOGVL_MIN bytes or
+ * more is encrypted without the GVL, up to ENGINE_NOGVL_WRITE_MAX bytes in
+ * one call, from a frozen String sharing its bytes, so it can't change
+ * meanwhile.
+ */
 VALUE engine_write(VALUE self, VALUE str) {
   ms_conn* conn;
   int bytes;
+  engine_nogvl_args args;
 
   TypedData_Get_Struct(self, ms_conn, &engine_data_type, conn);
+  engine_check_busy(conn);
 
   StringValue(str);
 
   ERR_clear_error();
 
-  bytes = SSL_write(conn->ssl, (void*)RSTRING_PTR(str), (int)RSTRING_LEN(str));
+  if (RSTRING_LEN(str) >= ENGINE_NOGVL_MIN) {
+    /* a copy only when str is changed later */
+    str = rb_str_new_frozen(str);
+    args.func = engine_write_nogvl;
+    args.buf = RSTRING_PTR(str);
+    args.len = RSTRING_LEN(str) > ENGINE_NOGVL_WRITE_MAX ? ENGINE_NOGVL_WRITE_MAX : (int)RSTRING_LEN(str);
+    engine_nogvl(conn, &args);
+    bytes = args.bytes;
+    RB_GC_GUARD(str);
+  } else {
+    bytes = SSL_write(conn->ssl, (void*)RSTRING_PTR(str), (int)RSTRING_LEN(str));
+  }
   if(bytes > 0) {
     return INT2FIX(bytes);
   }
@@ -631,27 +824,63 @@ VALUE engine_write(VALUE self, VALUE str) {
   return Qnil;
 }
 
+/*
+ * call-seq:
+ *    engine.extract -> String or nil
+ *
+ * Returns all the TLS data waiting to be written to the socket in one
+ * String, or nil if none.  ENGINE_NOGVL_MIN bytes or more are copied
+ * without the GVL, to a String no other thread references yet.
+ */
 VALUE engine_extract(VALUE self) {
   ms_conn* conn;
   int bytes;
   size_t pending;
-  // https://www.openssl.org/docs/manmaster/man3/BIO_f_buffer.html
-  // crypto/bio/bf_buff.c DEFAULT_BUFFER_SIZE
-  char buf[4096];
+  long len = 0;
+  VALUE str;
+  engine_nogvl_args args;
 
   TypedData_Get_Struct(self, ms_conn, &engine_data_type, conn);
+  engine_check_busy(conn);
+
+  if(!conn->write) return Qnil;
 
   pending = BIO_pending(conn->write);
-  if(pending > 0) {
-    bytes = BIO_read(conn->write, buf, sizeof(buf));
+  if(pending == 0) return Qnil;
+
+  str = rb_str_buf_new(pending);
+
+  if (pending >= ENGINE_NOGVL_MIN && pending <= INT_MAX) {
+    args.func = engine_extract_nogvl;
+    args.buf = RSTRING_PTR(str);
+    args.len = (int)pending;
+    engine_nogvl(conn, &args);
+    if (args.bytes > 0) {
+      len = args.bytes;
+      rb_str_set_len(str, len);
+    } else if (!BIO_should_retry(conn->write)) {
+      raise_error(conn->ssl, args.bytes);
+    }
+    pending = BIO_pending(conn->write);
+  }
+
+  while(pending > 0) {
+    if (rb_str_capacity(str) - len < pending) {
+      rb_str_modify_expand(str, pending);
+    }
+    bytes = BIO_read(conn->write, RSTRING_PTR(str) + len, (int)pending);
     if(bytes > 0) {
-      return rb_str_new(buf, bytes);
+      len += bytes;
+      rb_str_set_len(str, len);
     } else if(!BIO_should_retry(conn->write)) {
       raise_error(conn->ssl, bytes);
+    } else {
+      break;
     }
+    pending = BIO_pending(conn->write);
   }
 
-  return Qnil;
+  return len > 0 ? str : Qnil;
 }
 
 VALUE engine_shutdown(VALUE self) {
@@ -660,6 +889,9 @@ VALUE engine_shutdown(VALUE self) {
 
   TypedData_Get_Struct(self, ms_conn, &engine_data_type, conn);
 
+  /* closed while another thread writes, the close_notify alert is skipped */
+  if (conn->busy) return Qtrue;
+
   if (SSL_in_init(conn->ssl)) {
     // Avoid "shutdown while in init" error
     // See https://github.com/openssl/openssl/blob/openssl-3.5.2/ssl/ssl_lib.c#L2827-L2828
@@ -746,6 +978,23 @@ engine_ssl_vers_st(VALUE self) {
   return rb_ary_new3(2, rb_str_new2(SSL_get_version(conn->ssl)), rb_str_new2(SSL_state_string(conn->ssl)));
 }
 
+/*
+ * call-seq:
+ *    engine.ktls_send? -> true/false
+ *
+ * True once the handshake is done and the kernel encrypts what is written to
+ * the socket, only for engines created with a socket.
+ */
+static VALUE
+engine_ktls_send(VALUE self) {
+  ms_conn* conn;
+  TypedData_Get_Struct(self, ms_conn, &engine_data_type, conn);
+#ifdef PUMA_HAS_KTLS
+  if (!conn->write && BIO_get_ktls_send(SSL_get_wbio(conn->ssl))) return Qtrue;
+#endif
+  return Qfalse;
+}
+
 VALUE noop(VALUE self) {
   return Qnil;
 }
@@ -807,15 +1056,22 @@ void Init_mini_ssl(VALUE puma) {
   rb_define_const(mod, "OPENSSL_NO_TLS1_1", Qfalse);
 #endif
 
+#ifdef PUMA_HAS_KTLS
+  /* True if OpenSSL supports kernel TLS, see `Context#ktls=` */
+  rb_define_const(mod, "HAS_KTLS", Qtrue);
+#else
+  rb_define_const(mod, "HAS_KTLS", Qfalse);
+#endif
+
   rb_define_singleton_method(mod, "check", noop, 0);
 
   eError = rb_define_class_under(mod, "SSLError", rb_eStandardError);
 
-  rb_define_singleton_method(eng, "server", engine_init_server, 1);
+  rb_define_singleton_method(eng, "server", engine_init_server, -1);
   rb_define_singleton_method(eng, "client", engine_init_client, 0);
 
   rb_define_method(eng, "inject", engine_inject, 1);
-  rb_define_method(eng, "read",  engine_read, 0);
+  rb_define_method(eng, "read",  engine_read, -1);
 
   rb_define_method(eng, "write",  engine_write, 1);
   rb_define_method(eng, "extract", engine_extract, 0);
@@ -831,6 +1087,8 @@ void Init_mini_ssl(VALUE puma) {
   rb_define_method(eng, "peercert", engine_peercert, 0);
 
   rb_define_method(eng, "ssl_vers_st", engine_ssl_vers_st, 0);
+
+  rb_define_method(eng, "ktls_send?", engine_ktls_send, 0);
 }
 
 #else
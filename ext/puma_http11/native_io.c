@@ -0,0 +1,323 @@
+#define RSTRING_NOT_MODIFIED 1
+
+#include <ruby.h>
+#include <ruby/io.h>
+#include <ruby/thread.h>
+#include <errno.h>
+
+/*
+ * Puma::NativeIO, writes to a socket without copying the Strings or file
+ * into one buffer first.  Used by `Puma::Response#fast_write_response` for
+ * plain sockets, the socket is non-blocking.  Also accepts the connections
+ * queued on a listener in one call, for `Puma::Server#handle_servers`.
+ */
+
+static int io_fd(VALUE io)
+{
+#ifdef HAVE_RB_IO_DESCRIPTOR
+  return rb_io_descriptor(io);
+#else
+  rb_io_t *fptr;
+  GetOpenFile(io, fptr);
+  rb_io_check_closed(fptr);
+  return fptr->fd;
+#endif
+}
+
+#ifdef HAVE_SYS_UIO_H
+#include <sys/uio.h>
+#include <limits.h>
+
+/* Strings passed to each writev call */
+#if defined(IOV_MAX) && IOV_MAX < 1024
+#define WRITEV_MAX IOV_MAX
+#else
+#define WRITEV_MAX 1024
+#endif
+
+/* fewer bytes are copied to the socket faster than the GVL is released */
+#define WRITEV_NOGVL_MIN 65536
+
+struct writev_args {
+  int fd;
+  struct iovec *iov;
+  int cnt;
+  int err;
+};
+
+static void *writev_nogvl(void *ptr)
+{
+  struct writev_args *args = ptr;
+  ssize_t ret = writev(args->fd, args->iov, args->cnt);
+
+  args->err = errno;
+  return (void *)(intptr_t)ret;
+}
+
+/**
+ * call-seq:
+ *    Puma::NativeIO.writev(io, strings, timeout) -> Integer or nil
+ *
+ * Writes all of +strings+ to +io+, +WRITEV_MAX+ at a time with writev(2).
+ * Partial writes continue from where they stopped, and when the socket
+ * isn't writable it waits up to +timeout+ seconds each time.  Returns the
+ * bytes written, or +nil+ if the wait timed out.
+ *
+ * When +strings+ hold +WRITEV_NOGVL_MIN+ bytes or more, writev runs without
+ * the GVL, on frozen Strings sharing their bytes, so other threads can't
+ * change what is written meanwhile.  They're kept in a buffer the GC marks
+ * conservatively, like io.c does, so compaction can't move the bytes of
+ * small, embedded Strings.
+ *
+ * Raises SystemCallError if writev fails, for instance Errno::EPIPE.
+ */
+static VALUE NativeIO_writev(VALUE self, VALUE io, VALUE strings, VALUE timeout)
+{
+  struct iovec iov[WRITEV_MAX];
+  struct writev_args args;
+  long i = 0, j, n, cnt;
+  size_t off = 0, total = 0, size = 0;
+  ssize_t ret;
+  int nogvl;
+  VALUE str, *strs, tmp = 0;
+
+  io = rb_io_get_io(io);
+  Check_Type(strings, T_ARRAY);
+
+  n = RARRAY_LEN(strings);
+  strs = ALLOCV_N(VALUE, tmp, n);
+  for (j = 0; j < n; j++) {
+    str = RARRAY_AREF(strings, j);
+    Check_Type(str, T_STRING);
+    size += RSTRING_LEN(str);
+    strs[j] = str;
+  }
+
+  nogvl = size >= WRITEV_NOGVL_MIN;
+  if (nogvl) {
+    /* a copy only when a String is changed later */
+    for (j = 0; j < n; j++) strs[j] = rb_str_new_frozen(strs[j]);
+  }
+  args.iov = iov;
+
+  while (1) {
+    /* skip empty Strings and ones that were written */
+    while (i < n && (size_t)RSTRING_LEN(strs[i]) <= off) {
+      off = 0;
+      i++;
+    }
+    if (i >= n) break;
+
+    /* pointers are set again each time, a String may change while waiting */
+    for (cnt = 0, j = i; j < n && cnt < WRITEV_MAX; j++) {
+      str = strs[j];
+      if (RSTRING_LEN(str) == 0) continue;
+      iov[cnt].iov_base = RSTRING_PTR(str) + (j == i ? off : 0);
+      iov[cnt].iov_len = RSTRING_LEN(str) - (j == i ? off : 0);
+      cnt++;
+    }
+
+    args.fd = io_fd(io);
+    args.cnt = (int)cnt;
+    if (!nogvl) {
+      ret = writev(args.fd, iov, args.cnt);
+    } else {
+      ret = (ssize_t)(intptr_t)rb_thread_call_without_gvl(writev_nogvl, &args, RUBY_UBF_IO, NULL);
+      errno = args.err;
+    }
+
+    if (ret < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        if (!RTEST(rb_io_wait(io, RB_INT2NUM(RUBY_IO_WRITABLE), timeout))) {
+          ALLOCV_END(tmp);
+          return Qnil;
+        }
+        continue;
+      }
+      if (errno == EINTR) {
+        rb_thread_check_ints();
+        continue;
+      }
+      rb_sys_fail("writev");
+    }
+
+    total += ret;
+
+    /* advance past the bytes written */
+    while (ret > 0) {
+      size_t left = RSTRING_LEN(strs[i]) - off;
+      if ((size_t)ret < left) {
+        off += ret;
+        ret = 0;
+      } else {
+        ret -= left;
+        off = 0;
+        i++;
+      }
+    }
+  }
+
+  ALLOCV_END(tmp);
+  return SIZET2NUM(total);
+}
+#endif
+
+#ifdef HAVE_SENDFILE
+#include <sys/sendfile.h>
+
+/* Bytes passed to each sendfile call, Linux sends at most 0x7ffff000 */
+#define SENDFILE_MAX (1 << 30)
+
+struct sendfile_args {
+  int out_fd;
+  int in_fd;
+  off_t *off;
+  size_t count;
+  int err;
+};
+
+/* Without the GVL, reading the file may wait for the disk */
+static void *sendfile_nogvl(void *ptr)
+{
+  struct sendfile_args *args = ptr;
+  ssize_t ret = sendfile(args->out_fd, args->in_fd, args->off, args->count);
+
+  args->err = errno;
+  return (void *)(intptr_t)ret;
+}
+
+/**
+ * call-seq:
+ *    Puma::NativeIO.sendfile(io, file, offset, length, timeout) -> Integer or nil
+ *
+ * Sends +length+ bytes of +file+ starting at +offset+ to +io+ with
+ * sendfile(2), the position of +file+ isn't changed.  When the socket isn't
+ * writable it waits up to +timeout+ seconds each time.  Returns the bytes
+ * sent, which are less than +length+ if the file is shorter, or +nil+ if
+ * the wait timed out.
+ *
+ * Raises SystemCallError if sendfile fails, for instance Errno::EPIPE.
+ */
+static VALUE NativeIO_sendfile(VALUE self, VALUE io, VALUE file, VALUE offset,
+  VALUE length, VALUE timeout)
+{
+  off_t off = NUM2OFFT(offset);
+  size_t left = NUM2SIZET(length), total = 0;
+  ssize_t ret;
+  struct sendfile_args args;
+
+  io = rb_io_get_io(io);
+  file = rb_io_get_io(file);
+  args.in_fd = io_fd(file);
+  args.off = &off;
+
+  while (left > 0) {
+    args.out_fd = io_fd(io);
+    args.count = left < SENDFILE_MAX ? left : SENDFILE_MAX;
+    ret = (ssize_t)(intptr_t)rb_thread_call_without_gvl(sendfile_nogvl, &args, RUBY_UBF_IO, NULL);
+
+    if (ret < 0) {
+      errno = args.err;
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        if (!RTEST(rb_io_wait(io, RB_INT2NUM(RUBY_IO_WRITABLE), timeout))) return Qnil;
+        continue;
+      }
+      if (errno == EINTR) {
+        rb_thread_check_ints();
+        continue;
+      }
+      rb_sys_fail("sendfile");
+    }
+    if (ret == 0) break; /* end of file */
+
+    total += ret;
+    left -= ret;
+  }
+
+  return SIZET2NUM(total);
+}
+#endif
+
+#ifdef HAVE_ACCEPT4
+#include <sys/socket.h>
+#include <unistd.h>
+
+static ID id_for_fd;
+
+struct for_fd_args {
+  VALUE klass;
+  int fd;
+};
+
+static VALUE for_fd(VALUE ptr)
+{
+  struct for_fd_args *args = (struct for_fd_args *)ptr;
+  return rb_funcall(args->klass, id_for_fd, 1, INT2NUM(args->fd));
+}
+
+/**
+ * call-seq:
+ *    Puma::NativeIO.accept(server, max) -> Array
+ *
+ * Accepts up to +max+ connections queued on +server+, a TCPServer or
+ * UNIXServer, with accept4(2).  Returns the TCPSockets or UNIXSockets, which
+ * are non-blocking and close-on-exec, an empty Array if none are queued.
+ *
+ * Stops at the first error, other than a connection aborted before it was
+ * accepted, without raising.  The error is raised by the next
+ * +accept_nonblock+.
+ */
+static VALUE NativeIO_accept(VALUE self, VALUE server, VALUE max)
+{
+  long n = NUM2LONG(max);
+  VALUE ary = rb_ary_new(), klass, sock;
+  struct for_fd_args args;
+  int fd, state;
+
+  if (rb_obj_is_kind_of(server, rb_path2class("TCPServer"))) {
+    klass = rb_path2class("TCPSocket");
+  } else if (rb_obj_is_kind_of(server, rb_path2class("UNIXServer"))) {
+    klass = rb_path2class("UNIXSocket");
+  } else {
+    rb_raise(rb_eTypeError, "not a TCPServer or UNIXServer");
+  }
+  args.klass = klass;
+
+  while (RARRAY_LEN(ary) < n) {
+    fd = accept4(io_fd(server), NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0) {
+      if (errno == ECONNABORTED || errno == EPROTO) continue;
+      if (errno == EINTR) {
+        rb_thread_check_ints();
+        continue;
+      }
+      break;
+    }
+
+    args.fd = fd;
+    sock = rb_protect(for_fd, (VALUE)&args, &state);
+    if (state) {
+      close(fd);
+      rb_jump_tag(state);
+    }
+    rb_ary_push(ary, sock);
+  }
+
+  return ary;
+}
+#endif
+
+void Init_native_io(VALUE puma) {
+  VALUE mNativeIO = rb_define_module_under(puma, "NativeIO");
+
+#ifdef HAVE_SYS_UIO_H
+  rb_define_module_function(mNativeIO, "writev", NativeIO_writev, 3);
+#endif
+#ifdef HAVE_SENDFILE
+  rb_define_module_function(mNativeIO, "sendfile", NativeIO_sendfile, 5);
+#endif
+#ifdef HAVE_ACCEPT4
+  id_for_fd = rb_intern("for_fd");
+  rb_define_module_function(mNativeIO, "accept", NativeIO_accept, 2);
+#endif
+}
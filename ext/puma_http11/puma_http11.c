@@ -117,13 +117,30 @@ static struct common_field common_http_fields[] = {
 # undef f
 };
 
+/*
+ * Open addressed lookup table for common_http_fields, indexed by
+ * COMMON_FIELD_HASH.  Each slot holds an index into common_http_fields plus
+ * one, zero marks an empty slot.  The hash is collision free for the fields
+ * above, so a lookup is a single compare.  Linear probing keeps lookups
+ * correct if a field added later happens to collide.
+ */
+#define COMMON_FIELD_SLOTS 128
+#define COMMON_FIELD_HASH(field, flen) \
+  (((flen) + ((unsigned char)(field)[0] * 10) + \
+    ((unsigned char)(field)[(flen) - 1] * 8)) & (COMMON_FIELD_SLOTS - 1))
+
+static unsigned char common_field_slots[COMMON_FIELD_SLOTS];
+
 static void init_common_fields(void)
 {
   unsigned i;
+  size_t idx;
   struct common_field *cf = common_http_fields;
   char tmp[256]; /* MAX_FIELD_NAME_LENGTH */
   memcpy(tmp, HTTP_PREFIX, HTTP_PREFIX_LEN);
 
+  assert(ARRAY_SIZE(common_http_fields) < COMMON_FIELD_SLOTS);
+
   for(i = 0; i < ARRAY_SIZE(common_http_fields); cf++, i++) {
     rb_global_variable(&cf->value);
     if(cf->raw) {
@@ -132,24 +149,109 @@ static void init_common_fields(void)
       memcpy(tmp + HTTP_PREFIX_LEN, cf->name, cf->len + 1);
       cf->value = rb_enc_interned_str(tmp, HTTP_PREFIX_LEN + cf->len, rb_utf8_encoding());
     }
+
+    idx = COMMON_FIELD_HASH(cf->name, cf->len);
+    while (common_field_slots[idx]) {
+      idx = (idx + 1) & (COMMON_FIELD_SLOTS - 1);
+    }
+    common_field_slots[idx] = (unsigned char)(i + 1);
   }
 }
 
 static VALUE find_common_field_value(const char *field, size_t flen)
 {
-  unsigned i;
-  struct common_field *cf = common_http_fields;
-  for(i = 0; i < ARRAY_SIZE(common_http_fields); i++, cf++) {
+  size_t idx;
+  unsigned char slot;
+  struct common_field *cf;
+
+  if (flen == 0) return Qnil;
+
+  idx = COMMON_FIELD_HASH(field, flen);
+  while ((slot = common_field_slots[idx])) {
+    cf = &common_http_fields[slot - 1];
     if (cf->len == flen && !memcmp(cf->name, field, flen))
       return cf->value;
+    idx = (idx + 1) & (COMMON_FIELD_SLOTS - 1);
   }
   return Qnil;
 }
 
+/*
+ * Returns the interned "HTTP_" key for a header that isn't in
+ * common_http_fields.  Keys are cached per parser in a small direct mapped
+ * table indexed by a hash of the field name, so custom headers repeated on a
+ * keep-alive connection (X-Request-Id, Traceparent, etc) skip building and
+ * interning the key.  A colliding field just replaces the cached key.
+ */
+static VALUE find_cached_field_value(puma_parser *hp, const char *field, size_t flen)
+{
+  size_t i;
+  size_t new_size = HTTP_PREFIX_LEN + flen;
+  uint32_t hash = 2166136261u; /* FNV-1a */
+  VALUE *slot;
+
+  for (i = 0; i < flen; i++) {
+    hash = (hash ^ (unsigned char)field[i]) * 16777619u;
+  }
+  slot = &hp->field_cache[hash & (FIELD_CACHE_LEN - 1)];
+
+  if (*slot != Qnil && RSTRING_LEN(*slot) == (long)new_size &&
+      !memcmp(RSTRING_PTR(*slot) + HTTP_PREFIX_LEN, field, flen)) {
+    hp->field_cache_hits++;
+    return *slot;
+  }
+
+  /*
+   * We got a strange header that we don't have a memoized value for.
+   * Fallback to creating a new string to use as a hash key.
+   */
+  assert(new_size < BUFFER_LEN);
+
+  memcpy(hp->buf, HTTP_PREFIX, HTTP_PREFIX_LEN);
+  memcpy(hp->buf + HTTP_PREFIX_LEN, field, flen);
+
+  hp->field_cache_misses++;
+  *slot = rb_enc_interned_str(hp->buf, new_size, rb_utf8_encoding());
+  return *slot;
+}
+
 static int is_ows(const char c) {
     return c == ' ' || c == '\t';
 }
 
+static void lazy_http_field(puma_parser* hp, VALUE f, const char *value, size_t vlen)
+{
+  VALUE span, v;
+  unsigned long long s;
+
+  if (NIL_P(hp->spans)) {
+    hp->spans = rb_hash_new();
+  }
+
+  span = rb_hash_lookup2(hp->spans, f, Qundef);
+
+  if (span != Qundef) {
+    /* duplicate header, the comma-separated value is created now */
+    s = NUM2ULL(span);
+    v = rb_str_new(hp->data + SPAN_OFFSET(s), SPAN_LEN(s));
+    rb_str_cat2(v, ", ");
+    rb_str_cat(v, value, vlen);
+    rb_hash_delete(hp->spans, f);
+    rb_hash_aset(hp->request, f, v);
+    return;
+  }
+
+  v = rb_hash_aref(hp->request, f);
+
+  if (v == Qnil) {
+    s = SPAN(value - hp->data, vlen);
+    rb_hash_aset(hp->spans, f, ULL2NUM(s));
+  } else {
+    rb_str_cat2(v, ", ");
+    rb_str_cat(v, value, vlen);
+  }
+}
+
 static void http_field(puma_parser* hp, const char *field, size_t flen,
                                  const char *value, size_t vlen)
 {
@@ -162,18 +264,7 @@ static void http_field(puma_parser* hp, const char *field, size_t flen,
   f = find_common_field_value(field, flen);
 
   if (f == Qnil) {
-    /*
-     * We got a strange header that we don't have a memoized value for.
-     * Fallback to creating a new string to use as a hash key.
-     */
-
-    size_t new_size = HTTP_PREFIX_LEN + flen;
-    assert(new_size < BUFFER_LEN);
-
-    memcpy(hp->buf, HTTP_PREFIX, HTTP_PREFIX_LEN);
-    memcpy(hp->buf + HTTP_PREFIX_LEN, field, flen);
-
-    f = rb_enc_interned_str(hp->buf, new_size, rb_utf8_encoding());
+    f = find_cached_field_value(hp, field, flen);
   }
 
   while (vlen > 0 && is_ows(value[vlen - 1])) vlen--;
@@ -182,6 +273,11 @@ static void http_field(puma_parser* hp, const char *field, size_t flen,
       value++;
   }
 
+  if (hp->lazy) {
+    lazy_http_field(hp, f, value, vlen);
+    return;
+  }
+
   /* check for duplicate header */
   v = rb_hash_aref(hp->request, f);
 
@@ -260,8 +356,13 @@ static void header_done(puma_parser* hp, const char *at, size_t length)
 
 static void HttpParser_mark(void *ptr) {
   puma_parser *hp = ptr;
+  int i;
   rb_gc_mark_movable(hp->request);
   rb_gc_mark_movable(hp->body);
+  rb_gc_mark_movable(hp->spans);
+  for (i = 0; i < FIELD_CACHE_LEN; i++) {
+    rb_gc_mark_movable(hp->field_cache[i]);
+  }
 }
 
 static size_t HttpParser_size(const void *ptr) {
@@ -270,8 +371,13 @@ static size_t HttpParser_size(const void *ptr) {
 
 static void HttpParser_compact(void *ptr) {
   puma_parser *hp = ptr;
+  int i;
   hp->request = rb_gc_location(hp->request);
   hp->body = rb_gc_location(hp->body);
+  hp->spans = rb_gc_location(hp->spans);
+  for (i = 0; i < FIELD_CACHE_LEN; i++) {
+    hp->field_cache[i] = rb_gc_location(hp->field_cache[i]);
+  }
 }
 
 static const rb_data_type_t HttpParser_data_type = {
@@ -287,6 +393,7 @@ static const rb_data_type_t HttpParser_data_type = {
 
 static VALUE HttpParser_alloc(VALUE klass)
 {
+  int i;
   puma_parser *hp = ALLOC_N(puma_parser, 1);
   hp->http_field = http_field;
   hp->request_method = request_method;
@@ -297,6 +404,14 @@ static VALUE HttpParser_alloc(VALUE klass)
   hp->server_protocol = server_protocol;
   hp->header_done = header_done;
   hp->request = Qnil;
+  for (i = 0; i < FIELD_CACHE_LEN; i++) {
+    hp->field_cache[i] = Qnil;
+  }
+  hp->field_cache_hits = 0;
+  hp->field_cache_misses = 0;
+  hp->lazy = 0;
+  hp->data = NULL;
+  hp->spans = Qnil;
 
   puma_parser_init(hp);
 
@@ -339,6 +454,7 @@ static VALUE HttpParser_reset(VALUE self)
 {
   puma_parser *http = HttpParser_unwrap(self);
   puma_parser_init(http);
+  http->spans = Qnil;
 
   return Qnil;
 }
@@ -391,7 +507,9 @@ static VALUE HttpParser_execute(VALUE self, VALUE req_hash, VALUE data, VALUE st
     rb_raise(eHttpParserError, "%s", "Requested start is after data buffer end.");
   } else {
     http->request = req_hash;
+    http->data = dptr;
     puma_parser_execute(http, dptr, dlen, from);
+    http->data = NULL;
 
     VALIDATE_MAX_LENGTH(puma_parser_nread(http), HEADER);
 
@@ -459,10 +577,79 @@ static VALUE HttpParser_body(VALUE self) {
   return http->body;
 }
 
+/**
+ * call-seq:
+ *    parser.field_cache_stats -> Hash
+ *
+ * Returns the number of hits and misses of the per parser cache of header keys
+ * that aren't in the common header list, as <tt>{ hits: Integer, misses: Integer }</tt>.
+ * The counts are kept across calls to reset.
+ */
+static VALUE HttpParser_field_cache_stats(VALUE self) {
+  puma_parser *http = HttpParser_unwrap(self);
+  VALUE stats = rb_hash_new();
+
+  rb_hash_aset(stats, ID2SYM(rb_intern("hits")), SIZET2NUM(http->field_cache_hits));
+  rb_hash_aset(stats, ID2SYM(rb_intern("misses")), SIZET2NUM(http->field_cache_misses));
+  return stats;
+}
+
+/**
+ * call-seq:
+ *    parser.lazy_env = true/false
+ *
+ * When true, header values aren't added to the req_hash passed to execute,
+ * their position in the data is recorded instead, see #lazy_spans.  The
+ * request line is always added.
+ */
+static VALUE HttpParser_set_lazy_env(VALUE self, VALUE val)
+{
+  puma_parser *http = HttpParser_unwrap(self);
+  http->lazy = RTEST(val);
+
+  return val;
+}
+
+/**
+ * call-seq:
+ *    parser.lazy_env? -> true/false
+ */
+static VALUE HttpParser_lazy_env(VALUE self)
+{
+  puma_parser *http = HttpParser_unwrap(self);
+
+  return http->lazy ? Qtrue : Qfalse;
+}
+
+/**
+ * call-seq:
+ *    parser.lazy_spans -> Hash or nil
+ *
+ * With lazy_env set, the header values of the current request as a Hash of
+ * env key to Integer span, <tt>offset << 32 | length</tt> into the data passed
+ * to execute.  A new Hash is used after reset.
+ */
+static VALUE HttpParser_lazy_spans(VALUE self)
+{
+  puma_parser *http = HttpParser_unwrap(self);
+
+  return http->spans;
+}
+
 #ifdef HAVE_OPENSSL_BIO_H
 void Init_mini_ssl(VALUE mod);
 #endif
 
+void Init_lazy_env(VALUE mod);
+void Init_chunked_decoder(VALUE mod);
+void Init_native_io(VALUE mod);
+void Init_epoll_selector(VALUE mod);
+void Init_shared_table(VALUE mod);
+void Init_gvl_meter(VALUE mod);
+void Init_response_headers(VALUE mod);
+void Init_compressor(VALUE mod);
+void Init_file_watcher(VALUE mod);
+
 RUBY_FUNC_EXPORTED void Init_puma_http11(void)
 {
 #ifdef HAVE_RB_EXT_RACTOR_SAFE
@@ -491,8 +678,22 @@ RUBY_FUNC_EXPORTED void Init_puma_http11(void)
   rb_define_method(cHttpParser, "finished?", HttpParser_is_finished, 0);
   rb_define_method(cHttpParser, "nread", HttpParser_nread, 0);
   rb_define_method(cHttpParser, "body", HttpParser_body, 0);
+  rb_define_method(cHttpParser, "field_cache_stats", HttpParser_field_cache_stats, 0);
+  rb_define_method(cHttpParser, "lazy_env=", HttpParser_set_lazy_env, 1);
+  rb_define_method(cHttpParser, "lazy_env?", HttpParser_lazy_env, 0);
+  rb_define_method(cHttpParser, "lazy_spans", HttpParser_lazy_spans, 0);
   init_common_fields();
 
+  Init_lazy_env(mPuma);
+  Init_chunked_decoder(mPuma);
+  Init_native_io(mPuma);
+  Init_epoll_selector(mPuma);
+  Init_shared_table(mPuma);
+  Init_gvl_meter(mPuma);
+  Init_response_headers(mPuma);
+  Init_compressor(mPuma);
+  Init_file_watcher(mPuma);
+
 #ifdef HAVE_OPENSSL_BIO_H
   Init_mini_ssl(mPuma);
 #endif
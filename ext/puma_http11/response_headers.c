@@ -0,0 +1,477 @@
+#include <ruby.h>
+#include <stdint.h>
+#include <string.h>
+
+/*
+ * Puma::NativeHeaders, writes the status line and headers of a response in
+ * one pass over the headers Hash, appending to the String of the client's
+ * `Puma::IOBuffer`.  Checks each key and value as
+ * `Puma::Response#illegal_header_key?` and `#illegal_header_value?` do, and
+ * stores what `Puma::Response#prepare_response` needs in the client's
+ * `Puma::Response::Info` Struct, so no Hash is allocated.
+ *
+ * Puma::NativeHeaders::LineCache keeps the lines written for a header whose
+ * key and value are frozen Strings, keyed by the identity of both, so a
+ * header from frozen constants is written with one copy.  It holds the
+ * `size` most recently used pairs, and references them, so an address isn't
+ * reused by another String while it's cached.
+ */
+
+#define KEY_BUF_LEN 128
+
+static VALUE sym_no_body, sym_allow_chunked, sym_keep_alive, sym_content_length,
+  sym_transfer_encoding, sym_response_hijack;
+static VALUE status_lines_11 = Qnil, status_lines_10 = Qnil;
+static ID id_to_i;
+
+/* bytes rejected by ILLEGAL_HEADER_KEY_REGEX and ILLEGAL_HEADER_VALUE_REGEX */
+static char illegal_key[256];
+static char illegal_value[256];
+
+typedef struct {
+  VALUE key;
+  VALUE value;
+  VALUE lines;
+  long prev, next;  /* most recently used first */
+  long chain;       /* next entry in the bucket */
+} line_entry;
+
+typedef struct {
+  line_entry *entries;
+  long *buckets;
+  long size, used, mask;
+  long head, tail;
+  unsigned long hits, misses;
+} line_cache;
+
+typedef struct {
+  VALUE buf;
+  VALUE info;
+  line_cache *cache;
+  int fallback;
+} headers_state;
+
+static inline int illegal(const char *table, const char *ptr, long len)
+{
+  long i;
+  for (i = 0; i < len; i++) {
+    if (table[(unsigned char)ptr[i]]) return 1;
+  }
+  return 0;
+}
+
+static inline void write_line(VALUE buf, const char *key, long key_len, const char *val, long val_len)
+{
+  rb_str_cat(buf, key, key_len);
+  rb_str_cat(buf, ": ", 2);
+  rb_str_cat(buf, val, val_len);
+  rb_str_cat(buf, "\r\n", 2);
+}
+
+/* `vs.to_s.split("\n")`, skipping illegal lines, no line when empty */
+static void write_split_value(VALUE buf, const char *key, long key_len, VALUE str)
+{
+  const char *ptr = RSTRING_PTR(str), *nl;
+  long len = RSTRING_LEN(str), line_len;
+
+  if (len == 0) {
+    write_line(buf, key, key_len, "", 0);
+    return;
+  }
+
+  /* split drops trailing empty strings */
+  while (len > 0 && ptr[len - 1] == '\n') len--;
+
+  while (len > 0) {
+    nl = memchr(ptr, '\n', len);
+    line_len = nl ? nl - ptr : len;
+    if (!illegal(illegal_value, ptr, line_len)) write_line(buf, key, key_len, ptr, line_len);
+    if (!nl) break;
+    ptr += line_len + 1;
+    len -= line_len + 1;
+  }
+}
+
+static inline long line_cache_bucket(line_cache *cache, VALUE key, VALUE value)
+{
+  uintptr_t h = ((uintptr_t)key >> 3) * 31 + ((uintptr_t)value >> 3);
+  return (long)((h ^ (h >> 16)) & cache->mask);
+}
+
+static void line_cache_unlink(line_cache *cache, long i)
+{
+  line_entry *e = &cache->entries[i];
+
+  if (e->prev >= 0) cache->entries[e->prev].next = e->next; else cache->head = e->next;
+  if (e->next >= 0) cache->entries[e->next].prev = e->prev; else cache->tail = e->prev;
+}
+
+static void line_cache_push_front(line_cache *cache, long i)
+{
+  line_entry *e = &cache->entries[i];
+
+  e->prev = -1;
+  e->next = cache->head;
+  if (cache->head >= 0) cache->entries[cache->head].prev = i; else cache->tail = i;
+  cache->head = i;
+}
+
+static VALUE line_cache_get(line_cache *cache, VALUE key, VALUE value)
+{
+  long i = cache->buckets[line_cache_bucket(cache, key, value)];
+
+  for (; i >= 0; i = cache->entries[i].chain) {
+    if (cache->entries[i].key == key && cache->entries[i].value == value) {
+      if (cache->head != i) {
+        line_cache_unlink(cache, i);
+        line_cache_push_front(cache, i);
+      }
+      cache->hits++;
+      return cache->entries[i].lines;
+    }
+  }
+  cache->misses++;
+  return Qnil;
+}
+
+/* replaces the least recently used entry once full */
+static void line_cache_set(line_cache *cache, VALUE key, VALUE value, VALUE lines)
+{
+  line_entry *e;
+  long i, *p, b;
+
+  if (cache->used < cache->size) {
+    i = cache->used++;
+  } else {
+    i = cache->tail;
+    e = &cache->entries[i];
+    p = &cache->buckets[line_cache_bucket(cache, e->key, e->value)];
+    while (*p != i) p = &cache->entries[*p].chain;
+    *p = e->chain;
+    line_cache_unlink(cache, i);
+  }
+
+  e = &cache->entries[i];
+  e->key = key;
+  e->value = value;
+  e->lines = lines;
+  b = line_cache_bucket(cache, key, value);
+  e->chain = cache->buckets[b];
+  cache->buckets[b] = i;
+  line_cache_push_front(cache, i);
+}
+
+#define KEY_IS(lit) (key_len == sizeof(lit) - 1 && memcmp(key, lit, sizeof(lit) - 1) == 0)
+
+static int write_header(VALUE k, VALUE vs, VALUE arg)
+{
+  headers_state *state = (headers_state *)arg;
+  VALUE buf = state->buf, down = Qnil, str;
+  char key_buf[KEY_BUF_LEN], *key;
+  const char *src;
+  long key_len, i, start = -1;
+  int ascii = 1;
+
+  if (!RB_TYPE_P(k, T_STRING)) {
+    state->fallback = 1;
+    return ST_STOP;
+  }
+
+  if (state->cache && OBJ_FROZEN(k) && RB_TYPE_P(vs, T_STRING) && OBJ_FROZEN(vs)) {
+    str = line_cache_get(state->cache, k, vs);
+    if (!NIL_P(str)) {
+      rb_str_cat(buf, RSTRING_PTR(str), RSTRING_LEN(str));
+      return ST_CONTINUE;
+    }
+    start = RSTRING_LEN(buf);
+  }
+
+  src = RSTRING_PTR(k);
+  key_len = RSTRING_LEN(k);
+  if (illegal(illegal_key, src, key_len)) return ST_CONTINUE;
+
+  for (i = 0; i < key_len; i++) {
+    if ((unsigned char)src[i] >= 0x80) { ascii = 0; break; }
+  }
+
+  if (ascii && key_len <= KEY_BUF_LEN) {
+    key = key_buf;
+    for (i = 0; i < key_len; i++) {
+      key[i] = (src[i] >= 'A' && src[i] <= 'Z') ? src[i] + ('a' - 'A') : src[i];
+    }
+  } else {
+    /* String#downcase handles non-ASCII keys */
+    down = rb_funcall(k, rb_intern("downcase"), 0);
+    key = RSTRING_PTR(down);
+    key_len = RSTRING_LEN(down);
+  }
+
+  if (KEY_IS("content-length")) {
+    if (!NIL_P(vs)) {
+      str = rb_obj_as_string(vs);
+      if (illegal(illegal_value, RSTRING_PTR(str), RSTRING_LEN(str))) return ST_CONTINUE;
+    }
+    rb_struct_aset(state->info, sym_content_length,
+      NIL_P(vs) ? Qnil : RB_TYPE_P(vs, T_STRING) ? rb_str_to_inum(vs, 10, 0) : rb_funcall(vs, id_to_i, 0));
+    return ST_CONTINUE;
+  } else if (KEY_IS("transfer-encoding")) {
+    rb_struct_aset(state->info, sym_allow_chunked, Qfalse);
+    rb_struct_aset(state->info, sym_content_length, Qnil);
+    rb_struct_aset(state->info, sym_transfer_encoding, vs);
+    start = -1;
+  } else if (KEY_IS("rack.hijack")) {
+    rb_struct_aset(state->info, sym_response_hijack, vs);
+    return ST_CONTINUE;
+  } else if ((key_len >= 5 && memcmp(key, "rack.", 5) == 0) || KEY_IS("status")) {
+    return ST_CONTINUE;
+  }
+
+  if (RB_TYPE_P(vs, T_ARRAY) && RARRAY_LEN(vs) > 0) {
+    for (i = 0; i < RARRAY_LEN(vs); i++) {
+      str = rb_obj_as_string(RARRAY_AREF(vs, i));
+      if (!illegal(illegal_value, RSTRING_PTR(str), RSTRING_LEN(str))) {
+        write_line(buf, key, key_len, RSTRING_PTR(str), RSTRING_LEN(str));
+      }
+    }
+  } else {
+    str = RB_TYPE_P(vs, T_STRING) ? vs : rb_obj_as_string(vs);
+    write_split_value(buf, key, key_len, str);
+  }
+
+  /* only headers that don't set `info` are cached */
+  if (start >= 0) {
+    str = rb_str_new(RSTRING_PTR(buf) + start, RSTRING_LEN(buf) - start);
+    line_cache_set(state->cache, k, vs, rb_obj_freeze(str));
+  }
+
+  RB_GC_GUARD(down);
+  return ST_CONTINUE;
+}
+
+/* Puma::STATUS_LINES_11 and 10, "CUSTOM" for other codes */
+static void write_status_line(VALUE buf, int status, int http_11)
+{
+  char line[40];
+  VALUE str;
+
+  if (status == 200) {
+    if (http_11) {
+      rb_str_cat(buf, "HTTP/1.1 200 OK\r\n", 17);
+    } else {
+      rb_str_cat(buf, "HTTP/1.0 200 OK\r\n", 17);
+    }
+    return;
+  }
+
+  if (NIL_P(status_lines_11)) {
+    status_lines_11 = rb_const_get(rb_define_module("Puma"), rb_intern("STATUS_LINES_11"));
+    status_lines_10 = rb_const_get(rb_define_module("Puma"), rb_intern("STATUS_LINES_10"));
+  }
+
+  str = rb_hash_lookup2(http_11 ? status_lines_11 : status_lines_10, INT2FIX(status), Qnil);
+  if (NIL_P(str)) {
+    rb_str_cat(buf, line, snprintf(line, sizeof(line), "HTTP/1.%d %d CUSTOM\r\n", http_11, status));
+  } else {
+    rb_str_cat(buf, RSTRING_PTR(str), RSTRING_LEN(str));
+  }
+}
+
+static void LineCache_mark(void *ptr)
+{
+  line_cache *cache = ptr;
+  long i;
+
+  /* marked without moving, the entries are keyed by address */
+  for (i = 0; i < cache->used; i++) {
+    rb_gc_mark(cache->entries[i].key);
+    rb_gc_mark(cache->entries[i].value);
+    rb_gc_mark(cache->entries[i].lines);
+  }
+}
+
+static void LineCache_free(void *ptr)
+{
+  line_cache *cache = ptr;
+
+  xfree(cache->entries);
+  xfree(cache->buckets);
+  xfree(cache);
+}
+
+static size_t LineCache_memsize(const void *ptr)
+{
+  const line_cache *cache = ptr;
+  return sizeof(line_cache) + cache->size * sizeof(line_entry) + (cache->mask + 1) * sizeof(long);
+}
+
+static const rb_data_type_t LineCache_data_type = {
+    .wrap_struct_name = "Puma::NativeHeaders::LineCache",
+    .function = {
+      .dmark = LineCache_mark,
+      .dfree = LineCache_free,
+      .dsize = LineCache_memsize,
+    },
+    .flags = RUBY_TYPED_FREE_IMMEDIATELY,
+};
+
+static VALUE LineCache_alloc(VALUE klass)
+{
+  line_cache *cache;
+  VALUE obj = TypedData_Make_Struct(klass, line_cache, &LineCache_data_type, cache);
+
+  cache->head = cache->tail = -1;
+  return obj;
+}
+
+static inline line_cache *LineCache_unwrap(VALUE self)
+{
+  line_cache *cache;
+  TypedData_Get_Struct(self, line_cache, &LineCache_data_type, cache);
+  if (!cache->entries) rb_raise(rb_eArgError, "uninitialized LineCache");
+  return cache;
+}
+
+/**
+ * call-seq:
+ *    Puma::NativeHeaders::LineCache.new(size)
+ *
+ * A cache of the lines of up to +size+ headers.
+ */
+static VALUE LineCache_initialize(VALUE self, VALUE size)
+{
+  line_cache *cache;
+  long n = NUM2LONG(size), buckets = 1, i;
+
+  TypedData_Get_Struct(self, line_cache, &LineCache_data_type, cache);
+  if (cache->entries) rb_raise(rb_eArgError, "already initialized");
+  if (n < 1 || n > (1L << 24)) rb_raise(rb_eArgError, "size must be between 1 and %ld", 1L << 24);
+
+  while (buckets < 2 * n) buckets <<= 1;
+  cache->buckets = ALLOC_N(long, buckets);
+  for (i = 0; i < buckets; i++) cache->buckets[i] = -1;
+  cache->entries = ZALLOC_N(line_entry, n);
+  cache->size = n;
+  cache->mask = buckets - 1;
+  return self;
+}
+
+/**
+ * call-seq:
+ *    cache.size -> Integer
+ *
+ * The most headers kept.
+ */
+static VALUE LineCache_size(VALUE self)
+{
+  return LONG2NUM(LineCache_unwrap(self)->size);
+}
+
+/**
+ * call-seq:
+ *    cache.hits -> Integer
+ *
+ * How many headers were written from the cache.
+ */
+static VALUE LineCache_hits(VALUE self)
+{
+  return ULONG2NUM(LineCache_unwrap(self)->hits);
+}
+
+/**
+ * call-seq:
+ *    cache.misses -> Integer
+ *
+ * How many headers with a frozen key and value weren't in the cache.
+ */
+static VALUE LineCache_misses(VALUE self)
+{
+  return ULONG2NUM(LineCache_unwrap(self)->misses);
+}
+
+/**
+ * call-seq:
+ *    Puma::NativeHeaders.write(buf, info, status, headers, http_11, cache = nil) -> Boolean
+ *
+ * Appends the status line, +headers+ and the connection header to +buf+.
+ * +info+ must have +no_body+ and +keep_alive+ set from the request, the
+ * other members are set from +status+ and +headers+.  With a +cache+, a
+ * `LineCache`, the lines of headers with frozen keys and values are cached.
+ *
+ * Returns false, leaving +buf+ as it was, if +headers+ isn't a Hash or has
+ * keys that aren't Strings, for the Ruby code to handle them.
+ */
+static VALUE NativeHeaders_write(int argc, VALUE *argv, VALUE self)
+{
+  VALUE buf, info, status, headers, http_11, cache;
+  headers_state state;
+  long start;
+  int st, h11;
+
+  rb_scan_args(argc, argv, "51", &buf, &info, &status, &headers, &http_11, &cache);
+  st = NUM2INT(status);
+  h11 = RTEST(http_11) ? 1 : 0;
+  state.cache = NIL_P(cache) ? NULL : LineCache_unwrap(cache);
+
+  if (!RB_TYPE_P(headers, T_HASH)) return Qfalse;
+  StringValue(buf);
+  rb_str_modify(buf);
+  start = RSTRING_LEN(buf);
+  rb_str_modify_expand(buf, 64 + 64 * RHASH_SIZE(headers));
+
+  rb_struct_aset(info, sym_allow_chunked, h11 ? Qtrue : Qfalse);
+  rb_struct_aset(info, sym_content_length, Qnil);
+  rb_struct_aset(info, sym_transfer_encoding, Qnil);
+  rb_struct_aset(info, sym_response_hijack, Qnil);
+  if (st != 200 && (st < 200 || st == 204 || st == 205 || st == 304)) {
+    rb_struct_aset(info, sym_no_body, Qtrue);
+  }
+
+  write_status_line(buf, st, h11);
+
+  state.buf = buf;
+  state.info = info;
+  state.fallback = 0;
+  rb_hash_foreach(headers, write_header, (VALUE)&state);
+
+  if (state.fallback) {
+    rb_str_set_len(buf, start);
+    return Qfalse;
+  }
+
+  /* only when it's not the default of the protocol */
+  if (RTEST(rb_struct_aref(info, sym_keep_alive))) {
+    if (!h11) rb_str_cat(buf, "connection: keep-alive\r\n", 24);
+  } else {
+    if (h11) rb_str_cat(buf, "connection: close\r\n", 19);
+  }
+  return Qtrue;
+}
+
+void Init_response_headers(VALUE puma) {
+  VALUE mNativeHeaders = rb_define_module_under(puma, "NativeHeaders"), cLineCache;
+  const char *key_delimiters = "\"(),/:;<=>?@[]{}\\";
+  int i;
+
+  for (i = 0; i <= 0x20; i++) illegal_key[i] = 1;
+  for (i = 0; key_delimiters[i]; i++) illegal_key[(unsigned char)key_delimiters[i]] = 1;
+  for (i = 0; i <= 0x1F; i++) illegal_value[i] = (i != '\t');
+
+  sym_no_body = ID2SYM(rb_intern("no_body"));
+  sym_allow_chunked = ID2SYM(rb_intern("allow_chunked"));
+  sym_keep_alive = ID2SYM(rb_intern("keep_alive"));
+  sym_content_length = ID2SYM(rb_intern("content_length"));
+  sym_transfer_encoding = ID2SYM(rb_intern("transfer_encoding"));
+  sym_response_hijack = ID2SYM(rb_intern("response_hijack"));
+  id_to_i = rb_intern("to_i");
+  rb_global_variable(&status_lines_11);
+  rb_global_variable(&status_lines_10);
+
+  rb_define_module_function(mNativeHeaders, "write", NativeHeaders_write, -1);
+
+  cLineCache = rb_define_class_under(mNativeHeaders, "LineCache", rb_cObject);
+  rb_define_alloc_func(cLineCache, LineCache_alloc);
+  rb_define_method(cLineCache, "initialize", LineCache_initialize, 1);
+  rb_define_method(cLineCache, "size", LineCache_size, 0);
+  rb_define_method(cLineCache, "hits", LineCache_hits, 0);
+  rb_define_method(cLineCache, "misses", LineCache_misses, 0);
+}
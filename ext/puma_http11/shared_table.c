@@ -0,0 +1,215 @@
+#include <ruby.h>
+
+/*
+ * Puma::SharedTable, a table of 64 bit integers in an anonymous shared
+ * mapping.  Created by the cluster master before forking, so the master and
+ * every worker see the same memory.  Each cell is read and written with an
+ * atomic load or store, a row is only written by one process.
+ */
+
+#if defined(HAVE_SYS_MMAN_H) && defined(HAVE_MMAP)
+#include <sys/mman.h>
+#include <errno.h>
+#include <stdint.h>
+
+#if !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+
+typedef struct {
+  int64_t *cells;
+  long rows;
+  long cols;
+  size_t len;
+} shared_table;
+
+static void SharedTable_free(void *ptr)
+{
+  shared_table *tbl = ptr;
+
+  /* only unmaps this process's view */
+  if (tbl->cells) munmap(tbl->cells, tbl->len);
+  xfree(tbl);
+}
+
+static size_t SharedTable_memsize(const void *ptr)
+{
+  return sizeof(shared_table);
+}
+
+static const rb_data_type_t SharedTable_data_type = {
+    .wrap_struct_name = "Puma::SharedTable",
+    .function = {
+      .dfree = SharedTable_free,
+      .dsize = SharedTable_memsize,
+    },
+    .flags = RUBY_TYPED_FREE_IMMEDIATELY,
+};
+
+static VALUE SharedTable_alloc(VALUE klass)
+{
+  shared_table *tbl = ALLOC(shared_table);
+
+  tbl->cells = NULL;
+  tbl->rows = tbl->cols = 0;
+  tbl->len = 0;
+  return TypedData_Wrap_Struct(klass, &SharedTable_data_type, tbl);
+}
+
+static inline shared_table *SharedTable_unwrap(VALUE self)
+{
+  shared_table *tbl;
+  TypedData_Get_Struct(self, shared_table, &SharedTable_data_type, tbl);
+  if (!tbl->cells) rb_raise(rb_eRuntimeError, "uninitialized SharedTable");
+  return tbl;
+}
+
+/**
+ * call-seq:
+ *    Puma::SharedTable.new(rows, cols)
+ *
+ * Maps a zero filled table of +rows+ x +cols+ 64 bit integers.
+ */
+static VALUE SharedTable_init(VALUE self, VALUE rows, VALUE cols)
+{
+  shared_table *tbl;
+  long r = NUM2LONG(rows), c = NUM2LONG(cols);
+  void *cells;
+
+  TypedData_Get_Struct(self, shared_table, &SharedTable_data_type, tbl);
+  if (tbl->cells) rb_raise(rb_eRuntimeError, "already initialized");
+  if (r <= 0 || c <= 0 || r > 0xffff || c > 0xffff) {
+    rb_raise(rb_eArgError, "invalid size %ldx%ld", r, c);
+  }
+
+  tbl->len = sizeof(int64_t) * r * c;
+  cells = mmap(NULL, tbl->len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (cells == MAP_FAILED) rb_sys_fail("mmap");
+
+  tbl->cells = cells;
+  tbl->rows = r;
+  tbl->cols = c;
+  return self;
+}
+
+static inline int64_t *cell(shared_table *tbl, VALUE row, VALUE col)
+{
+  long r = NUM2LONG(row), c = NUM2LONG(col);
+
+  if (r < 0 || r >= tbl->rows || c < 0 || c >= tbl->cols) {
+    rb_raise(rb_eIndexError, "cell [%ld, %ld] outside %ldx%ld table", r, c, tbl->rows, tbl->cols);
+  }
+  return tbl->cells + r * tbl->cols + c;
+}
+
+/**
+ * call-seq:
+ *    table[row, col] -> Integer
+ */
+static VALUE SharedTable_aref(VALUE self, VALUE row, VALUE col)
+{
+  return LL2NUM(__atomic_load_n(cell(SharedTable_unwrap(self), row, col), __ATOMIC_RELAXED));
+}
+
+/**
+ * call-seq:
+ *    table[row, col] = Integer
+ */
+static VALUE SharedTable_aset(VALUE self, VALUE row, VALUE col, VALUE val)
+{
+  __atomic_store_n(cell(SharedTable_unwrap(self), row, col), (int64_t)NUM2LL(val), __ATOMIC_RELAXED);
+  return val;
+}
+
+/**
+ * call-seq:
+ *    table.store(row, values) -> table
+ *
+ * Stores +values+, an Array of Integers, in the first cells of +row+.
+ */
+static VALUE SharedTable_store(VALUE self, VALUE row, VALUE values)
+{
+  shared_table *tbl = SharedTable_unwrap(self);
+  int64_t *start;
+  long i, len;
+
+  Check_Type(values, T_ARRAY);
+  start = cell(tbl, row, INT2FIX(0));
+  len = RARRAY_LEN(values);
+  if (len > tbl->cols) rb_raise(rb_eIndexError, "%ld values for %ld columns", len, tbl->cols);
+
+  for (i = 0; i < len; i++) {
+    __atomic_store_n(start + i, (int64_t)NUM2LL(RARRAY_AREF(values, i)), __ATOMIC_RELAXED);
+  }
+  return self;
+}
+
+/**
+ * call-seq:
+ *    table.row(row) -> Array
+ */
+static VALUE SharedTable_row(VALUE self, VALUE row)
+{
+  shared_table *tbl = SharedTable_unwrap(self);
+  int64_t *start = cell(tbl, row, INT2FIX(0));
+  VALUE ary = rb_ary_new_capa(tbl->cols);
+  long i;
+
+  for (i = 0; i < tbl->cols; i++) {
+    rb_ary_push(ary, LL2NUM(__atomic_load_n(start + i, __ATOMIC_RELAXED)));
+  }
+  return ary;
+}
+
+/**
+ * call-seq:
+ *    table.min(col, skip_row = nil) -> Integer or nil
+ *
+ * The smallest non-negative value in column +col+, ignoring +skip_row+.
+ * Returns nil if there's none, a negative value marks an unused row.
+ */
+static VALUE SharedTable_min(int argc, VALUE *argv, VALUE self)
+{
+  shared_table *tbl = SharedTable_unwrap(self);
+  VALUE col, skip_row;
+  int64_t *start, val, min = -1;
+  long i, skip;
+
+  rb_scan_args(argc, argv, "11", &col, &skip_row);
+  start = cell(tbl, INT2FIX(0), col);
+  skip = NIL_P(skip_row) ? -1 : NUM2LONG(skip_row);
+
+  for (i = 0; i < tbl->rows; i++) {
+    if (i == skip) continue;
+    val = __atomic_load_n(start + i * tbl->cols, __ATOMIC_RELAXED);
+    if (val >= 0 && (min < 0 || val < min)) min = val;
+  }
+  return min < 0 ? Qnil : LL2NUM(min);
+}
+
+static VALUE SharedTable_rows(VALUE self)
+{
+  return LONG2NUM(SharedTable_unwrap(self)->rows);
+}
+
+static VALUE SharedTable_cols(VALUE self)
+{
+  return LONG2NUM(SharedTable_unwrap(self)->cols);
+}
+#endif
+
+void Init_shared_table(VALUE puma) {
+#if defined(HAVE_SYS_MMAN_H) && defined(HAVE_MMAP)
+  VALUE cSharedTable = rb_define_class_under(puma, "SharedTable", rb_cObject);
+
+  rb_define_alloc_func(cSharedTable, SharedTable_alloc);
+  rb_define_method(cSharedTable, "initialize", SharedTable_init, 2);
+  rb_define_method(cSharedTable, "[]", SharedTable_aref, 2);
+  rb_define_method(cSharedTable, "[]=", SharedTable_aset, 3);
+  rb_define_method(cSharedTable, "store", SharedTable_store, 2);
+  rb_define_method(cSharedTable, "row", SharedTable_row, 1);
+  rb_define_method(cSharedTable, "min", SharedTable_min, -1);
+  rb_define_method(cSharedTable, "rows", SharedTable_rows, 0);
+  rb_define_method(cSharedTable, "cols", SharedTable_cols, 0);
+#endif
+}
@@ -25,6 +25,8 @@ module Puma
       @inherited_fds = {}
       @activated_sockets = {}
       @unix_paths = []
+      # `[io, spec]` of each `reuse_port` listener, the spec binds it again
+      @reuse_port_listeners = []
       @env = env
 
       @proto_env = {
@@ -169,8 +171,10 @@ module Puma
 
             low_latency = params.key?('low_latency') && params['low_latency'] != 'false'
             backlog = params.fetch('backlog', 1024).to_i
+            reuse_port = params.key?('reuse_port') && params['reuse_port'] != 'false'
 
-            io = add_tcp_listener uri.host, uri.port, low_latency, backlog
+            io = add_tcp_listener uri.host, uri.port, low_latency, backlog, reuse_port: reuse_port,
+              **tcp_listener_options(params)
 
             @ios[ios_len..-1].each do |i|
               addr = loc_addr_str i
@@ -261,7 +265,9 @@ module Puma
             ios_len = @ios.length
             backlog = params.fetch('backlog', 1024).to_i
             low_latency = params['low_latency'] != 'false'
-            io = add_ssl_listener uri.host, uri.port, ctx, low_latency, backlog
+            reuse_port = params.key?('reuse_port') && params['reuse_port'] != 'false'
+            io = add_ssl_listener uri.host, uri.port, ctx, low_latency, backlog, reuse_port: reuse_port,
+              **tcp_listener_options(params)
 
             @ios[ios_len..-1].each do |i|
               addr = loc_addr_str i
@@ -332,24 +338,39 @@ module Puma
     # +backlog+ indicates how many unaccepted connections the kernel should
     # allow to accumulate before returning connection refused.
     #
-    def add_tcp_listener(host, port, optimize_for_latency=true, backlog=1024)
+    # If +reuse_port+ is true the socket is bound with +SO_REUSEPORT+, see
+    # #reopen_reuse_port_listeners.
+    #
+    # +defer_accept+ sets +TCP_DEFER_ACCEPT+, connections are only accepted
+    # once request data arrives, or after that many seconds.  +fastopen+ sets
+    # +TCP_FASTOPEN+ with that queue length, so returning clients can send
+    # the request with the SYN.  Both are off by default and Linux only.
+    #
+    def add_tcp_listener(host, port, optimize_for_latency=true, backlog=1024, reuse_port: false,
+                         defer_accept: nil, fastopen: nil)
       if host == "localhost"
         loopback_addresses.each do |addr|
-          add_tcp_listener addr, port, optimize_for_latency, backlog
+          add_tcp_listener addr, port, optimize_for_latency, backlog, reuse_port: reuse_port,
+            defer_accept: defer_accept, fastopen: fastopen
         end
         return
       end
 
       host = host[1..-2] if host&.start_with? '['
-      tcp_server = TCPServer.new(host, port)
+      tcp_server = reuse_port ? reuse_port_server(host, port) : TCPServer.new(host, port)
 
       if optimize_for_latency
         tcp_server.setsockopt(Socket::IPPROTO_TCP, Socket::TCP_NODELAY, 1)
       end
       tcp_server.setsockopt(Socket::SOL_SOCKET,Socket::SO_REUSEADDR, true)
+      set_tcp_listener_options tcp_server, defer_accept, fastopen
       tcp_server.listen backlog
 
       @ios << tcp_server
+      if reuse_port
+        @reuse_port_listeners << [tcp_server, [host, tcp_server.addr[1], optimize_for_latency, backlog, nil,
+          { defer_accept: defer_accept, fastopen: fastopen }]]
+      end
       tcp_server
     end
 
@@ -360,8 +381,10 @@ module Puma
       s
     end
 
+    # See #add_tcp_listener for the options.
     def add_ssl_listener(host, port, ctx,
-                         optimize_for_latency=true, backlog=1024)
+                         optimize_for_latency=true, backlog=1024, reuse_port: false,
+                         defer_accept: nil, fastopen: nil)
 
       raise "Puma compiled without SSL support" unless HAS_SSL
       # Puma will try to use local authority context if context is supplied nil
@@ -369,17 +392,19 @@ module Puma
 
       if host == "localhost"
         loopback_addresses.each do |addr|
-          add_ssl_listener addr, port, ctx, optimize_for_latency, backlog
+          add_ssl_listener addr, port, ctx, optimize_for_latency, backlog, reuse_port: reuse_port,
+            defer_accept: defer_accept, fastopen: fastopen
         end
         return
       end
 
       host = host[1..-2] if host&.start_with? '['
-      s = TCPServer.new(host, port)
+      s = reuse_port ? reuse_port_server(host, port) : TCPServer.new(host, port)
       if optimize_for_latency
         s.setsockopt(Socket::IPPROTO_TCP, Socket::TCP_NODELAY, 1)
       end
       s.setsockopt(Socket::SOL_SOCKET,Socket::SO_REUSEADDR, true)
+      set_tcp_listener_options s, defer_accept, fastopen
       s.listen backlog
 
       ssl = MiniSSL::Server.new s, ctx
@@ -388,6 +413,10 @@ module Puma
       @envs[ssl] = env
 
       @ios << ssl
+      if reuse_port
+        @reuse_port_listeners << [ssl, [host, s.addr[1], optimize_for_latency, backlog, ctx,
+          { defer_accept: defer_accept, fastopen: fastopen }]]
+      end
       s
     end
 
@@ -471,6 +500,68 @@ module Puma
       end
     end
 
+    # @return [Boolean] whether any listener was bound with +reuse_port+
+    def reuse_port?
+      !@reuse_port_listeners.empty?
+    end
+
+    # @return [Array<IO>] the open +reuse_port+ listeners of this process
+    def reuse_port_ios
+      @reuse_port_listeners.map(&:first).reject(&:closed?)
+    end
+
+    # Closes the +reuse_port+ listeners of this process.  Connections waiting
+    # in the accept queue of a +SO_REUSEPORT+ socket are reset when it's
+    # closed, unless the kernel migrates them to another socket of the group,
+    # see +net.ipv4.tcp_migrate_req+ on Linux 5.14 and later.
+    #
+    # The cluster master calls this once all workers booted, until then its
+    # listener keeps the port bound.  It never accepts, a connection the
+    # kernel queues on it in the meantime is reset or migrated.
+    #
+    def close_reuse_port_listeners
+      @reuse_port_listeners.each do |io, _|
+        next if io.closed?
+        @ios.delete io
+        @envs.delete io
+        @listeners.reject! { |_, l| l.equal? io.to_io }
+        io.close
+      end
+    end
+
+    # Binds new +reuse_port+ listeners, after closing the ones inherited from
+    # the parent process.  Each cluster worker calls this, so the kernel
+    # balances connections between the workers' accept queues, instead of
+    # the workers competing to accept from one shared queue.
+    #
+    def reopen_reuse_port_listeners
+      close_reuse_port_listeners
+      specs = @reuse_port_listeners.map(&:last)
+      @reuse_port_listeners.clear
+
+      specs.each do |host, port, optimize_for_latency, backlog, ctx, opts|
+        addr = host&.include?(':') ? "[#{host}]:#{port}" : "#{host}:#{port}"
+        if ctx
+          io = add_ssl_listener host, port, ctx, optimize_for_latency, backlog, reuse_port: true, **opts
+          @listeners << ["ssl://#{addr}?reuse_port=true", io]
+        else
+          io = add_tcp_listener host, port, optimize_for_latency, backlog, reuse_port: true, **opts
+          @listeners << ["tcp://#{addr}?reuse_port=true", io]
+        end
+      end
+    end
+
+    # @return [Boolean] whether connections to +io+ are only accepted once
+    #   request data arrives, also true for inherited and activated sockets
+    #   with +TCP_DEFER_ACCEPT+ set
+    def defer_accept?(io)
+      return false unless defined?(Socket::TCP_DEFER_ACCEPT)
+      sock = io.to_io
+      sock.is_a?(TCPServer) && sock.getsockopt(Socket::IPPROTO_TCP, Socket::TCP_DEFER_ACCEPT).int > 0
+    rescue IOError, SystemCallError
+      false
+    end
+
     def redirects_for_restart
       redirects = @listeners.map { |a| [a[1].to_i, a[1].to_i] }.to_h
       redirects[:close_others] = true
@@ -494,6 +585,51 @@ module Puma
       t.map! { |addrinfo| addrinfo.ip_address }; t.uniq!; t
     end
 
+    # A TCPServer bound with +SO_REUSEPORT+, the option must be set before
+    # the socket is bound.
+    def reuse_port_server(host, port)
+      raise ArgumentError, "SO_REUSEPORT isn't supported on this platform" unless defined?(Socket::SO_REUSEPORT)
+
+      host = '0.0.0.0' if host.nil? || host.empty?
+      addr = Addrinfo.tcp host, port
+      sock = Socket.new addr.afamily, Socket::SOCK_STREAM, 0
+      begin
+        sock.setsockopt Socket::SOL_SOCKET, Socket::SO_REUSEADDR, true
+        sock.setsockopt Socket::SOL_SOCKET, Socket::SO_REUSEPORT, true
+        sock.bind addr
+        TCPServer.for_fd sock.fileno
+      rescue Exception
+        sock.close
+        raise
+      ensure
+        sock.autoclose = false unless sock.closed?
+      end
+    end
+
+    # The +defer_accept+ and +fastopen+ query parameters of a bind, a value of
+    # +true+ or none uses the default.
+    def tcp_listener_options(params)
+      opts = {}
+      { 'defer_accept' => 1, 'fastopen' => 256 }.each do |key, default|
+        next unless params.key?(key) && params[key] != 'false'
+        val = params[key]
+        opts[key.to_sym] = val.nil? || val == 'true' ? default : Integer(val)
+      end
+      opts
+    end
+
+    # Sets +TCP_DEFER_ACCEPT+ and +TCP_FASTOPEN+, see #add_tcp_listener
+    def set_tcp_listener_options(sock, defer_accept, fastopen)
+      if defer_accept
+        raise ArgumentError, "TCP_DEFER_ACCEPT isn't supported on this platform" unless defined?(Socket::TCP_DEFER_ACCEPT)
+        sock.setsockopt Socket::IPPROTO_TCP, Socket::TCP_DEFER_ACCEPT, defer_accept
+      end
+      if fastopen
+        raise ArgumentError, "TCP_FASTOPEN isn't supported on this platform" unless defined?(Socket::TCP_FASTOPEN)
+        sock.setsockopt Socket::IPPROTO_TCP, Socket::TCP_FASTOPEN, fastopen
+      end
+    end
+
     def loc_addr_str(io)
       loc_addr = io.to_io.local_address
       if loc_addr.ipv6?
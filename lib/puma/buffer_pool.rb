@@ -0,0 +1,43 @@
+# frozen_string_literal: true
+
+module Puma
+
+  #———————————————————————— DO NOT USE — this class is for internal use only ———
+
+
+  # A pool of the String buffers `Puma::Client` reads request headers into.
+  # A client takes a buffer for its first read of a request and puts it back
+  # in `Client#reset`, so idle keep-alive connections don't hold one, and
+  # buffers keep the capacity they grew to instead of being garbage.
+  #
+  # Buffers larger than `max_bytes` are dropped when put back, and at most
+  # `size` buffers are kept.  The pool is shared by the reactor and the
+  # threads of a `Puma::Server`.
+  #
+  class BufferPool # :nodoc:
+
+    def initialize(size, capacity, max_bytes)
+      @size = size
+      @capacity = capacity
+      @max_bytes = max_bytes
+      @buffers = []
+      @mutex = Mutex.new
+    end
+
+    # @return [String] an ASCII-8BIT buffer, its contents are undefined
+    def take
+      @mutex.synchronize { @buffers.pop } || String.new(capacity: @capacity)
+    end
+
+    # @param buffer [String] a buffer from #take, not used after this
+    def put(buffer)
+      return if buffer.frozen? || buffer.bytesize > @max_bytes
+      @mutex.synchronize { @buffers << buffer if @buffers.size < @size }
+    end
+
+    # @return [Integer] the number of buffers in the pool
+    def size
+      @mutex.synchronize { @buffers.size }
+    end
+  end
+end
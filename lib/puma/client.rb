@@ -3,6 +3,8 @@
 require_relative 'detect'
 require_relative 'io_buffer'
 require_relative 'client_env'
+require_relative 'lazy_env'
+require_relative 'buffer_pool'
 require 'tempfile'
 
 if Puma::IS_JRUBY
@@ -77,10 +79,20 @@ module Puma
                 :requests_served, :error_status_code
 
     attr_writer :peerip, :http_content_length_limit, :supported_http_methods,
-                :allow_underscore_headers
+                :allow_underscore_headers, :buffer_pool
 
     attr_accessor :remote_addr_header, :listener, :env_set_http_version
 
+    # The `Puma::Response::Info` reused for the responses on this connection.
+    attr_accessor :resp_info
+
+    # Set when the connection was accepted once request data arrived, see
+    # `Binder#defer_accept?`, the first read doesn't check it's readable.
+    attr_writer :accepted_with_data
+
+    # Set once the connection waits in the reactor for a request.
+    attr_accessor :used_reactor
+
     def initialize(io, env=nil)
       @io = io
       @to_io = io.to_io
@@ -118,9 +130,17 @@ module Puma
       @body_remain = 0
 
       @in_last_chunk = false
+      @chunk_decoder = nil
+      @chunk_data = nil
 
       # need unfrozen ASCII-8BIT, +'' is UTF-8
       @read_buffer = String.new # rubocop: disable Performance/UnfreezeString
+
+      @buffer_pool = nil
+      @pooled_buffer = nil
+
+      @accepted_with_data = false
+      @used_reactor = false
     end
 
     # Remove in Puma 7?
@@ -161,7 +181,17 @@ module Puma
       [@timeout_at - Process.clock_gettime(Process::CLOCK_MONOTONIC), 0].max
     end
 
+    # Uses a `Puma::LazyEnv` for the env, header values are created when read.
+    # Ignored on JRuby, its parser always creates them.
+    def lazy_env=(val)
+      return unless val && @parser.respond_to?(:lazy_env=)
+      @parser.lazy_env = true
+      @proto_env = LazyEnv[@proto_env]
+      @env = @proto_env.dup
+    end
+
     def reset
+      release_buffer
       @parser.reset
       @io_buffer.reset
       @read_header = true
@@ -194,6 +224,7 @@ module Puma
     end
 
     def close
+      release_buffer
       tempfile_close
       begin
         @io.close
@@ -255,8 +286,10 @@ module Puma
 
       data = nil
       begin
-        data = @io.read_nonblock(CHUNK_SIZE)
+        data = @io.read_nonblock(CHUNK_SIZE, @buffer ? @read_buffer : pooled_buffer)
       rescue IO::WaitReadable
+        # nothing read, a client waiting in the reactor doesn't hold the buffer
+        release_buffer unless @buffer
         return false
       rescue EOFError
         # Swallow error, don't log
@@ -271,6 +304,8 @@ module Puma
         raise EOFError
       end
 
+      # The first read of a request is into the pooled buffer and the parser
+      # runs over it, later reads are appended.
       if @buffer
         @buffer << data
       else
@@ -286,6 +321,10 @@ module Puma
 
     def eagerly_finish
       return true if @ready
+      if @accepted_with_data
+        @accepted_with_data = false
+        return true if try_to_finish
+      end
       while @to_io.wait_readable(0) # rubocop: disable Style/WhileUntilModifier
         return true if try_to_finish
       end
@@ -303,6 +342,12 @@ module Puma
     def parser_execute
       ret = @parser.execute(@env, @buffer, @parsed_bytes)
 
+      # the buffer is replaced or reused once the headers are parsed, a `dup`
+      # would share it and the next read into a pooled buffer would copy it
+      if LazyEnv === @env && @parser.finished?
+        @env.lazy_headers String.new(capacity: @buffer.bytesize) << @buffer, @parser.lazy_spans
+      end
+
       if @env[REQUEST_METHOD] && @supported_http_methods != :any && !@supported_http_methods.key?(@env[REQUEST_METHOD])
         raise HttpParserError501, "#{@env[REQUEST_METHOD]} method is not supported"
       end
@@ -420,6 +465,20 @@ module Puma
       addr.delete_prefix(IPV4_MAPPED_IPV6_PREFIX)
     end
 
+    # The buffer for the first read of a request, taken from the server's
+    # `Puma::BufferPool` until the client is reset.
+    def pooled_buffer
+      @pooled_buffer ||= @buffer_pool ? @buffer_pool.take : String.new(capacity: CHUNK_SIZE)
+    end
+
+    # Returns the pooled buffer to the server's `Puma::BufferPool`.
+    def release_buffer
+      return unless @pooled_buffer
+      @buffer = nil if @buffer.equal? @pooled_buffer
+      @buffer_pool&.put @pooled_buffer
+      @pooled_buffer = nil
+    end
+
     # Checks the request `Transfer-Encoding` and/or `Content-Length` to see if
     # they are valid.  Raises errors if not, otherwise reads the body.
     # @return [Boolean] true if the body can be completely read, false otherwise
@@ -597,6 +656,13 @@ module Puma
       @prev_chunk = ""
       @excess_cr = 0
 
+      # the C extension's decoder, JRuby uses the Ruby code in `decode_chunk`
+      if defined?(ChunkedDecoder)
+        @chunk_decoder ||= ChunkedDecoder.new MAX_CHUNK_HEADER_SIZE, MAX_CHUNK_EXCESS
+        @chunk_decoder.reset
+        @chunk_data ||= String.new # rubocop: disable Performance/UnfreezeString
+      end
+
       @body = Tempfile.create(Const::PUMA_TMP_BASE)
       File.unlink @body.path unless IS_WINDOWS
       @body.binmode
@@ -618,7 +684,24 @@ module Puma
       @chunked_content_length += @body.write(str)
     end
 
+    # Decodes with `Puma::ChunkedDecoder`, all the chunk data in +chunk+ is
+    # written at once.
+    def decode_chunk_native(chunk)
+      @chunk_data.clear
+      used = @chunk_decoder.decode chunk, @chunk_data
+      write_chunk @chunk_data unless @chunk_data.empty?
+      return false unless used
+
+      @in_last_chunk = true
+      @body.rewind
+      @buffer = used < chunk.bytesize ? chunk.byteslice(used..-1) : nil
+      set_ready
+      true
+    end
+
     def decode_chunk(chunk)
+      return decode_chunk_native(chunk) if @chunk_decoder
+
       if @partial_part_left > 0
         if @partial_part_left <= chunk.size
           if @partial_part_left > 2
@@ -134,7 +134,8 @@ module Puma
       to_add = nil
       underscore_headers = nil
 
-      @env.each do |k,v|
+      # only keys are needed, with `lazy_env` values aren't created
+      @env.each_key do |k|
         next unless k.start_with?("HTTP_") && k.include?(",")
 
         (underscore_headers ||= []) << k.delete_prefix("HTTP_").tr("_,", "-_")
@@ -146,7 +147,7 @@ module Puma
         new_k = k.tr(",", "_")
         next if @env.key?(new_k)
 
-        (to_add ||= {})[new_k] = v
+        (to_add ||= {})[new_k] = @env[k]
       end
 
       @env[PUMA_UNDERSCORE_HEADERS] = underscore_headers if underscore_headers
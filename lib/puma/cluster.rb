@@ -274,6 +274,7 @@ module Puma
     def stats
       old_worker_count = @workers.count { |w| w.phase != @phase }
       worker_status = @workers.map do |w|
+        last_status = w.last_status
         w.reset_max
         {
           started_at: utc_iso8601(w.started_at),
@@ -282,7 +283,7 @@ module Puma
           phase: w.phase,
           booted: w.booted?,
           last_checkin: utc_iso8601(w.last_checkin),
-          last_status: w.last_status,
+          last_status: last_status,
         }
       end
       {
@@ -320,7 +321,7 @@ module Puma
           @events.register(:ping!) do |w|
             fork_worker! if w.index == 0 &&
               w.phase == 0 &&
-              w.last_status[:requests_count] >= fork_requests
+              w.last_status[:requests_count].to_i >= fork_requests
           end
         end
       end
@@ -437,6 +438,11 @@ module Puma
 
       @config.run_hooks(:before_fork, nil, @log_writer)
 
+      # worker stats and accept balancing, in memory shared with the workers
+      if ClusterWorkerLoad.available?
+        @options[:worker_load] = @worker_load = ClusterWorkerLoad.new([2 * @options[:workers], 16].max)
+      end
+
       spawn_workers
 
       Signal.trap "SIGINT" do
@@ -493,6 +499,9 @@ module Puma
                   log "- Worker #{w.index} (PID: #{pid}) booted in #{w.uptime.round(2)}s, phase: #{w.phase}"
                   @next_check = Time.now
                   workers_not_booted -= 1
+                  # each worker binds its own reuse_port listeners, the
+                  # master's kept the port bound until they did
+                  @launcher.binder.close_reuse_port_listeners if all_workers_booted?
                 when PIPE_EXTERNAL_TERM
                   # external term, see worker method, Signal.trap "SIGTERM"
                   w.term!
@@ -584,6 +593,7 @@ module Puma
           #    but grand children.  Because of this they won't be reaped by `Process.wait2(-1)`.
           if (status = reaped_children.delete(w.pid) || Process.wait2(w.pid, Process::WNOHANG)&.last)
             w.process_status = status
+            @worker_load&.clear w.index
             @config.run_hooks(:after_worker_shutdown, w, @log_writer)
             true
           else
@@ -58,6 +58,8 @@ module Puma
         @config.run_hooks(:before_worker_boot, index, @log_writer, @hook_data)
 
         begin
+          @options[:worker_load]&.index = index
+          @launcher.binder.reopen_reuse_port_listeners
           @server = start_server
         rescue Exception => e
           log "! Unable to start worker"
@@ -125,17 +127,24 @@ module Puma
           stat_thread ||= Thread.new(@worker_write) do |io|
             Puma.set_thread_name "stat pld"
             base_payload = "#{PIPE_PING}#{Process.pid}"
+            # with shared stats, the ping only reports the worker is alive
+            stats_table = (table = @options[:worker_load]) && table.index ? table : nil
 
             while true
               begin
-                payload = base_payload.dup
-
-                hsh = @server.stats
-                hsh.each do |k, v|
-                  payload << %Q! "#{k}":#{v || 0},!
+                if stats_table
+                  stats_table.publish_stats @server.stats
+                  io << "#{base_payload}\n"
+                else
+                  payload = base_payload.dup
+
+                  hsh = @server.stats
+                  hsh.each do |k, v|
+                    payload << %Q! "#{k}":#{v || 0},!
+                  end
+                  # sub call properly adds 'closing' string
+                  io << payload.sub(/,\z/, " }\n")
                 end
-                # sub call properly adds 'closing' string
-                io << payload.sub(/,\z/, " }\n")
                 @server.reset_max
               rescue SystemCallError, IOError
                 break
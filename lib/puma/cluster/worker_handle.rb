@@ -28,7 +28,7 @@ module Puma
         @worker_max = Array.new WORKER_MAX_KEYS.length, 0
       end
 
-      attr_reader :index, :pid, :phase, :signal, :last_checkin, :last_status, :started_at, :process_status
+      attr_reader :index, :pid, :phase, :signal, :last_checkin, :started_at, :process_status
 
       # @version 5.0.0
       attr_writer :pid, :phase, :process_status
@@ -54,7 +54,22 @@ module Puma
         @term
       end
 
+      # The worker's `Server#stats`, read from `Puma::ClusterWorkerLoad` when
+      # the worker stores them there, otherwise from its last ping.  The last
+      # stats read are kept once another worker with the same index uses the row.
+      def last_status
+        if (table = @options[:worker_load]) && (stats = table.stats(@index, @pid))
+          @last_status = stats
+        else
+          @last_status
+        end
+      end
+
       def ping!(status)
+        @last_checkin = Time.now
+        # the stats are in shared memory
+        return last_status if status.empty?
+
         hsh = {}
         k, v = nil, nil
         status.tr('}{"', '').strip.split(", ") do |kv|
@@ -81,13 +96,13 @@ module Puma
             @worker_max[idx] = hsh[key]
           end
         end
-        @last_checkin = Time.now
         @last_status = hsh
       end
 
       # Resets max values to zero.  Called whenever `Cluster#stats` is called
       def reset_max
         WORKER_MAX_KEYS.length.times { |idx| @worker_max[idx] = 0 }
+        @options[:worker_load]&.reset_max @index
       end
 
       # @see Puma::Cluster#check_workers
@@ -0,0 +1,142 @@
+# frozen_string_literal: true
+
+module Puma
+  # The load and stats of each cluster worker, kept in a `Puma::SharedTable`
+  # the master maps before forking, one row per worker index.
+  #
+  # Each worker publishes its busy threads (processing plus queued), its
+  # backlog and its reactor size before it accepts a connection, and only
+  # accepts right away when no other worker is less busy by more than
+  # `MARGIN`.  Otherwise it waits for one of its own threads to finish, up to
+  # `wait_for_less_busy_worker` seconds, which leaves the connection to the
+  # less busy worker.  Workers with similar loads don't delay each other, as
+  # `Puma::ClusterAcceptLoopDelay` does.
+  #
+  # The row also holds the worker's `Server#stats`, stored by its stat
+  # thread, with the busy threads, backlog and request count kept current
+  # as it accepts and serves requests.  The master reads them for
+  # `Cluster#stats`, the pipe pings only report the worker is alive.
+  #
+  # A row with a negative load has no worker accepting connections, it's
+  # cleared by the worker when its server stops, and by the master when the
+  # worker exits.  Stats are only read from a row written by the worker's pid.
+  #
+  # `Puma::SharedTable` needs `mmap`, `Puma::ClusterAcceptLoopDelay` and
+  # stats in the pings are used without it.
+  #
+  # Private: API may change unexpectedly
+  class ClusterWorkerLoad
+    # `Server#stats` keys, in the order of the hash it returns
+    STAT_KEYS = [:backlog, :running, :pool_capacity, :busy_threads, :io_threads,
+      :backlog_max, :gvl_wait_time, :gvl_waiting, :max_threads, :requests_count,
+      :direct_requests_count, :reactor_max].freeze
+
+    # stats that are the maximum since `Cluster#stats` was last called
+    MAX_KEYS = [:backlog_max, :reactor_max].freeze
+
+    # Float stats, stored in thousandths
+    FLOAT_KEYS = [:gvl_wait_time, :gvl_waiting].freeze
+
+    # columns of the table, a row is 128 bytes, two cache lines, so workers
+    # don't write to the same line
+    COLS = 16
+    LOAD         = 0 # busy threads when last accepting, -1 when not
+    PID          = 1 # the worker that stored the stats
+    REACTOR_SIZE = 2
+    STATS        = 3 # STAT_KEYS start here
+
+    BACKLOG        = STATS + STAT_KEYS.index(:backlog)
+    BUSY_THREADS   = STATS + STAT_KEYS.index(:busy_threads)
+    REQUESTS_COUNT = STATS + STAT_KEYS.index(:requests_count)
+
+    # Accept when no other worker has more than this many fewer busy threads,
+    # with 1 a busy worker with one thread kept accepting next to idle ones
+    MARGIN = 0
+
+    def self.available?
+      !!defined?(::Puma::SharedTable)
+    end
+
+    # @param rows [Integer] the number of worker indexes tracked, workers with
+    #   a higher index don't use the table
+    def initialize(rows)
+      @table = SharedTable.new rows, COLS
+      rows.times { |row| clear row }
+      @index = nil
+    end
+
+    # @!attribute [rw] index
+    #   The index of this process's worker, nil in the master.
+    attr_reader :index
+
+    def index=(index)
+      @index = index && index < @table.rows ? index : nil
+    end
+
+    def rows
+      @table.rows
+    end
+
+    def publish(busy_threads, backlog, reactor_size)
+      table = @table
+      table[@index, BACKLOG] = backlog
+      table[@index, REACTOR_SIZE] = reactor_size
+      table[@index, BUSY_THREADS] = busy_threads
+      table[@index, LOAD] = busy_threads
+    end
+
+    # Stores this worker's `Server#stats`, max values are kept until the
+    # master reads them.
+    def publish_stats(stats)
+      table = @table
+      index = @index
+      STAT_KEYS.each_with_index do |key, i|
+        val = stats[key] || 0
+        val = (val * 1000).round if FLOAT_KEYS.include?(key)
+        val = table[index, STATS + i] if MAX_KEYS.include?(key) && table[index, STATS + i] > val
+        table[index, STATS + i] = val
+      end
+      table[index, PID] = Process.pid
+    end
+
+    def requests_count=(count)
+      @table[@index, REQUESTS_COUNT] = count
+    end
+
+    # Marks the row of the worker at +index+ as not accepting connections.
+    def clear(index = @index)
+      @table[index, LOAD] = -1 if index < @table.rows
+    end
+
+    # @return [Boolean] false if another worker is less busy by more than
+    #   +MARGIN+
+    def least_loaded?(busy_threads)
+      min = @table.min LOAD, @index
+      min.nil? || busy_threads <= min + MARGIN
+    end
+
+    # @return [Hash, nil] the load published by the worker at +index+
+    def [](index)
+      row = @table.row index
+      return if row[LOAD] < 0
+      { busy_threads: row[LOAD], backlog: row[BACKLOG], reactor_size: row[REACTOR_SIZE] }
+    end
+
+    # @return [Hash, nil] the stats stored by the worker at +index+, nil
+    #   unless they're from +pid+
+    def stats(index, pid)
+      return unless index < @table.rows
+      row = @table.row index
+      return unless row[PID] == pid
+      STAT_KEYS.each_with_index.to_h do |key, i|
+        [key, FLOAT_KEYS.include?(key) ? row[STATS + i] / 1000.0 : row[STATS + i]]
+      end
+    end
+
+    # Resets the max stats of the worker at +index+
+    def reset_max(index)
+      return unless index < @table.rows
+      MAX_KEYS.each { |key| @table[index, STATS + STAT_KEYS.index(key)] = 0 }
+    end
+  end
+end
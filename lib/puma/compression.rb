@@ -0,0 +1,178 @@
+# frozen_string_literal: true
+
+module Puma
+  # Compresses response bodies for the clients that accept it, set with the
+  # `compression` option, used by `Puma::Response#prepare_response`.
+  #
+  # * A file body, `to_path`, with a sibling file ending in `.br`, `.zst` or
+  #   `.gz` is sent from the sibling the client accepts, as it is.
+  # * Other bodies of at least `min_size` bytes, or of unknown size, with a
+  #   content type starting with one of `types`, are compressed by a
+  #   `Puma::Compressor`, zstd when it's available, or gzip.  Array bodies are
+  #   compressed whole and sent with a Content-Length, others are compressed
+  #   as they're sent, chunked, so only for HTTP/1.1 requests.
+  #
+  # Responses with a content-encoding or transfer-encoding set by the app,
+  # with `no-transform` in cache-control, partial responses, and responses
+  # without a body are sent as they are.
+  #
+  # Private: API may change unexpectedly
+  class Compression
+    DEFAULT_TYPES = %w[
+      text/
+      application/javascript
+      application/json
+      application/manifest+json
+      application/wasm
+      application/xml
+      image/svg+xml
+    ].freeze
+
+    # the precompressed siblings, the preferred first
+    SIBLINGS = [%w[br .br], %w[zstd .zst], %w[gzip .gz]].freeze
+
+    HTTP_ACCEPT_ENCODING = "HTTP_ACCEPT_ENCODING"
+    CONTENT_ENCODING_S = "content-encoding: "
+    VARY_ACCEPT_ENCODING = "vary: accept-encoding\r\n"
+
+    # an encoded body has a weak ETag, the app's strong one is rewritten
+    STRONG_ETAG_LINE = /\r\netag: "/
+    WEAK_ETAG_LINE = "\r\netag: W/\""
+
+    # the Accept-Encoding headers parsed, cleared when it has more
+    ACCEPTED_MAX = 64
+
+    # read from file bodies at a time
+    FILE_CHUNK = 1_024 * 64
+
+    # @return [Array<String>] the encodings `Puma::Compressor` can compress
+    def self.encodings
+      defined?(::Puma::Compressor) ? ::Puma::Compressor::ENCODINGS : []
+    end
+
+    # @param min_size [Integer] the smallest body compressed, in bytes
+    # @param types [Array<String>] the prefixes of the content types compressed
+    # @param level [Integer, nil] the compression level, nil for the default
+    def initialize(min_size: 1_024, types: DEFAULT_TYPES, level: nil)
+      @min_size = Integer(min_size)
+      @types = types.map { |t| t.to_s.downcase.freeze }.freeze
+      @level = level
+      @accepted = {}
+    end
+
+    attr_reader :min_size, :types, :level
+
+    # @param headers [Hash] the response headers
+    # @return [Boolean] whether the body may be compressed, going by the
+    #   response headers
+    def compressible?(headers)
+      return false if header(headers, 'content-encoding', 'Content-Encoding')
+
+      cache_control = header(headers, 'cache-control', 'Cache-Control')
+      return false if cache_control && cache_control.to_s.include?('no-transform')
+
+      type = header(headers, 'content-type', 'Content-Type')&.to_s
+      !!type && @types.any? { |t| type.start_with? t }
+    end
+
+    # @param accept [String, nil] the request's Accept-Encoding header
+    # @param encodings [Array<String>] the encodings to choose from, the
+    #   preferred first
+    # @return [String, nil] the encoding with the highest q-value
+    def negotiate(accept, encodings)
+      return if accept.nil? || accept.empty?
+
+      q_values = accepted accept
+      best = nil
+      best_q = 0.0
+      encodings.each do |encoding|
+        q = q_values.fetch(encoding) { q_values.fetch('*', 0.0) }
+        if q > best_q
+          best = encoding
+          best_q = q
+        end
+      end
+      best
+    end
+
+    # @param path [String] the file of the body
+    # @param accept [String, nil] the request's Accept-Encoding header
+    # @return [Array(String, String), nil] the encoding and path of the
+    #   precompressed sibling to send
+    def sibling(path, accept)
+      return if accept.nil? || accept.empty?
+
+      q_values = accepted accept
+      SIBLINGS.each do |encoding, ext|
+        next unless q_values.fetch(encoding) { q_values.fetch('*', 0.0) } > 0
+
+        fn = "#{path}#{ext}"
+        return [encoding, fn] if File.file?(fn) && File.readable?(fn)
+      end
+      nil
+    end
+
+    # @param body [#each, File]
+    # @param encoding [String] one of `Compression.encodings`
+    # @return [String] all of body compressed
+    def compress(body, encoding)
+      compressor = Compressor.new encoding, @level
+      out = +''
+      body.each { |part| out << compressor.compress(part) unless part.nil? || part.empty? }
+      out << compressor.finish
+    end
+
+    # A body compressed as it's sent, the File or Enumerable it wraps is
+    # closed with it when `close_body` is set.
+    class Body
+      def initialize(body, compressor, close_body)
+        @body = body
+        @compressor = compressor
+        @close_body = close_body
+      end
+
+      # Parts of an Enumerable body are flushed, so what the app streams
+      # reaches the client without waiting for more.
+      def each
+        if @body.is_a?(::File)
+          while (chunk = @body.read FILE_CHUNK)
+            out = @compressor.compress chunk
+            yield out unless out.empty?
+          end
+        else
+          @body.each do |part|
+            next if part.nil? || part.empty?
+            out = @compressor.compress part, true
+            yield out unless out.empty?
+          end
+        end
+        yield @compressor.finish
+      end
+
+      def close
+        @compressor.close
+        @body.close if @close_body
+      end
+    end
+
+    private
+
+    def header(headers, key, capitalized)
+      headers[key] || headers[capitalized]
+    end
+
+    # @return [Hash{String => Float}] the q-value of each coding
+    def accepted(accept)
+      @accepted[accept] ||= begin
+        @accepted.clear if @accepted.size >= ACCEPTED_MAX
+        accept.split(',').each_with_object({}) do |item, q_values|
+          coding, params = item.split(';', 2)
+          coding = coding.strip.downcase
+          next if coding.empty?
+          q = params && params[/q\s*=\s*([\d.]+)/, 1]
+          q_values[coding] = q ? q.to_f : 1.0
+        end.freeze
+      end
+    end
+  end
+end
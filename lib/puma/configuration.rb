@@ -148,6 +148,7 @@ module Puma
       # Number of seconds to wait until the next request before shutting down.
       idle_timeout: nil,
       io_selector_backend: :auto,
+      lazy_env: false,
       log_requests: false,
       logger: STDOUT,
       # Limits how many requests a keep alive connection can make.
@@ -168,6 +169,7 @@ module Puma
       raise_exception_on_sigterm: true,
       reaping_time: 1,
       remote_address: :socket,
+      response_header_cache: 256,
       silence_fork_callback_warning: false,
       silence_single_worker_warning: false,
       tag: File.basename(Dir.getwd),
@@ -87,6 +87,16 @@ module Puma
     304 => true
   }.freeze
 
+  # The status line of each code in HTTP_STATUS_CODES, so a response only
+  # needs a lookup to write it.
+  STATUS_LINES_11 = HTTP_STATUS_CODES.to_h { |code, reason|
+    [code, "HTTP/1.1 #{code} #{reason}\r\n".freeze]
+  }.freeze
+
+  STATUS_LINES_10 = HTTP_STATUS_CODES.to_h { |code, reason|
+    [code, "HTTP/1.0 #{code} #{reason}\r\n".freeze]
+  }.freeze
+
   # Frequently used constants when constructing requests or responses.  Many times
   # the constant just refers to a string with the same contents.  Using these constants
   # gave about a 3% to 10% performance improvement over using the strings directly.
@@ -144,6 +154,9 @@ module Puma
     # Maximum request body size before it is moved out of memory and into a tempfile for reading.
     MAX_BODY = MAX_HEADER
 
+    # Most connections accepted from a listener each time `IO.select` reports it readable.
+    ACCEPT_BATCH_MAX = 64
+
     REQUEST_METHOD = "REQUEST_METHOD"
     HEAD = "HEAD"
 
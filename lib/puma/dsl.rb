@@ -118,8 +118,14 @@ module Puma
             nil
           end
 
+        ktls_flag = opts[:ktls] ? '&ktls=true' : nil
+        reuse_port_flag = opts[:reuse_port] ? '&reuse_port=true' : nil
+        defer_accept_flag = opts[:defer_accept] ? "&defer_accept=#{opts[:defer_accept]}" : nil
+        fastopen_flag = opts[:fastopen] ? "&fastopen=#{opts[:fastopen]}" : nil
+
         "ssl://#{host}:#{port}?#{cert_flags}#{key_flags}#{password_flags}#{ssl_cipher_filter}#{ssl_ciphersuites}" \
-          "#{reuse_flag}&verify_mode=#{verify}#{tls_str}#{ca_additions}#{v_flags}#{backlog_str}#{low_latency_str}"
+          "#{reuse_flag}&verify_mode=#{verify}#{tls_str}#{ca_additions}#{v_flags}#{backlog_str}#{low_latency_str}#{ktls_flag}#{reuse_port_flag}" \
+          "#{defer_accept_flag}#{fastopen_flag}"
       end
     end
 
@@ -272,6 +278,19 @@ module Puma
     #   +low_latency+, default is to not optimize for low latency. This is done
     #   via +Socket::TCP_NODELAY+.
     # * Set socket permissions with +umask+.
+    # * Give each cluster worker its own +SO_REUSEPORT+ listener with
+    #   +reuse_port+, so the kernel spreads connections across the workers'
+    #   accept queues. TCP and SSL only, default is off. A worker drains its
+    #   own queue when it stops, and on Linux 5.14 or later
+    #   +net.ipv4.tcp_migrate_req=1+ moves connections still queued to
+    #   another worker when its listener is closed.
+    # * Only accept connections once request data arrives with +defer_accept+,
+    #   via +TCP_DEFER_ACCEPT+.  The value is how many seconds the kernel
+    #   waits for it, default is 1.  TCP and SSL on Linux only.
+    # * Let returning clients send their request with the SYN with +fastopen+,
+    #   via +TCP_FASTOPEN+.  The value is the queue length of pending Fast Open
+    #   connections, default is 256.  TCP and SSL on Linux only, server support
+    #   must be enabled with +net.ipv4.tcp_fastopen=3+.
     #
     # @example Backlog depth
     #   bind 'unix:///var/run/puma.sock?backlog=512'
@@ -281,6 +300,10 @@ module Puma
     #   bind 'ssl://127.0.0.1:9292?key=key.key&cert=cert.pem&ca=ca.pem&verify_mode=force_peer'
     # @example Disable optimization for low latency
     #   bind 'tcp://[::]:9292?low_latency=false'
+    # @example A listener per worker
+    #   bind 'tcp://0.0.0.0:9292?reuse_port=true'
+    # @example Accept connections with request data, TCP Fast Open
+    #   bind 'tcp://0.0.0.0:9292?defer_accept=true&fastopen=true'
     # @example Socket permissions
     #   bind 'unix:///var/run/puma.sock?umask=0111'
     #
@@ -642,6 +665,37 @@ module Puma
       @options[:max_io_threads] = max
     end
 
+    # Adjust the maximum number of threads while running, to keep the 99th
+    # percentile of the time requests wait for a thread near +target+ seconds.
+    #
+    # Every second, if the threads spent more time waiting for the GVL than
+    # one thread running, the requests are bound by Ruby code and more threads
+    # only make each of them slower, so the maximum is lowered by the average
+    # number of threads waiting, down to the minimum number of threads.
+    # Threads over it stop after their current request.
+    #
+    # If requests waited longer than +target+ and the threads mostly wait on
+    # IO, the maximum is raised again, up to the one set with +threads+.
+    #
+    # The default is off.
+    #
+    # @note Ruby 3.3 and later only, needs the thread event hooks of MRI.
+    #
+    # @example
+    #   threads 1, 16
+    #   adaptive_threads 0.05
+    #
+    # @see Puma::QueueDelayController
+    #
+    def adaptive_threads(target = 0.025)
+      target = Float(target)
+      if target <= 0
+        raise "The adaptive threads target (#{target}) must be greater than 0"
+      end
+
+      @options[:adaptive_threads] = target
+    end
+
     # Instead of using +bind+ and manually constructing a URI like:
     #
     #    bind 'ssl://127.0.0.1:9292?key=key_path&cert=cert_path'
@@ -662,6 +716,16 @@ module Puma
     # The `cert_pem:` options hash parameter can be a String containing the
     # certificate and all intermediate certificates in PEM format.
     #
+    # The `ktls:` options hash parameter enables kernel TLS on Linux with
+    # OpenSSL 3.0 or later.  After the handshake, the kernel encrypts the
+    # response, so file bodies are sent with `sendfile`.  When the kernel
+    # or cipher doesn't support it, OpenSSL encrypts as usual.  The `tls`
+    # kernel module must be loaded.
+    #
+    # The `reuse_port:` options hash parameter gives each cluster worker its
+    # own `SO_REUSEPORT` listener, the `defer_accept:` and `fastopen:` ones
+    # set `TCP_DEFER_ACCEPT` and `TCP_FASTOPEN`, see #bind.
+    #
     # @example
     #   ssl_bind '127.0.0.1', '9292', {
     #     cert: path_to_cert,
@@ -670,7 +734,11 @@ module Puma
     #     ssl_ciphersuites: ciphersuites,   # optional
     #     verify_mode: verify_mode,         # default 'none'
     #     verification_flags: flags,        # optional, not supported by JRuby
-    #     reuse: true                       # optional
+    #     reuse: true,                      # optional
+    #     ktls: true,                       # optional, not supported by JRuby
+    #     reuse_port: true,                 # optional, not supported by JRuby
+    #     defer_accept: 1,                  # optional, not supported by JRuby
+    #     fastopen: 256                     # optional, not supported by JRuby
     #   }
     #
     # @example Using self-signed certificate with the +localhost+ gem:
@@ -1350,6 +1418,11 @@ module Puma
     # listening on the socket, allowing workers which are not processing as many
     # requests to pick up new requests first.
     #
+    # Where `mmap` is available, workers publish their busy threads in memory
+    # shared with the master, and a worker only waits when another worker is
+    # less busy, until one of its own threads is free or this delay passes.
+    # Otherwise the delay grows with the worker's busy threads.
+    #
     # The default is 0.005 seconds.
     #
     # To turn off this feature, set the value to 0.
@@ -1359,7 +1432,7 @@ module Puma
     # @note Interpreters with forking support only.
     #
     # @see Puma::Server#handle_servers
-    # @see Puma::ThreadPool#wait_for_less_busy_worker
+    # @see Puma::ClusterWorkerLoad
     #
     def wait_for_less_busy_worker(val=0.005)
       @options[:wait_for_less_busy_worker] = val.to_f
@@ -1509,6 +1582,102 @@ module Puma
       @options[:allow_underscore_headers] = allowed
     end
 
+    # When +true+, request header values are only converted to Strings when the
+    # app reads them, which saves allocations when an app reads a few of the
+    # headers sent.  The env is a +Puma::LazyEnv+, a Hash subclass.
+    #
+    # The default is +false+.  Not supported on JRuby.
+    #
+    # @note A plain Hash passed the env as an argument, for instance
+    #   +{}.merge(env)+, doesn't see header values the app hasn't read, use
+    #   +env.to_h+ in that case.
+    #
+    # @example
+    #   lazy_env true
+    #
+    def lazy_env(enabled=true)
+      @options[:lazy_env] = enabled
+    end
+
+    # Compress response bodies for the clients that accept it, with zstd or
+    # gzip.  A file body with a precompressed sibling, ending in +.br+, +.zst+
+    # or +.gz+, is sent from the sibling instead.  Compression runs without
+    # the GVL for parts of 16 kB and more.
+    #
+    # Bodies smaller than +min_size+ bytes, or with a content type that
+    # doesn't start with one of +types+, are sent as they are.  Bodies other
+    # than Arrays are compressed as they're sent, chunked, so only for
+    # HTTP/1.1 requests.  +level+ is the compression level, the library's
+    # default when +nil+.
+    #
+    # The default is off.  Not supported on JRuby, which only sends the
+    # precompressed siblings.
+    #
+    # @example
+    #   compression
+    # @example
+    #   compression min_size: 4096, types: %w[text/html application/json], level: 4
+    #
+    # @see Puma::Compression
+    #
+    def compression(enabled = true, min_size: 1_024, types: nil, level: nil)
+      @options[:compression] = if enabled
+        { min_size: Integer(min_size), types: types, level: level }.compact
+      end
+    end
+
+    # Keep small files sent as +to_path+ response bodies in memory, like the
+    # assets of +Rack::Files+ and +ActionDispatch::Static+, for the requests
+    # whose path starts with one of +prefixes+, all when there are none.  A
+    # cached file is sent without opening or reading it, with an ETag and a
+    # Last-Modified header, and a request with an If-None-Match or
+    # If-Modified-Since header it matches is answered with 304 without
+    # calling the app, when the same URI was answered with the file before.
+    #
+    # Files larger than +max_file_size+ bytes are sent as they are.  At most
+    # +max_entries+ files and +max_bytes+ bytes, with their compressed
+    # encodings, are kept, the oldest files are dropped first.  A file is
+    # dropped when it changes, told by inotify on Linux, otherwise by a stat
+    # of the file at most every second.
+    #
+    # The default is off..
+    #
+    # @example
+    #   static_file_cache '/assets/', '/packs/'
+    # @example
+    #   static_file_cache max_entries: 4096, max_bytes: 256 * 1024 * 1024
+    #
+    # @see Puma::StaticFileCache
+    #
+    def static_file_cache(*prefixes, max_entries: 1_024, max_file_size: 1_024 * 256,
+        max_bytes: 1_024 * 1_024 * 64)
+      @options[:static_file_cache] = {
+        prefixes: prefixes.flatten.map(&:to_s),
+        max_entries: Integer(max_entries),
+        max_file_size: Integer(max_file_size),
+        max_bytes: Integer(max_bytes),
+      }
+    end
+
+    # The number of response headers whose lines are kept, for headers with a
+    # frozen String key and value, like the constants of a framework.  Such a
+    # header is written with one copy while it's among the +entries+ most
+    # recently used ones.  +0+ turns the cache off.
+    #
+    # The default is +256+.  Not supported on JRuby.
+    #
+    # @example
+    #   response_header_cache 1024
+    #
+    def response_header_cache(entries)
+      entries = Integer(entries)
+      if entries < 0
+        raise "The response header cache size (#{entries}) must be zero or a positive number"
+      end
+
+      @options[:response_header_cache] = entries
+    end
+
     # Specify the backend for the IO selector.
     #
     # Provided values will be passed directly to +NIO::Selector.new+, with the
@@ -1520,10 +1689,16 @@ module Puma
     # recommended due to its comparatively low performance), set environment
     # variable +NIO4R_PURE+ to +true+.
     #
+    # On Linux, +:native+ uses an epoll selector in Puma's C extension instead
+    # of nio4r.  It hands ready clients to the reactor without creating an
+    # +NIO::Monitor+ for each.
+    #
     # The default is +:auto+.
     #
     # @example
     #   io_selector_backend :epoll
+    # @example
+    #   io_selector_backend :native
     #
     # @see https://github.com/socketry/nio4r/blob/main/lib/nio/selector.rb
     #
@@ -0,0 +1,121 @@
+# frozen_string_literal: true
+
+require 'puma/puma_http11'
+
+module Puma
+
+  #———————————————————————— DO NOT USE — this class is for internal use only ———
+
+
+  # The env Hash used with the `lazy_env` option.  The parser records where
+  # each header value is in the request buffer, and the value String is only
+  # created when the header is read.  Most apps read a few of the headers a
+  # browser or proxy sends.
+  #
+  # Methods that only need keys (`key?`, `keys`, `each_key`, `size`) don't
+  # create values, reading a key (`[]`, `fetch`, `dig`, ...) creates only its
+  # value, and all other Hash methods create every pending value first.
+  #
+  # `lazy_headers`, `[]`, `key?` and its aliases, `lazy_value` and
+  # `lazy_values` are defined in `ext/puma_http11/lazy_env.c`, the class isn't
+  # used on JRuby.
+  #
+  # @note A plain Hash that is passed a LazyEnv, for instance
+  #   `{}.merge(env)` or `hash == env`, reads its table directly and doesn't
+  #   see values that haven't been created, use `env.to_h` in that case.
+  #
+  class LazyEnv < Hash # :nodoc:
+
+    def fetch(key, *args, &block)
+      lazy_value key if @lazy_spans
+      super
+    end
+
+    def dig(key, *rest)
+      lazy_value key if @lazy_spans
+      super
+    end
+
+    def assoc(key)
+      lazy_value key if @lazy_spans
+      super
+    end
+
+    def delete(key, &block)
+      lazy_value key if @lazy_spans
+      super
+    end
+
+    def values_at(*keys)
+      keys.each { |k| lazy_value k } if @lazy_spans
+      super
+    end
+
+    def fetch_values(*keys, &block)
+      keys.each { |k| lazy_value k } if @lazy_spans
+      super
+    end
+
+    def store(key, value)
+      lazy_drop key if @lazy_spans
+      super
+    end
+
+    def []=(key, value)
+      lazy_drop key if @lazy_spans
+      super
+    end
+
+    def keys
+      @lazy_spans ? super.concat(@lazy_spans.keys) : super
+    end
+
+    # Iterates over a copy of the keys, so the block may read values.
+    def each_key(&block)
+      return enum_for(:each_key) { size } unless block
+      keys.each(&block)
+      self
+    end
+
+    def size
+      @lazy_spans ? super + @lazy_spans.size : super
+    end
+
+    def length
+      @lazy_spans ? super + @lazy_spans.size : super
+    end
+
+    def empty?
+      @lazy_spans.nil? && super
+    end
+
+    def initialize_copy(other)
+      other.lazy_values
+      super
+      @lazy_data = nil
+      @lazy_spans = nil
+    end
+
+    # Hash#[] calls #default for missing keys, these don't read values.
+    NO_VALUES = %i[default default= default_proc default_proc=
+      compare_by_identity compare_by_identity?].freeze
+    private_constant :NO_VALUES
+
+    # Every other Hash method sees all values.
+    (Hash.public_instance_methods(false) - public_instance_methods(false) - NO_VALUES).each do |name|
+      define_method(name) do |*args, &block|
+        lazy_values if @lazy_spans
+        super(*args, &block)
+      end
+    end
+
+    private
+
+    def lazy_drop(key)
+      @lazy_spans.delete key
+      return unless @lazy_spans.empty?
+      @lazy_data = nil
+      @lazy_spans = nil
+    end
+  end
+end
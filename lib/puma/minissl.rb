@@ -74,19 +74,28 @@ module Puma
         end
       end
 
-      def engine_read_all
-        output = @engine.read
-        while output and additional_output = @engine.read
-          output << additional_output
+      if IS_JRUBY
+        def engine_read_all(_buffer = nil)
+          output = @engine.read
+          while output and additional_output = @engine.read
+            output << additional_output
+          end
+          output
+        end
+      else
+        # `Engine#read` returns all decrypted data, in +buffer+ if given
+        def engine_read_all(buffer = nil)
+          @engine.read buffer
         end
-        output
       end
 
-      def read_nonblock(size, *_)
-        # *_ is to deal with keyword args that were added
+      # Like `IO#read_nonblock`, returns all decrypted data, which may be more
+      # than +size+.  On MRI, +buffer+ is filled and returned if given.
+      def read_nonblock(size, buffer = nil, *_, **)
+        # *_ and ** are to deal with args that were added
         # at some point (and being used in the wild)
         while true
-          output = engine_read_all
+          output = engine_read_all buffer
           return output if output
 
           data = @socket.read_nonblock(size, exception: false)
@@ -107,7 +116,7 @@ module Puma
           end
 
           @engine.inject(data)
-          output = engine_read_all
+          output = engine_read_all buffer
 
           return output if output
 
@@ -126,11 +135,12 @@ module Puma
         while true
           wrote = @engine.write data
 
-          enc_wr = +''
-          while (enc = @engine.extract)
+          # MRI extracts all pending data at once, JRuby a record at a time
+          enc_wr = @engine.extract
+          while enc_wr and (enc = @engine.extract)
             enc_wr << enc
           end
-          @socket.write enc_wr unless enc_wr.empty?
+          @socket.write enc_wr if enc_wr
 
           need -= wrote
 
@@ -164,6 +174,10 @@ module Puma
         @socket.flush
       end
 
+      def wait_writable(timeout = nil)
+        @socket.wait_writable timeout
+      end
+
       def close
         begin
           unless @engine.shutdown
@@ -199,9 +213,68 @@ module Puma
       end
     end
 
+    # Used with `Context#ktls`.  OpenSSL reads and writes the socket instead
+    # of memory BIOs, so `#inject` and `#extract` aren't used.  When the
+    # kernel and the negotiated cipher support kTLS, the kernel encrypts
+    # what is written to the socket, and responses are written to it
+    # directly, including with `IO.copy_stream`.  Otherwise writes go through
+    # `SSL_write`.
+    class KTLSSocket < Socket
+      def readpartial(size)
+        while true
+          output = @engine.read
+          return output if String === output
+
+          output == :wait_writable ? @socket.wait_writable : @socket.wait_readable
+        end
+      end
+
+      def read_nonblock(size, buffer = nil, *_, **)
+        while true
+          output = @engine.read buffer
+          return output if String === output
+          raise IO::EAGAINWaitReadable unless output == :wait_writable
+
+          # the handshake needs to write
+          @socket.wait_writable
+        end
+      end
+
+      def write(data)
+        return @socket.write(data) if ktls_send?
+        return 0 if data.empty?
+
+        data_size = data.bytesize
+        need = data_size
+
+        while true
+          if (wrote = @engine.write data)
+            need -= wrote
+            return data_size if need == 0
+            data = data.byteslice(wrote..-1)
+          else
+            @socket.wait_writable
+          end
+        end
+      end
+
+      alias_method :syswrite, :write
+      alias_method :<<, :write
+
+      def write_nonblock(data, *_)
+        ktls_send? ? @socket.write_nonblock(data) : write(data)
+      end
+
+      # @return [Boolean] true if the kernel encrypts writes to `#to_io`
+      def ktls_send?
+        @ktls_send ||= @engine.ktls_send?
+      end
+    end
+
     if IS_JRUBY
       OPENSSL_NO_SSL3 = false
       OPENSSL_NO_TLS1 = false
+      HAS_KTLS = false
     end
 
     class Context
@@ -218,6 +291,7 @@ module Puma
         @reuse = nil
         @reuse_cache_size = nil
         @reuse_timeout = nil
+        @ktls = false
       end
 
       def check_file(file, desc)
@@ -293,6 +367,10 @@ module Puma
 
         attr_reader :reuse, :reuse_cache_size, :reuse_timeout
 
+        # When true, OpenSSL reads and writes the socket directly and enables
+        # kernel TLS, see `MiniSSL::KTLSSocket`.  Ignored unless `HAS_KTLS`.
+        attr_accessor :ktls
+
         def key=(key)
           check_file key, 'Key'
           @key = key
@@ -419,20 +497,24 @@ module Puma
         @socket = socket
         @ctx = ctx
         @eng_ctx = IS_JRUBY ? @ctx : SSLContext.new(ctx)
+        @ktls = !IS_JRUBY && HAS_KTLS && ctx.ktls
       end
 
       def accept
         @ctx.check
-        io = @socket.accept
-        engine = Engine.server @eng_ctx
-        Socket.new io, engine
+        new_socket @socket.accept
       end
 
       def accept_nonblock
         @ctx.check
-        io = @socket.accept_nonblock
-        engine = Engine.server @eng_ctx
-        Socket.new io, engine
+        new_socket @socket.accept_nonblock
+      end
+
+      # @return [Array<Socket>] up to +max+ connections queued on the
+      #   socket, see `Puma::NativeIO.accept`
+      def accept_batch(max)
+        @ctx.check
+        NativeIO.accept(@socket, max).map! { |io| new_socket io }
       end
 
       # @!attribute [r] to_io
@@ -453,6 +535,16 @@ module Puma
       def closed?
         @socket.closed?
       end
+
+      private
+
+      def new_socket(io)
+        if @ktls
+          KTLSSocket.new io, Engine.server(@eng_ctx, io.fileno)
+        else
+          Socket.new io, Engine.server(@eng_ctx)
+        end
+      end
     end
   end
 end
@@ -60,6 +60,14 @@ module Puma
           ctx.ssl_ciphersuites = params['ssl_ciphersuites'] if params['ssl_ciphersuites'] && HAS_TLS1_3
 
           ctx.reuse = params['reuse'] if params['reuse']
+
+          if params['ktls'] == 'true'
+            if MiniSSL::HAS_KTLS
+              ctx.ktls = true
+            else
+              log_writer.log "WARNING: 'ktls' needs OpenSSL 3.0 or later with kTLS on Linux, ignoring it"
+            end
+          end
         end
 
         ctx.no_tlsv1   = params['no_tlsv1'] == 'true'
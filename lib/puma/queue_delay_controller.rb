@@ -0,0 +1,112 @@
+# frozen_string_literal: true
+
+module Puma
+  # Adjusts the maximum threads of a `Puma::ThreadPool` while it runs, set
+  # with the `adaptive_threads` option.
+  #
+  # The pool records how long each request waited in its queue and how long
+  # it took, and every `INTERVAL` seconds `#adapt` takes the 99th percentile
+  # of the delays in the window.  The pool's `Puma::GVLMeter` gives, over the
+  # window:
+  #
+  # * the average number of threads waiting for the GVL
+  # * how many threads keep the GVL busy, the time requests took, less their
+  #   GVL waits, divided by the time the threads held the GVL.  With requests
+  #   that spend 10 ms running Ruby code and 40 ms waiting on IO, it's 5.
+  #
+  # When more than `GVL_SATURATED` threads are waiting for the GVL, more
+  # threads only lengthen each request, so the maximum is lowered to the
+  # running threads less the waiting ones, down to `min_threads` and at
+  # least one.  When the p99 delay is over the target and all threads are
+  # running, the maximum is raised by a quarter, up to one more than the
+  # threads that keep the GVL busy, and to `max_threads`.  It starts at
+  # `max_threads`, so the pool never runs more threads than without it.
+  #
+  # The delays are counted in buckets four per doubling, the p99 is the upper
+  # bound of its bucket, up to 19% over the actual delay.
+  #
+  # Needs `Puma::GVLMeter`, Ruby 3.3 or later.
+  #
+  # Private: API may change unexpectedly
+  class QueueDelayController
+    INTERVAL = 1 # seconds
+
+    # average threads waiting for the GVL above which threads are removed
+    GVL_SATURATED = 1.0
+
+    BUCKETS_PER_DOUBLING = 4
+    BUCKETS = 36 * BUCKETS_PER_DOUBLING # 1 µs up to 19 hours
+
+    def self.available?
+      !!defined?(::Puma::GVLMeter)
+    end
+
+    # @param target [Float] the p99 queue delay to hold, in seconds
+    # @param gvl_meter [Puma::GVLMeter] tracking the pool's threads
+    def initialize(target, gvl_meter)
+      @target = target
+      @gvl_meter = gvl_meter
+      @counts = Array.new BUCKETS, 0
+      @busy_time = 0.0
+      @last = [Process.clock_gettime(Process::CLOCK_MONOTONIC), 0.0, 0.0, 0.0]
+    end
+
+    attr_reader :target
+
+    # Counts a request that waited +delay+ seconds in the queue, and took
+    # +time+ seconds.  Called by the pool threads without a lock, a count
+    # lost to a thread switch doesn't matter.
+    def record(delay, time)
+      @busy_time += time
+      us = delay * 1_000_000
+      i = us < 1 ? 0 : (Math.log2(us) * BUCKETS_PER_DOUBLING).to_i + 1
+      @counts[i < BUCKETS ? i : BUCKETS - 1] += 1
+    end
+
+    # @return [Array(Float, Float, Float)] since the last call, the p99 queue
+    #   delay, the average threads waiting for the GVL, and the threads that
+    #   keep the GVL busy, nil without requests
+    def sample
+      now = [Process.clock_gettime(Process::CLOCK_MONOTONIC), @gvl_meter.wait_time,
+        @gvl_meter.run_time, @busy_time]
+      elapsed, wait, run, busy = now.zip(@last).map { |a, b| a - b }
+      @last = now
+
+      gvl_threads = [(busy - wait) / run, 1.0].max if busy > 0 && run > 0
+      counts, @counts = @counts, Array.new(BUCKETS, 0)
+      [p99(counts), wait / elapsed, gvl_threads]
+    end
+
+    # @param max [Integer] the current maximum threads
+    # @param running [Integer] the threads running, not counting IO threads
+    # @param floor [Integer] the fewest threads allowed
+    # @param ceiling [Integer] the configured maximum threads
+    # @return [Integer] the new maximum threads
+    def adapt(max, running, floor, ceiling)
+      p99, gvl_waiting, gvl_threads = sample
+
+      if gvl_waiting > GVL_SATURATED
+        [[max, running].min - gvl_waiting.to_i, floor].max
+      elsif p99 && p99 > @target && running >= max
+        limit = gvl_threads ? [gvl_threads.ceil + 1, ceiling].min : ceiling
+        [[max + (max + 3) / 4, limit].min, max].max
+      else
+        max
+      end
+    end
+
+    private
+
+    def p99(counts)
+      total = counts.sum
+      return if total.zero?
+
+      rank = total - total / 100
+      seen = 0
+      counts.each_with_index do |count, i|
+        seen += count
+        return i.zero? ? 0.0 : 2 ** (i.to_f / BUCKETS_PER_DOUBLING) / 1_000_000 if seen >= rank
+      end
+    end
+  end
+end
@@ -1,5 +1,7 @@
 # frozen_string_literal: true
 
+require_relative 'timeout_heap'
+
 module Puma
   class UnsupportedBackend < StandardError; end
 
@@ -8,10 +10,11 @@ module Puma
   #
   # The waiting/wake up is performed with nio4r, which will use the appropriate backend (libev,
   # Java NIO or just plain IO#select). The call to `NIO::Selector#select` will
-  # 'wakeup' any IO object that receives data.
+  # 'wakeup' any IO object that receives data.  With the `:native` backend,
+  # `Puma::EPollSelector` from the C extension is used instead of nio4r.
   #
-  # This class additionally tracks a timeout for every added object,
-  # and wakes up any object when its timeout elapses.
+  # This class additionally tracks a timeout for every added object in a
+  # `Puma::TimeoutHeap`, and wakes up any object when its timeout elapses.
   #
   # The implementation uses a Queue to synchronize adding new objects from the internal select loop.
   class Reactor
@@ -25,15 +28,22 @@ module Puma
     # The provided block will be invoked when an IO has data available to read,
     # its timeout elapses, or when the Reactor shuts down.
     def initialize(backend, &block)
-      require 'nio'
-      valid_backends = [:auto, *::NIO::Selector.backends]
-      unless valid_backends.include?(backend)
-        raise ArgumentError.new("unsupported IO selector backend: #{backend} (available backends: #{valid_backends.join(', ')})")
-      end
+      if backend == :native && defined?(EPollSelector)
+        @selector = EPollSelector.new
+        @native = true
+      else
+        require 'nio'
+        valid_backends = [:auto, *::NIO::Selector.backends]
+        valid_backends << :native if defined?(EPollSelector)
+        unless valid_backends.include?(backend)
+          raise ArgumentError.new("unsupported IO selector backend: #{backend} (available backends: #{valid_backends.join(', ')})")
+        end
 
-      @selector = ::NIO::Selector.new(NIO::Selector.backends.delete(backend))
+        @selector = ::NIO::Selector.new(NIO::Selector.backends.delete(backend))
+        @native = false
+      end
       @input = Queue.new
-      @timeouts = []
+      @timeouts = TimeoutHeap.new
       @block = block
       @reactor_size = 0
       @reactor_max = 0
@@ -79,21 +89,24 @@ module Puma
         until @input.closed? && @input.empty?
           # Wakeup any registered object that receives incoming data.
           # Block until the earliest timeout or Selector#wakeup is called.
-          timeout = (earliest = @timeouts.first) && earliest.timeout
-          @selector.select(timeout) do |monitor|
-            wakeup!(monitor.value)
+          timeout = (timeout_at = @timeouts.next_timeout_at) &&
+            [timeout_at - Process.clock_gettime(Process::CLOCK_MONOTONIC), 0].max
+          if @native
+            @selector.select(timeout) { |client| wakeup!(client) }
+          else
+            @selector.select(timeout) do |monitor|
+              wakeup!(monitor.value)
+            end
           end
 
-          # Wakeup all objects that timed out.
-          timed_out = @timeouts.take_while { |client| client.timeout == 0 }
-          timed_out.each { |client| wakeup!(client) }
+          # Wakeup all objects that timed out, ones still monitored afterwards
+          # get their new timeout.
+          timed_out = @timeouts.pop_expired Process.clock_gettime(Process::CLOCK_MONOTONIC)
+          timed_out.each { |client| @timeouts.add client unless wakeup!(client) }
 
-          unless @input.empty?
-            until @input.empty?
-              client = @input.pop
-              register(client) if client.io_ok?
-            end
-            @timeouts.sort_by!(&:timeout_at)
+          until @input.empty?
+            client = @input.pop
+            register(client) if client.io_ok?
           end
         end
       rescue StandardError => e
@@ -110,21 +123,29 @@ module Puma
 
     # Start monitoring the object.
     def register(client)
-      @selector.register(client.to_io, :r).value = client
+      if @native
+        @selector.register client.to_io, client
+      else
+        @selector.register(client.to_io, :r).value = client
+      end
       @reactor_size += 1
       @reactor_max = @reactor_size if @reactor_max < @reactor_size
-      @timeouts << client
+      @timeouts.add client
     rescue ArgumentError
       # unreadable clients raise error when processed by NIO
     end
 
     # 'Wake up' a monitored object by calling the provided block.
     # Stop monitoring the object if the block returns `true`.
+    # @return [Boolean] true if the object is no longer monitored
     def wakeup!(client)
       if @block.call client
         @selector.deregister client.to_io
         @reactor_size -= 1
         @timeouts.delete client
+        true
+      else
+        false
       end
     end
   end
@@ -31,6 +31,14 @@ module Puma
 
     CUSTOM_STAT = 'CUSTOM'
 
+    # What `#str_headers` found in the request and the response headers, each
+    # client keeps one for its requests when `Puma::NativeHeaders` writes the
+    # headers.
+    Info = Struct.new(:no_body, :allow_chunked, :keep_alive, :content_length,
+      :transfer_encoding, :response_hijack)
+
+    NATIVE_HEADERS = !!defined?(::Puma::NativeHeaders)
+
     include Puma::Const
 
     # Takes the request contained in +client+, invokes the Rack application to construct
@@ -75,9 +83,11 @@ module Puma
       env["puma.mark_as_io_bound"] = -> { processor.mark_as_io_thread! }
 
       begin
-        status, headers, app_body = @thread_pool.with_force_shutdown do
-          @app.call(env)
-        end
+        # answered without the app, see Puma::StaticFileCache
+        status, headers, app_body = @static_file_cache&.not_modified(env) ||
+          @thread_pool.with_force_shutdown do
+            @app.call(env)
+          end
 
         # app_body needs to always be closed, hold value in case lowlevel_error
         # is called
@@ -151,17 +161,25 @@ module Puma
       # Close the connection after a reasonable number of inline requests
       force_keep_alive = @enable_keep_alives && client.requests_served < @max_keep_alive
 
-      resp_info = str_headers(env, status, headers, res_body, io_buffer, force_keep_alive)
+      resp_info = str_headers(env, status, headers, res_body, io_buffer, force_keep_alive,
+        NATIVE_HEADERS ? (client.resp_info ||= Info.new) : nil)
 
       close_body = false
       response_hijack = nil
+      entry = nil
       content_length = resp_info[:content_length]
       keep_alive     = resp_info[:keep_alive]
 
       if res_body.respond_to?(:each) && !resp_info[:response_hijack]
         # below converts app_body into body, dependent on app_body's characteristics, and
         # content_length will be set if it can be determined
-        if !content_length && !resp_info[:transfer_encoding] && status != 204
+        if @static_file_cache && status == 200 && !resp_info[:transfer_encoding] &&
+            res_body.respond_to?(:to_path) &&
+            (entry = @static_file_cache.fetch env, res_body.to_path)
+          # an Array body, the file isn't opened or read
+          body = entry.body
+          content_length = entry.bytesize
+        elsif !content_length && !resp_info[:transfer_encoding] && status != 204
           if res_body.respond_to?(:to_ary) && (array_body = res_body.to_ary) &&
               array_body.is_a?(Array)
             body = array_body.compact
@@ -174,6 +192,11 @@ module Puma
             body = File.open fn, 'rb'
             content_length = body.size
             close_body = true
+          elsif (range = file_body_range res_body)
+            body = File.open res_body.path, 'rb'
+            body.seek range.begin
+            content_length = range.size
+            close_body = true
           else
             body = res_body
           end
@@ -182,6 +205,11 @@ module Puma
           body = File.open fn, 'rb'
           content_length = body.size
           close_body = true
+        elsif (range = file_body_range res_body)
+          body = File.open res_body.path, 'rb'
+          body.seek range.begin
+          content_length = range.size
+          close_body = true
         elsif !res_body.is_a?(::File) && res_body.respond_to?(:filename) &&
             res_body.respond_to?(:bytesize) && File.readable?(fn = res_body.filename)
           # Sprockets::Asset
@@ -202,6 +230,21 @@ module Puma
         response_hijack = resp_info[:response_hijack] || res_body
       end
 
+      # a HEAD request gets the headers a GET would, without a body compressed
+      if @compression && body && status != 206 && !resp_info[:transfer_encoding] &&
+          (!resp_info[:no_body] ||
+            (env[REQUEST_METHOD] == HEAD && status >= 200 && !STATUS_WITH_NO_ENTITY_BODY[status])) &&
+          @compression.compressible?(headers)
+        body, content_length, close_body = compress_response env, body, content_length,
+          close_body, resp_info[:allow_chunked], io_buffer, entry
+        vary = true
+      end
+
+      if entry
+        @static_file_cache.write_headers env, entry, headers, io_buffer,
+          !body.equal?(entry.body), vary
+      end
+
       line_ending = LINE_END
 
       cork_socket socket
@@ -248,6 +291,70 @@ module Puma
       !shutting_down? && keep_alive ? :keep_alive : :close
     end
 
+    # Replaces `body` with a precompressed sibling file or a compressed body
+    # when the client accepts one, see `Puma::Compression`, and adds the
+    # content-encoding and vary headers to `io_buffer`.  A strong ETag from
+    # the app is made weak when the body is encoded.  For a HEAD request only
+    # the headers are changed, the length is nil unless a sibling or cached
+    # encoding gives it.
+    # @param env [Hash]
+    # @param body [Array, File, #each] the body `#prepare_response` would send
+    # @param content_length [Integer, nil]
+    # @param close_body [Boolean] whether `body` is closed after it's sent
+    # @param chunkable [Boolean] whether the response may be chunked
+    # @param io_buffer [Puma::IOBuffer] contains headers
+    # @param entry [Puma::StaticFileCache::Entry, nil] the cached file of
+    #   `body`, its encodings are kept with it
+    # @return [Array(Object, Integer, Boolean)] the body, its length, nil when
+    #   unknown, and whether it's closed after it's sent
+    #
+    def compress_response(env, body, content_length, close_body, chunkable, io_buffer, entry = nil)
+      accept = env[Compression::HTTP_ACCEPT_ENCODING]
+      head = env[REQUEST_METHOD] == HEAD
+
+      if entry
+        if (encoding, variant = @static_file_cache.variant entry, accept)
+          body = variant
+          content_length = variant[0].bytesize
+        end
+      elsif close_body && body.is_a?(::File) &&
+          (encoding, fn = @compression.sibling(body.path, accept))
+        if head
+          content_length = File.size fn
+        else
+          body.close
+          body = File.open fn, 'rb'
+          content_length = body.size
+        end
+      elsif content_length && content_length < @compression.min_size
+        return [body, content_length, close_body]
+      elsif (encoding = @compression.negotiate accept, Compression.encodings)
+        if head && (chunkable || body.is_a?(::Array))
+          # the length isn't known without compressing the body
+          content_length = nil
+        elsif body.is_a?(::Array)
+          body = [@compression.compress(body, encoding)]
+          content_length = body[0].bytesize
+        elsif chunkable
+          body = Compression::Body.new body, Compressor.new(encoding, @compression.level), close_body
+          content_length = nil
+          close_body = true
+        else
+          encoding = nil
+        end
+      end
+
+      if encoding
+        # the app's ETag line is already in io_buffer
+        if io_buffer.string.sub!(Compression::STRONG_ETAG_LINE, Compression::WEAK_ETAG_LINE)
+          io_buffer.seek 0, IO::SEEK_END
+        end
+        io_buffer.append Compression::CONTENT_ENCODING_S, encoding, LINE_END
+      end
+      io_buffer << Compression::VARY_ACCEPT_ENCODING
+      [body, content_length, close_body]
+    end
+
     # Used to write 'early hints', 'no body' responses, 'hijacked' responses,
     # and body segments (called by `fast_write_response`).
     # Writes a string to a socket (normally `Client#io`) using `write_nonblock`.
@@ -297,9 +404,11 @@ module Puma
             fast_write_str socket, io_buffer.read_and_reset
           else
             fast_write_str socket, io_buffer.read_and_reset
-            IO.copy_stream body, socket
+            fast_write_file socket, body, content_length
           end
         end
+      elsif body.is_a?(::Array) && (io = native_io socket)
+        fast_writev io, body, io_buffer, chunked
       elsif body.is_a?(::Array) && body.length == 1
         body_first = nil
         # using body_first = body.first causes issues?
@@ -369,7 +478,77 @@ module Puma
       raise ConnectionError, SOCKET_WRITE_ERR_MSG
     end
 
-    private :fast_write_str, :fast_write_response
+    # Writes `length` bytes of `file`, from its current position, with
+    # `Puma::NativeIO.sendfile` when `socket` is a plain or kTLS socket.
+    # Otherwise `IO.copy_stream` is used, which has no write timeout.
+    # @param socket [#write] the response socket
+    # @param file [File] the body, positioned at the first byte to send
+    # @param length [Integer]
+    # @raise [ConnectionError]
+    #
+    def fast_write_file(socket, file, length)
+      if (io = native_io socket) && NativeIO.respond_to?(:sendfile)
+        # fewer bytes means the file was truncated, Content-Length was wrong
+        unless NativeIO.sendfile(io, file, file.pos, length, WRITE_TIMEOUT) == length
+          raise ConnectionError, SOCKET_WRITE_ERR_MSG
+        end
+      else
+        # with kTLS the kernel encrypts, so the file can be sent to the socket
+        IO.copy_stream file, (ktls_io(socket) || socket), length
+      end
+    end
+
+    # Rack::Files responses for one byte range (status 206) have a body with
+    # `path` and `ranges`, but not `to_path`, since it isn't the whole file.
+    # @return [Range, nil] the bytes of `res_body.path` that are the body
+    def file_body_range(res_body)
+      return unless res_body.respond_to?(:ranges) && res_body.respond_to?(:path)
+      ranges = res_body.ranges
+      return unless ranges.is_a?(::Array) && ranges.length == 1 &&
+        (range = ranges.first).is_a?(::Range) && File.readable?(res_body.path)
+      range
+    end
+
+    # Writes the headers in `io_buffer` and the Strings of an Array body with
+    # `Puma::NativeIO.writev`, so body parts aren't copied into `io_buffer`.
+    # @param io [BasicSocket] the raw socket, see `#native_io`
+    # @param body [Array<String>]
+    # @param io_buffer [Puma::IOBuffer] contains headers
+    # @param chunked [Boolean]
+    # @raise [ConnectionError]
+    #
+    def fast_writev(io, body, io_buffer, chunked)
+      parts = [io_buffer.read_and_reset]
+      if chunked
+        body.each do |part|
+          next if (byte_size = part.bytesize).zero?
+          parts.push byte_size.to_s(16), LINE_END, part, LINE_END
+        end
+        parts << CLOSE_CHUNKED
+      else
+        parts.concat body
+      end
+      unless NativeIO.writev io, parts, WRITE_TIMEOUT
+        raise ConnectionError, SOCKET_WRITE_ERR_MSG
+      end
+    end
+
+    # @param socket [#to_io] the response socket
+    # @return [BasicSocket, nil] the socket `Puma::NativeIO` can write to,
+    #   nil when the bytes must go through `socket`
+    def native_io(socket)
+      return unless defined?(NativeIO) && NativeIO.respond_to?(:writev)
+      socket.is_a?(::BasicSocket) ? socket : ktls_io(socket)
+    end
+
+    # @return [BasicSocket, nil] the raw socket of a `MiniSSL::KTLSSocket`
+    #   when the kernel encrypts what is written to it
+    def ktls_io(socket)
+      socket.to_io if socket.respond_to?(:ktls_send?) && socket.ktls_send?
+    end
+
+    private :compress_response, :fast_write_str, :fast_write_response, :fast_write_file,
+      :file_body_range, :fast_writev, :native_io, :ktls_io
 
     # @param header_key [#to_s]
     # @return [Boolean]
@@ -425,31 +604,50 @@ module Puma
     # @param io_buffer [Puma::IOBuffer] modified inn place
     # @param force_keep_alive [Boolean] 'anded' with keep_alive, based on system
     #   status and `@max_keep_alive`
-    # @return [Hash] resp_info
+    # @param info [Info, nil] filled by `Puma::NativeHeaders` when given, it
+    #   writes the status line and headers in one pass over +headers+, with
+    #   the lines of repeated frozen headers from `@header_cache`
+    # @return [Hash, Info] resp_info
     # @version 5.0.3
     #
-    def str_headers(env, status, headers, res_body, io_buffer, force_keep_alive)
+    def str_headers(env, status, headers, res_body, io_buffer, force_keep_alive, info = nil)
 
       line_ending = LINE_END
       colon = COLON
 
+      http_11 = env[SERVER_PROTOCOL] == HTTP_11
+
+      if info
+        info.no_body = env[REQUEST_METHOD] == HEAD
+        info.keep_alive = if http_11
+          env.fetch(HTTP_CONNECTION, "").downcase != CLOSE
+        else
+          env.fetch(HTTP_CONNECTION, "").downcase == KEEP_ALIVE
+        end
+        info.keep_alive &&= @queue_requests && force_keep_alive
+
+        if NativeHeaders.write(io_buffer.string, info, status, headers, http_11, @header_cache)
+          io_buffer.seek 0, IO::SEEK_END
+          return info
+        end
+      end
+
       resp_info = {}
       resp_info[:no_body] = env[REQUEST_METHOD] == HEAD
 
-      http_11 = env[SERVER_PROTOCOL] == HTTP_11
       if http_11
         resp_info[:allow_chunked] = true
         resp_info[:keep_alive] = env.fetch(HTTP_CONNECTION, "").downcase != CLOSE
 
-        # An optimization. The most common response is 200, so we can
-        # reply with the proper 200 status without having to compute
-        # the response header.
+        # An optimization. The status lines of the known codes are built
+        # once, see STATUS_LINES_11.
         #
-        if status == 200
-          io_buffer << HTTP_11_200
+        if (line = STATUS_LINES_11[status])
+          io_buffer << line
         else
           io_buffer.append "#{HTTP_11} #{status} ", fetch_status_code(status), line_ending
-
+        end
+        if status != 200
           resp_info[:no_body] ||= status < 200 || STATUS_WITH_NO_ENTITY_BODY[status]
         end
       else
@@ -458,12 +656,13 @@ module Puma
 
         # Same optimization as above for HTTP/1.1
         #
-        if status == 200
-          io_buffer << HTTP_10_200
+        if (line = STATUS_LINES_10[status])
+          io_buffer << line
         else
           io_buffer.append "HTTP/1.0 #{status} ",
                        fetch_status_code(status), line_ending
-
+        end
+        if status != 200
           resp_info[:no_body] ||= status < 200 || STATUS_WITH_NO_ENTITY_BODY[status]
         end
       end
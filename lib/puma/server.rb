@@ -12,8 +12,11 @@ require_relative 'client'
 require_relative 'binder'
 require_relative 'util'
 require_relative 'response'
+require_relative 'compression'
+require_relative 'static_file_cache'
 require_relative 'configuration'
 require_relative 'cluster_accept_loop_delay'
+require_relative 'cluster_worker_load'
 
 require 'socket'
 require 'io/wait' unless Puma::HAS_NATIVE_IO_WAIT
@@ -47,6 +50,7 @@ module Puma
     attr_reader :events
     attr_reader :min_threads, :max_threads  # for #stats
     attr_reader :requests_count             # @version 5.0.0
+    attr_reader :direct_requests_count
 
     # @todo the following may be deprecated in the future
     attr_reader :auto_trim_time, :early_hints, :first_data_timeout,
@@ -108,10 +112,26 @@ module Puma
       @io_selector_backend       = @options[:io_selector_backend]
       @http_content_length_limit = @options[:http_content_length_limit]
       @allow_underscore_headers  = @options.fetch(:allow_underscore_headers, true)
+      @lazy_env                  = @options[:lazy_env]
+      @header_cache = if NATIVE_HEADERS && (entries = @options[:response_header_cache].to_i) > 0
+        NativeHeaders::LineCache.new entries
+      end
+      if (compression = @options[:compression])
+        @compression = Compression.new(**(compression == true ? {} : compression))
+      end
+      if (static_file_cache = @options[:static_file_cache])
+        @static_file_cache = StaticFileCache.new(**static_file_cache, compression: @compression)
+      end
+      @buffer_pool               = BufferPool.new @max_threads, CHUNK_SIZE, CHUNK_SIZE
       @cluster_accept_loop_delay = ClusterAcceptLoopDelay.new(
         workers: @options[:workers],
         max_delay: @options[:wait_for_less_busy_worker] || 0 # Real default is in Configuration::DEFAULTS, this is for unit testing
       )
+      # shared with the master and other workers, see ClusterWorkerLoad
+      if (table = @options[:worker_load]) && table.index
+        @worker_stats = table
+        @worker_load = @cluster_accept_loop_delay.on?
+      end
 
       if @options[:fiber_per_request]
         singleton_class.prepend(FiberPerRequest)
@@ -141,6 +161,7 @@ module Puma
       @precheck_closing = true
 
       @requests_count = 0
+      @direct_requests_count = 0
 
       @idle_timeout_reached = false
     end
@@ -275,6 +296,7 @@ module Puma
 
       @thread_pool.auto_reap! if options[:reaping_time]
       @thread_pool.auto_trim! if @min_threads != @max_threads && options[:auto_trim_time]
+      @thread_pool.auto_adapt! if options[:adaptive_threads]
 
       @check, @notify = Puma::Util.pipe unless @notify
 
@@ -344,7 +366,12 @@ module Puma
         sockets = [check] + @binder.ios
         pool = @thread_pool
         queue_requests = @queue_requests
+        # connections queued on a reuse_port listener can't be accepted by
+        # another process, they're always drained, see below
+        reuse_port = @binder.reuse_port?
         drain = options[:drain_on_shutdown] ? 0 : nil
+        native_accept = defined?(NativeIO) && NativeIO.respond_to?(:accept)
+        @deferred_accept_ios = @binder.ios.select { |io| @binder.defer_accept? io }
 
         addr_send_name, addr_value = case options[:remote_address]
         when :value
@@ -357,8 +384,28 @@ module Puma
           [nil, nil]
         end
 
-        while @status == :run || (drain && shutting_down?)
+        while @status == :run || (drain && shutting_down?) || (reuse_port && @status == :stop)
           begin
+            if reuse_port && @status == :stop
+              # stop queueing new connections for this process before the
+              # final drain pass, not after it, and serve the ones queued
+              reuse_port = false
+              clients = close_reuse_port_listeners.map do |sock, io|
+                client = new_client(io, sock)
+                client.send(addr_send_name, addr_value) if addr_value
+                client
+              end
+              pool.concat clients
+              sockets = [check] + @binder.ios
+              if drain
+                drain += clients.length
+              else
+                @log_writer.debug { "Drained #{clients.length} reuse_port connections." }
+                # the other listeners are left to other processes
+                next
+              end
+            end
+
             ios = IO.select sockets, nil, nil, (shutting_down? ? 0 : @idle_timeout)
             unless ios
               unless shutting_down?
@@ -391,7 +438,14 @@ module Puma
 
                 unless shutting_down?
                   if @queue_requests
-                    if @cluster_accept_loop_delay.on? && (busy_threads_plus_todo = pool.busy_threads) > 0
+                    if (worker_stats = @worker_stats)
+                      busy_threads = pool.busy_threads
+                      worker_stats.publish busy_threads, pool.backlog, @reactor.reactor_size
+                      if @worker_load && !worker_stats.least_loaded?(busy_threads)
+                        # leave it to a less busy worker, unless a thread frees up first
+                        pool.wait_for_less_busy busy_threads, @cluster_accept_loop_delay.max_delay
+                      end
+                    elsif @cluster_accept_loop_delay.on? && (busy_threads_plus_todo = pool.busy_threads) > 0
                       delay = @cluster_accept_loop_delay.calculate(
                         max_threads: @max_threads,
                         busy_threads_plus_todo: busy_threads_plus_todo
@@ -408,11 +462,16 @@ module Puma
                 rescue IO::WaitReadable
                   next
                 end
-                drain += 1 if shutting_down?
 
-                client = new_client(io, sock)
-                client.send(addr_send_name, addr_value) if addr_value
-                pool << client
+                conns = native_accept && accept_batch(sock, io, pool) || [io]
+                drain += conns.length if shutting_down?
+
+                clients = conns.map! do |conn|
+                  client = new_client(conn, sock)
+                  client.send(addr_send_name, addr_value) if addr_value
+                  client
+                end
+                pool.concat clients
               end
             end
           rescue IOError, Errno::EBADF
@@ -424,6 +483,7 @@ module Puma
         end
 
         @log_writer.debug { "Drained #{drain} additional connections." } if drain
+        @worker_stats&.clear
         @events.fire :state, @status
 
         if queue_requests
@@ -457,9 +517,47 @@ module Puma
       client.http_content_length_limit = @http_content_length_limit
       client.supported_http_methods = @supported_http_methods
       client.allow_underscore_headers = @allow_underscore_headers
+      client.lazy_env = true if @lazy_env
+      client.buffer_pool = @buffer_pool
+      # the pool thread reads the request without waiting for the reactor
+      client.accepted_with_data = true if @deferred_accept_ios.include?(sock)
       client
     end
 
+    # Accepts the connections queued on the +reuse_port+ listeners, then
+    # closes them, so the kernel queues no more for this process.
+    # @return [Array<Array(IO, IO)>] the listener and each connection
+    def close_reuse_port_listeners
+      conns = []
+      @binder.reuse_port_ios.each do |sock|
+        loop { conns << [sock, sock.accept_nonblock] }
+      rescue IO::WaitReadable, SystemCallError
+        # none left
+      end
+      @binder.close_reuse_port_listeners
+      conns
+    end
+    private :close_reuse_port_listeners
+
+    # Accepts the other connections queued on +sock+ after +io+, without
+    # waiting for `IO.select` again.  Clustered or without `queue_requests`,
+    # no more than the pool's idle threads are accepted, the rest are left to
+    # other workers or the next loop.
+    # @return [Array<IO>, nil] +io+ and the connections, nil if there are none
+    def accept_batch(sock, io, pool)
+      max = @clustered || !@queue_requests ? @max_threads - pool.busy_threads : ACCEPT_BATCH_MAX
+      max = max.clamp(1, ACCEPT_BATCH_MAX) - 1
+      return if max < 1
+
+      conns = if sock.is_a?(TCPServer) || sock.is_a?(UNIXServer)
+        NativeIO.accept sock, max
+      elsif sock.respond_to?(:accept_batch)
+        sock.accept_batch max
+      end
+      conns.unshift io unless conns.nil? || conns.empty?
+    end
+    private :accept_batch
+
     # :nodoc:
     def handle_check
       cmd = @check.sysread 1
@@ -498,6 +596,7 @@ module Puma
         if @queue_requests && !client.eagerly_finish
 
           client.set_timeout(@first_data_timeout)
+          client.used_reactor = true
           if @reactor.add client
             close_socket = false
             return false
@@ -512,6 +611,8 @@ module Puma
         while can_loop
           can_loop = false
           @requests_count += 1
+          @direct_requests_count += 1 unless client.used_reactor
+          @worker_stats&.requests_count = @requests_count
           case handle_request(processor, client, requests + 1)
           when :close
           when :async
@@ -540,6 +641,7 @@ module Puma
               end
             elsif @queue_requests
               client.set_timeout @persistent_timeout
+              client.used_reactor = true
               if @reactor.add client
                 close_socket = false
               end
@@ -691,8 +793,11 @@ module Puma
       :pool_capacity,
       :busy_threads,
       :backlog_max,
+      :gvl_wait_time,
+      :gvl_waiting,
       :max_threads,
       :requests_count,
+      :direct_requests_count,
       :reactor_max,
     ].freeze
 
@@ -704,6 +809,7 @@ module Puma
       stats = @thread_pool&.stats || {}
       stats[:max_threads]    = @max_threads
       stats[:requests_count] = @requests_count
+      stats[:direct_requests_count] = @direct_requests_count
       stats[:reactor_max] = @reactor.reactor_max if @reactor
       reset_max
       stats
@@ -0,0 +1,443 @@
+# frozen_string_literal: true
+
+require 'time'
+require_relative 'const'
+require_relative 'compression'
+
+module Puma
+  # Keeps small files sent as `to_path` response bodies in memory, like the
+  # assets of `Rack::Files` and `ActionDispatch::Static`, set with the
+  # `static_file_cache` option, used by `Puma::Response`.
+  #
+  # * A cached file is sent from a frozen String, as an Array body, written
+  #   with `Puma::NativeIO.writev` along with the headers.  It isn't opened,
+  #   stat'ed or read again while it's unchanged.
+  # * Its ETag, like nginx's, and Last-Modified headers are built once, and
+  #   added when the app didn't set them.
+  # * A GET or HEAD request for a URI that was answered with a cached file,
+  #   with an If-None-Match or If-Modified-Since header the file matches, is
+  #   answered with 304 before the app is called.  Not when either request
+  #   has credentials, or the response is private, no-store, or varies on
+  #   more than Accept-Encoding.
+  # * With `compression`, each encoding of a file is compressed once, or read
+  #   from the precompressed sibling found when the file was cached.  The
+  #   ETag of an encoded file is weak, as the bytes differ.
+  #
+  # Files are dropped when they or their siblings change, which
+  # `Puma::FileWatcher` reports on Linux, otherwise which a `File.stat` of
+  # each file at most every STAT_INTERVAL seconds finds.
+  #
+  # Private: API may change unexpectedly
+  class StaticFileCache
+    include Puma::Const
+
+    HTTP_IF_NONE_MATCH = "HTTP_IF_NONE_MATCH"
+    HTTP_IF_MODIFIED_SINCE = "HTTP_IF_MODIFIED_SINCE"
+    HTTP_AUTHORIZATION = "HTTP_AUTHORIZATION"
+    HTTP_COOKIE = "HTTP_COOKIE"
+    GET = "GET"
+    WEAK = "W/"
+
+    ETAG_S = "etag: "
+    LAST_MODIFIED_S = "last-modified: "
+
+    # the headers of a 200 a 304 repeats, besides the validators, RFC 9110 15.4.5
+    NOT_MODIFIED_HEADERS = %w[cache-control content-location expires vary].freeze
+
+    # a response the app may not send to another request for the URI
+    UNSHARED_CACHE_CONTROL = /\b(?:private|no-store)\b/i
+    ACCEPT_ENCODING = "accept-encoding"
+
+    # seconds between the checks of a file when it isn't watched
+    STAT_INTERVAL = 1.0
+
+    NOT_MODIFIED_BODY = [].freeze
+
+    # A cached file, `body` is sent as it is.
+    class Entry
+      def initialize(path, content, stat, siblings)
+        @path = path
+        @body = [content.freeze].freeze
+        @bytesize = content.bytesize
+        @mtime = stat.mtime
+        @etag = format('"%x-%x"', @mtime.to_i, @bytesize).freeze
+        @weak_etag = "#{WEAK}#{@etag}".freeze
+        @last_modified = @mtime.httpdate.freeze
+        @stats = { path => stat }
+        siblings.each_value { |fn| @stats[fn] = File.stat fn }
+        @siblings = siblings.freeze
+        @variants = {}
+        @memsize = @bytesize
+        @wds = nil
+        @checked_at = Process.clock_gettime Process::CLOCK_MONOTONIC
+      end
+
+      attr_reader :path, :body, :bytesize, :mtime, :etag, :weak_etag, :last_modified,
+        :siblings, :variants, :stats
+      attr_accessor :memsize, :wds, :checked_at
+
+      # @return [Boolean] whether the file and its siblings are as they were
+      #   when cached
+      def unchanged?
+        @stats.all? do |fn, stat|
+          now = File.stat fn
+          now.mtime == stat.mtime && now.size == stat.size && now.ino == stat.ino
+        end
+      rescue SystemCallError
+        false
+      end
+    end
+
+    # @param prefixes [Array<String>, nil] the request paths whose files are
+    #   cached, all when nil
+    # @param max_entries [Integer] the most files cached
+    # @param max_file_size [Integer] the largest file cached, in bytes, larger
+    #   ones are sent with `sendfile`
+    # @param max_bytes [Integer] the most bytes cached, with the encodings
+    # @param compression [Puma::Compression, nil]
+    def initialize(prefixes: nil, max_entries: 1_024, max_file_size: 1_024 * 256,
+        max_bytes: 1_024 * 1_024 * 64, compression: nil)
+      @prefixes = prefixes && !prefixes.empty? ? prefixes.map { |p| p.to_s.dup.freeze }.freeze : nil
+      @max_entries = Integer(max_entries)
+      @max_file_size = Integer(max_file_size)
+      @max_bytes = Integer(max_bytes)
+      @compression = compression
+      @entries = {}
+      @routes = {}
+      @watched = {}
+      @bytes = 0
+      @pid = nil
+      @watcher = nil
+      @mutex = Thread::Mutex.new
+    end
+
+    attr_reader :prefixes, :max_entries, :max_file_size, :max_bytes
+
+    # @return [Integer] the number of files cached
+    def size
+      @mutex.synchronize { @entries.size }
+    end
+
+    # @return [Integer] the bytes cached, with the encodings
+    def bytes
+      @mutex.synchronize { @bytes }
+    end
+
+    # @param env [Hash] the request
+    # @param path [String] the file of a 200 response body
+    # @return [Entry, nil] the file, cached when it isn't yet, nil when it
+    #   isn't cacheable
+    def fetch(env, path)
+      return unless cacheable_request? env
+
+      @mutex.synchronize do
+        refresh
+        if (entry = @entries[path])
+          return entry if current? entry
+        end
+      end
+      load path
+    end
+
+    # Adds the validators the app didn't set to `io_buffer`, and keeps the
+    # headers a 304 for the request's URI repeats, when another request may
+    # be answered with them.
+    # @param env [Hash] the request
+    # @param entry [Entry] from `#fetch`
+    # @param headers [Hash] the response headers from the app
+    # @param io_buffer [Puma::IOBuffer] contains headers
+    # @param encoded [Boolean] whether the body sent is one of `#variant`
+    # @param vary [Boolean] whether a vary: accept-encoding line was added
+    def write_headers(env, entry, headers, io_buffer, encoded, vary)
+      app_etag = headers['etag'] || headers['ETag']
+      app_last_modified = headers['last-modified'] || headers['Last-Modified']
+      etag = encoded ? entry.weak_etag : entry.etag
+      io_buffer.append ETAG_S, etag, LINE_END unless app_etag
+      io_buffer.append LAST_MODIFIED_S, entry.last_modified, LINE_END unless app_last_modified
+
+      method = env[REQUEST_METHOD]
+      return unless method == GET || method == HEAD
+      return if credentials? env
+
+      key = route_key env
+      route = @mutex.synchronize { @routes[key] }
+      return if route && route[0].equal?(entry)
+
+      repeated = {}
+      headers.each do |k, v|
+        k = k.downcase
+        repeated[k] = v.to_s.dup.freeze if NOT_MODIFIED_HEADERS.include? k
+      end
+      return if UNSHARED_CACHE_CONTROL.match? repeated['cache-control']
+      if repeated['vary']&.split(',')&.any? { |v| !v.strip.casecmp?(ACCEPT_ENCODING) }
+        return
+      end
+      if vary
+        repeated['vary'] = repeated['vary'] ? [repeated['vary'], ACCEPT_ENCODING].freeze : ACCEPT_ENCODING
+      end
+      last_modified = app_last_modified&.to_s&.dup&.freeze || entry.last_modified
+      repeated['last-modified'] = last_modified
+
+      route = if app_etag
+        app_etag = app_etag.to_s.dup.freeze
+        opaque = app_etag.delete_prefix WEAK
+        strong = repeated.merge('etag' => app_etag).freeze
+        # Puma::Response sends a strong ETag weak with an encoded body
+        weak = if encoded && !app_etag.start_with?(WEAK)
+          repeated.merge('etag' => "#{WEAK}#{app_etag}").freeze
+        else
+          strong
+        end
+        [entry, opaque, last_modified, strong, weak]
+      else
+        [entry, entry.etag, last_modified, repeated.merge('etag' => entry.etag).freeze,
+          repeated.merge('etag' => entry.weak_etag).freeze]
+      end
+
+      @mutex.synchronize do
+        @routes.clear if @routes.size >= @max_entries * 4
+        @routes[key] = route
+      end
+    end
+
+    # @param env [Hash] the request
+    # @return [Array, nil] a 304 response when the request's URI was answered
+    #   with a cached file, which its conditional headers match
+    def not_modified(env)
+      method = env[REQUEST_METHOD]
+      return unless method == GET || method == HEAD
+
+      if_none_match = env[HTTP_IF_NONE_MATCH]
+      if_modified_since = env[HTTP_IF_MODIFIED_SINCE] unless if_none_match
+      return unless if_none_match || if_modified_since
+      return unless cacheable_request? env
+      return if credentials? env
+
+      key = route_key env
+      route = @mutex.synchronize do
+        return if @routes.empty?
+
+        refresh
+        return unless (route = @routes[key])
+
+        entry = route[0]
+        unless @entries[entry.path].equal?(entry) && current?(entry)
+          @routes.delete key
+          return
+        end
+        route
+      end
+
+      if if_none_match
+        return unless (tag = matching_etag if_none_match, route[1])
+        [304, tag.start_with?(WEAK) ? route[4] : route[3], NOT_MODIFIED_BODY]
+      elsif not_modified_since? if_modified_since, route
+        [304, route[3], NOT_MODIFIED_BODY]
+      end
+    end
+
+    # @param entry [Entry]
+    # @param accept [String, nil] the request's Accept-Encoding header
+    # @return [Array(String, Array<String>), nil] the encoding and body to
+    #   send, from a sibling or compressed once, nil for `entry.body`
+    def variant(entry, accept)
+      encodings = entry.siblings.keys
+      encodings |= Compression.encodings if entry.bytesize >= @compression.min_size
+      return unless (encoding = @compression.negotiate accept, encodings)
+
+      if (body = @mutex.synchronize { entry.variants[encoding] })
+        return [encoding, body]
+      end
+
+      content = if (fn = entry.siblings[encoding])
+        File.binread fn
+      else
+        @compression.compress entry.body, encoding
+      end
+      body = [content.freeze].freeze
+
+      @mutex.synchronize do
+        if (kept = entry.variants[encoding])
+          body = kept
+        elsif @entries[entry.path].equal?(entry) && @bytes + content.bytesize <= @max_bytes
+          entry.variants[encoding] = body
+          entry.memsize += content.bytesize
+          @bytes += content.bytesize
+        end
+      end
+      [encoding, body]
+    rescue SystemCallError, IOError
+      nil
+    end
+
+    # Unwatches the files and empties the cache.
+    def clear
+      @mutex.synchronize do
+        @entries.keys.each { |path| drop path }
+        @routes.clear
+      end
+    end
+
+    private
+
+    def cacheable_request?(env)
+      return true unless @prefixes
+      path = env[REQUEST_PATH]
+      !!path && @prefixes.any? { |prefix| path.start_with? prefix }
+    end
+
+    # The response to a request with credentials may be for its user only.
+    def credentials?(env)
+      env.key?(HTTP_AUTHORIZATION) || env.key?(HTTP_COOKIE)
+    end
+
+    def route_key(env)
+      "#{env[HTTP_HOST]} #{env[REQUEST_URI]}"
+    end
+
+    # @return [String, nil] the entity tag of `if_none_match` that matches
+    #   `etag` with the weak comparison, RFC 9110 13.1.2
+    def matching_etag(if_none_match, etag)
+      return etag if if_none_match.strip == '*'
+
+      if_none_match.split(',').each do |tag|
+        tag = tag.strip
+        return tag if tag.delete_prefix(WEAK) == etag
+      end
+      nil
+    end
+
+    def not_modified_since?(if_modified_since, route)
+      return true if if_modified_since == route[2]
+
+      Time.httpdate(if_modified_since).to_i >= route[0].mtime.to_i
+    rescue ArgumentError
+      false
+    end
+
+    # Reads `path` when it's a small enough file, it's watched first, so a
+    # change while it's read is reported.
+    # @return [Entry, nil]
+    def load(path)
+      stat = File.stat path
+      return unless stat.file? && stat.size <= @max_file_size && stat.size <= @max_bytes
+
+      siblings = {}
+      if @compression
+        Compression::SIBLINGS.each do |encoding, ext|
+          fn = "#{path}#{ext}"
+          siblings[encoding] = fn if File.file?(fn) && File.readable?(fn)
+        end
+      end
+      wds = @mutex.synchronize { watch(path, siblings.values) }
+
+      begin
+        content = File.binread path
+        entry = Entry.new path, content, stat, siblings
+        # changed while it was read
+        entry = nil unless content.bytesize == stat.size && entry.unchanged?
+      ensure
+        @mutex.synchronize { entry ? insert(entry, wds) : unwatch(path, wds) }
+      end
+      entry
+    rescue SystemCallError, IOError
+      nil
+    end
+
+    # @return [Array<Integer>, nil] the watch descriptors of the files, nil
+    #   when they aren't watched
+    def watch(path, siblings)
+      return unless (watcher = self.watcher)
+
+      wds = []
+      [path, *siblings].each do |fn|
+        wd = watcher.watch fn
+        paths = (@watched[wd] ||= [])
+        paths << path unless paths.include? path
+        wds << wd
+      end
+      wds
+    rescue SystemCallError
+      # out of watches, max_user_watches, the files are stat'ed
+      unwatch path, wds
+      nil
+    end
+
+    def unwatch(path, wds)
+      wds&.each do |wd|
+        next unless (paths = @watched[wd])
+        paths.delete path
+        next unless paths.empty?
+        @watched.delete wd
+        @watcher.unwatch wd
+      end
+    end
+
+    def insert(entry, wds)
+      drop entry.path if @entries.key? entry.path
+      while !@entries.empty? &&
+          (@entries.size >= @max_entries || @bytes + entry.memsize > @max_bytes)
+        drop @entries.first[0]
+      end
+      entry.wds = wds
+      @entries[entry.path] = entry
+      @bytes += entry.memsize
+    end
+
+    def drop(path)
+      return unless (entry = @entries.delete path)
+
+      @bytes -= entry.memsize
+      unwatch path, entry.wds
+    end
+
+    # @return [Boolean] whether `entry` can be sent, when it isn't watched
+    #   it's checked every STAT_INTERVAL
+    def current?(entry)
+      return true if entry.wds
+
+      now = Process.clock_gettime Process::CLOCK_MONOTONIC
+      return true if now - entry.checked_at < STAT_INTERVAL
+
+      entry.checked_at = now
+      return true if entry.unchanged?
+      drop entry.path
+      false
+    end
+
+    # Drops the files that changed.
+    def refresh
+      return unless (watcher = self.watcher) && (wds = watcher.changes)
+
+      if wds.include? -1
+        # events were lost
+        @entries.keys.each { |path| drop path }
+      else
+        wds.each do |wd|
+          next unless (paths = @watched[wd])
+          paths.dup.each { |path| drop path }
+        end
+      end
+    end
+
+    # A forked process creates its own watcher, events are read by one
+    # process only.
+    # @return [Puma::FileWatcher, nil]
+    def watcher
+      return @watcher if @pid == Process.pid
+
+      @watcher&.close
+      @watcher = nil
+      @pid = Process.pid
+      @watcher = ::Puma::FileWatcher.new if defined?(::Puma::FileWatcher)
+      @entries.clear
+      @watched.clear
+      @routes.clear
+      @bytes = 0
+      @watcher
+    rescue SystemCallError
+      # out of inotify instances, max_user_instances
+      @watcher = nil
+    end
+  end
+end
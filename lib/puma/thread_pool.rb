@@ -3,6 +3,7 @@
 require 'thread'
 
 require_relative 'io_buffer'
+require_relative 'queue_delay_controller'
 require_relative 'server_plugin_control'
 
 module Puma
@@ -20,7 +21,16 @@ module Puma
   # a thread pool via the `Puma::ThreadPool#<<` operator where it is stored in a `@todo` array.
   #
   # Each thread in the pool has an internal loop where it pulls a request from the `@todo` array
-  # and processes it.
+  # and processes it.  While `@todo` has work, threads take it without `@mutex`, the mutex and
+  # condition variables are only used when a thread waits for work, and when work is added.
+  # The `busy_threads`, `backlog` and `pool_capacity` counters are read without the mutex.
+  #
+  # With the `adaptive_threads` option, each request is queued with the time it was
+  # added, and a `Puma::QueueDelayController` moves `max` between `min` and the
+  # configured maximum, see `#adapt`.
+  #
+  # Where `Puma::GVLMeter` is available, the pool's threads are tracked by one, and
+  # `#stats` reports how long they waited for the GVL.
   class ThreadPool
     class ForceShutdown < RuntimeError
     end
@@ -97,7 +107,7 @@ module Puma
 
       @name = name
       @min = Integer(options[:min_threads])
-      @max = Integer(options[:max_threads])
+      @max = @max_limit = Integer(options[:max_threads])
       @max_io_threads = Integer(options[:max_io_threads] || 0)
 
       # Not an 'exposed' option, options[:pool_shutdown_grace_time] is used in CI
@@ -117,12 +127,24 @@ module Puma
       @shutdown = false
 
       @trim_requested = 0
+      @shrink_requested = 0
       @out_of_band_pending = false
 
       @processors = []
 
       @auto_trim = nil
       @reaper = nil
+      @adapter = nil
+
+      if defined?(GVLMeter)
+        @gvl_meter = GVLMeter.new
+        @gvl_stats_at = Process.clock_gettime Process::CLOCK_MONOTONIC
+        @gvl_stats_wait_time = 0.0
+      end
+
+      @queue_delay = if options[:adaptive_threads] && @gvl_meter
+        QueueDelayController.new Float(options[:adaptive_threads]), @gvl_meter
+      end
 
       @mutex.synchronize do
         @min.times do
@@ -135,10 +157,20 @@ module Puma
       @shutdown_mutex = Mutex.new
     end
 
-    attr_reader :spawned, :trim_requested, :waiting
-    attr_accessor :min, :max
+    attr_reader :spawned, :trim_requested, :waiting, :max, :queue_delay, :gvl_meter
+    attr_accessor :min
+
+    # Sets the maximum threads, and the limit of `#adapt`.
+    def max=(max)
+      @max = @max_limit = max
+    end
 
     # generate stats hash so as not to perform multiple locks
+    #
+    # `gvl_wait_time` is the seconds the threads have waited for the GVL in
+    # total, `gvl_waiting` the average number of threads waiting for it since
+    # the previous call, both 0 without `Puma::GVLMeter`.
+    #
     # @return [Hash] hash containing stat info from ThreadPool
     def stats
       with_mutex do
@@ -149,7 +181,8 @@ module Puma
           pool_capacity: pool_capacity,
           busy_threads: @spawned - @waiting + @todo.size,
           io_threads: @processors.count(&:marked_as_io_thread?),
-          backlog_max: temp
+          backlog_max: temp,
+          **gvl_stats
         }
       end
     end
@@ -161,13 +194,13 @@ module Puma
     # How many objects have yet to be processed by the pool?
     #
     def backlog
-      with_mutex { @todo.size }
+      @todo.size
     end
 
     # The maximum size of the backlog
     #
     def backlog_max
-      with_mutex { @backlog_max }
+      @backlog_max
     end
 
     # @!attribute [r] pool_capacity
@@ -178,7 +211,7 @@ module Puma
     # @!attribute [r] busy_threads
     # @version 5.0.0
     def busy_threads
-      with_mutex { @spawned - @waiting + @todo.size }
+      @spawned - @waiting + @todo.size
     end
 
     # :nodoc:
@@ -200,27 +233,41 @@ module Puma
         mutex = @mutex
         not_empty = @not_empty
         not_full = @not_full
+        queue_delay = @queue_delay
+
+        @gvl_meter&.track_current_thread
 
         while true
           work = nil
+          got_work = false
+
+          # fast path, with work queued there's nothing to wait for
+          if !todo.empty? && !processor.marked_as_io_thread? && @shrink_requested == 0
+            begin
+              work = todo.pop true
+              got_work = true
+            rescue ThreadError # another thread took it
+            end
+          end
 
-          mutex.synchronize do
-            if processor.marked_as_io_thread?
-              if @processors.count { |t| !t.marked_as_io_thread? } < @max
-                # We're not at max processor threads, so the io thread can rejoin the normal population.
-                processor.marked_as_io_thread = false
-              else
-                # We're already at max threads, so we exit the extra io thread.
-                @spawned -= 1
-                @processors.delete(processor)
-                trigger_before_thread_exit_hooks
-                Thread.exit
+          unless got_work
+            mutex.synchronize do
+              if processor.marked_as_io_thread?
+                if @processors.count { |t| !t.marked_as_io_thread? } < @max
+                  # We're not at max processor threads, so the io thread can rejoin the normal population.
+                  processor.marked_as_io_thread = false
+                else
+                  # We're already at max threads, so we exit the extra io thread.
+                  @spawned -= 1
+                  @processors.delete(processor)
+                  trigger_before_thread_exit_hooks
+                  Thread.exit
+                end
               end
-            end
 
-            while todo.empty?
-              if @trim_requested > 0
-                @trim_requested -= 1
+              # `#adapt` lowered max, stop even if there's work
+              if @shrink_requested > 0
+                @shrink_requested -= 1
                 @spawned -= 1
                 @processors.delete(processor)
                 not_full.signal
@@ -228,19 +275,41 @@ module Puma
                 Thread.exit
               end
 
-              @waiting += 1
-              if @out_of_band_pending && trigger_out_of_band_hook
-                @out_of_band_pending = false
-              end
-              not_full.signal
-              begin
-                not_empty.wait mutex
-              ensure
-                @waiting -= 1
+              while true
+                unless todo.empty?
+                  begin
+                    work = todo.pop true
+                    break
+                  rescue ThreadError # taken by a thread on the fast path
+                  end
+                end
+
+                if @trim_requested > 0
+                  @trim_requested -= 1
+                  @spawned -= 1
+                  @processors.delete(processor)
+                  not_full.signal
+                  trigger_before_thread_exit_hooks
+                  Thread.exit
+                end
+
+                @waiting += 1
+                if @out_of_band_pending && trigger_out_of_band_hook
+                  @out_of_band_pending = false
+                end
+                not_full.signal
+                begin
+                  not_empty.wait mutex
+                ensure
+                  @waiting -= 1
+                end
               end
             end
+          end
 
-            work = todo.shift
+          if queue_delay
+            work, queued_at = work
+            started_at = Process.clock_gettime Process::CLOCK_MONOTONIC
           end
 
           begin
@@ -248,6 +317,10 @@ module Puma
           rescue Exception => e
             STDERR.puts "Error reached top of thread-pool: #{e.message} (#{e.class})"
           end
+
+          if queue_delay
+            queue_delay.record started_at - queued_at, Process.clock_gettime(Process::CLOCK_MONOTONIC) - started_at
+          end
         end
       end
 
@@ -316,6 +389,8 @@ module Puma
     end
 
     def wait_until_not_full
+      return if @shutdown || busy_threads < @max
+
       with_mutex do
         while true
           return if @shutdown
@@ -326,6 +401,16 @@ module Puma
       end
     end
 
+    # Waits up to +timeout+ seconds for a thread to finish its work, unless
+    # fewer than +busy+ threads are busy already.
+    def wait_for_less_busy(busy, timeout)
+      with_mutex do
+        return if @shutdown || (@spawned - @waiting + @todo.size) < busy
+
+        @not_full.wait @mutex, timeout
+      end
+    end
+
     # @version 5.0.0
     def with_mutex(&block)
       @mutex.owned? ?
@@ -350,7 +435,7 @@ module Puma
           raise "Unable to add work while shutting down"
         end
 
-        @todo << work
+        @todo << (@queue_delay ? [work, Process.clock_gettime(Process::CLOCK_MONOTONIC)] : work)
         t = @todo.size
         @backlog_max = t if t > @backlog_max
 
@@ -363,6 +448,33 @@ module Puma
       self
     end
 
+    # Add each of +works+ to the todo list, with one lock of the mutex.
+    def concat(works)
+      with_mutex do
+        if @shutdown
+          raise "Unable to add work while shutting down"
+        end
+
+        if @queue_delay
+          queued_at = Process.clock_gettime Process::CLOCK_MONOTONIC
+          works.each { |work| @todo << [work, queued_at] }
+        else
+          works.each { |work| @todo << work }
+        end
+        t = @todo.size
+        @backlog_max = t if t > @backlog_max
+
+        # as many threads as pushing each work with #<< would spawn
+        works.length.times do
+          break unless @waiting < @todo.size and can_spawn_processor?
+          spawn_thread
+        end
+
+        works.length.times { @not_empty.signal }
+      end
+      self
+    end
+
     def spawn_thread_if_needed # :nodoc:
       with_mutex do
         if @waiting < @todo.size and can_spawn_processor?
@@ -378,7 +490,7 @@ module Puma
     def trim(force=false)
       with_mutex do
         free = @waiting - @todo.size
-        if (force or free > 0) and @spawned - @trim_requested > @min
+        if (force or free > 0) and @spawned - @trim_requested - @shrink_requested > @min
           @trim_requested += 1
           @not_empty.signal
         end
@@ -398,6 +510,29 @@ module Puma
       end
     end
 
+    # Sets `max` from the queue delays and GVL waits since the last call, see
+    # `Puma::QueueDelayController`.  When it's lowered, threads over it stop
+    # after their current request, when it's raised, threads are added for the
+    # queued requests.
+    def adapt
+      with_mutex do
+        return if @shutdown
+
+        running = @spawned - @shrink_requested - @processors.count(&:marked_as_io_thread?)
+        max = @queue_delay.adapt @max, running, [@min, 1].max, @max_limit
+        if max < @max
+          @shrink_requested += (running - max).clamp(0, @max - max)
+        elsif max > @max
+          @shrink_requested = 0
+        end
+        @max = max
+
+        while @waiting < @todo.size and can_spawn_processor?
+          spawn_thread
+        end
+      end
+    end
+
     class Automaton
       def initialize(pool, timeout, thread_name, message)
         @pool = pool
@@ -435,6 +570,15 @@ module Puma
       @reaper.start!
     end
 
+    # Starts `#adapt`, if the `adaptive_threads` option is set and
+    # `Puma::QueueDelayController` is available.
+    def auto_adapt!(timeout=QueueDelayController::INTERVAL)
+      return unless @queue_delay
+
+      @adapter = Automaton.new(self, timeout, "#{@name} tp adapt", :adapt)
+      @adapter.start!
+    end
+
     # Allows ThreadPool::ForceShutdown to be raised within the
     # provided block if the thread is forced to shutdown during execution.
     def with_force_shutdown
@@ -462,6 +606,7 @@ module Puma
 
         @auto_trim&.stop
         @reaper&.stop
+        @adapter&.stop
         # dup processors so that we join them all safely
         @processors.dup
       end
@@ -511,6 +656,18 @@ module Puma
 
     private
 
+    # Must be called with @mutex held!
+    def gvl_stats
+      return { gvl_wait_time: 0.0, gvl_waiting: 0.0 } unless @gvl_meter
+
+      now = Process.clock_gettime Process::CLOCK_MONOTONIC
+      wait_time = @gvl_meter.wait_time
+      waiting = (wait_time - @gvl_stats_wait_time) / (now - @gvl_stats_at)
+      @gvl_stats_at, @gvl_stats_wait_time = now, wait_time
+
+      { gvl_wait_time: wait_time.round(3), gvl_waiting: waiting.round(3) }
+    end
+
     def shutdown_debug(message)
       pid = Process.pid
       threads = Thread.list
@@ -0,0 +1,127 @@
+# frozen_string_literal: true
+
+module Puma
+
+  #———————————————————————— DO NOT USE — this class is for internal use only ———
+
+
+  # The timeouts of the clients in `Puma::Reactor`, a binary min-heap ordered
+  # by `timeout_at`.  Adding a client is O(log n), and deleting one is O(1),
+  # its heap entry is only marked stale and skipped when it reaches the top.
+  # The heap is rebuilt when more than half of it is stale.
+  #
+  # A client's `timeout_at` may be moved later while it's in the heap, its
+  # entry is then pushed down again when it reaches the top.  Only the reactor
+  # thread uses it.
+  #
+  class TimeoutHeap # :nodoc:
+
+    def initialize
+      @heap = []
+      # the current entry of each client, `[timeout_at, client]`
+      @entries = {}.compare_by_identity
+    end
+
+    # @return [Integer] the number of clients
+    def size
+      @entries.size
+    end
+
+    def empty?
+      @entries.empty?
+    end
+
+    def include?(client)
+      @entries.key? client
+    end
+
+    # @param client [#timeout_at] a client not in the heap
+    def add(client)
+      push(@entries[client] = [client.timeout_at, client])
+      compact if @heap.length > 2 * @entries.size + 64
+    end
+
+    # @return [#timeout_at, nil] the deleted client
+    def delete(client)
+      @entries.delete(client) && client
+    end
+
+    # @return [Float, nil] the earliest `timeout_at`
+    def next_timeout_at
+      drop_stale
+      @heap.first&.first
+    end
+
+    # Deletes the clients with a `timeout_at` before or at `now`.
+    # @param now [Float] the monotonic clock time
+    # @return [Array] the deleted clients
+    def pop_expired(now)
+      expired = []
+      while drop_stale && (entry = @heap.first)[0] <= now
+        pop
+        client = entry[1]
+        if (timeout_at = client.timeout_at) > now
+          # the timeout was moved later
+          push(@entries[client] = [timeout_at, client])
+        else
+          @entries.delete client
+          expired << client
+        end
+      end
+      expired
+    end
+
+    # Yields every client, in no particular order.
+    def each(&block)
+      @entries.each_key(&block)
+    end
+
+    private
+
+    # Pops stale entries from the top.
+    # @return [Boolean] false when the heap is empty
+    def drop_stale
+      while (entry = @heap.first)
+        return true if @entries[entry[1]].equal?(entry)
+        pop
+      end
+      false
+    end
+
+    # Removes the stale entries, a sorted Array is a valid heap.
+    def compact
+      @heap = @entries.values.sort_by!(&:first)
+    end
+
+    def push(entry)
+      heap = @heap
+      i = heap.length
+      at = entry[0]
+      while i > 0
+        parent = (i - 1) >> 1
+        break if heap[parent][0] <= at
+        heap[i] = heap[parent]
+        i = parent
+      end
+      heap[i] = entry
+    end
+
+    def pop
+      heap = @heap
+      last = heap.pop
+      return if heap.empty?
+
+      len = heap.length
+      at = last[0]
+      i = 0
+      while (child = 2 * i + 1) < len
+        right = child + 1
+        child = right if right < len && heap[right][0] < heap[child][0]
+        break if at <= heap[child][0]
+        heap[i] = heap[child]
+        i = child
+      end
+      heap[i] = last
+    end
+  end
+end
@@ -244,6 +244,112 @@ class TestBinderParallel < TestBinderBase
     refute socket.getsockopt(Socket::IPPROTO_TCP, Socket::TCP_NODELAY).bool
   end
 
+  def test_binder_tcp_parses_reuse_port
+    skip_if :jruby
+    skip "SO_REUSEPORT not supported" unless defined?(Socket::SO_REUSEPORT)
+    @binder.parse ["tcp://127.0.0.1:0?reuse_port=true"], @log_writer
+
+    socket = @binder.listeners.first.last
+
+    assert socket.getsockopt(Socket::SOL_SOCKET, Socket::SO_REUSEPORT).bool
+    assert @binder.reuse_port?
+  end
+
+  def test_binder_tcp_reuse_port_off_by_default
+    skip_if :jruby
+    skip "SO_REUSEPORT not supported" unless defined?(Socket::SO_REUSEPORT)
+    @binder.parse ["tcp://127.0.0.1:0"], @log_writer
+
+    socket = @binder.listeners.first.last
+
+    refute socket.getsockopt(Socket::SOL_SOCKET, Socket::SO_REUSEPORT).bool
+    refute @binder.reuse_port?
+  end
+
+  def test_binder_reuse_port_shares_the_port
+    skip_if :jruby
+    skip "SO_REUSEPORT not supported" unless defined?(Socket::SO_REUSEPORT)
+    @binder.parse ["tcp://127.0.0.1:0?reuse_port=true"], @log_writer
+    port = @binder.connected_ports.first
+
+    other = Puma::Binder.new @log_writer, @config.options
+    other.parse ["tcp://127.0.0.1:#{port}?reuse_port=true"], @log_writer
+
+    assert_equal [port], other.connected_ports
+  ensure
+    other&.close
+  end
+
+  def test_binder_reopen_reuse_port_listeners
+    skip_if :jruby
+    skip "SO_REUSEPORT not supported" unless defined?(Socket::SO_REUSEPORT)
+    @binder.parse ["tcp://127.0.0.1:0?reuse_port=true", "tcp://127.0.0.1:0"], @log_writer
+    reuse_io, shared_io = @binder.ios
+    port = reuse_io.addr[1]
+
+    @binder.reopen_reuse_port_listeners
+
+    assert reuse_io.closed?
+    refute shared_io.closed?
+    assert_equal 2, @binder.ios.length
+    assert_equal 2, @binder.listeners.length
+    new_io = @binder.ios.last
+    refute_same reuse_io, new_io
+    assert_equal port, new_io.addr[1]
+    assert new_io.getsockopt(Socket::SOL_SOCKET, Socket::SO_REUSEPORT).bool
+    assert_equal [new_io], @binder.reuse_port_ios
+
+    @binder.close_reuse_port_listeners
+
+    assert new_io.closed?
+    assert_empty @binder.reuse_port_ios
+    assert_equal [shared_io], @binder.ios
+    assert_equal [shared_io], @binder.listeners.map(&:last)
+  end
+
+  def test_binder_tcp_parses_defer_accept_and_fastopen
+    skip_if :jruby
+    skip "TCP_DEFER_ACCEPT not supported" unless defined?(Socket::TCP_DEFER_ACCEPT) && defined?(Socket::TCP_FASTOPEN)
+    @binder.parse ["tcp://127.0.0.1:0?defer_accept=true&fastopen=16", "tcp://127.0.0.1:0"], @log_writer
+    deferred, plain = @binder.ios
+
+    assert_operator deferred.getsockopt(Socket::IPPROTO_TCP, Socket::TCP_DEFER_ACCEPT).int, :>, 0
+    assert_equal 16, deferred.getsockopt(Socket::IPPROTO_TCP, Socket::TCP_FASTOPEN).int
+    assert @binder.defer_accept?(deferred)
+
+    assert_equal 0, plain.getsockopt(Socket::IPPROTO_TCP, Socket::TCP_FASTOPEN).int
+    refute @binder.defer_accept?(plain)
+  end
+
+  def test_binder_reopen_reuse_port_listeners_keeps_defer_accept
+    skip_if :jruby
+    skip "SO_REUSEPORT not supported" unless defined?(Socket::SO_REUSEPORT)
+    skip "TCP_DEFER_ACCEPT not supported" unless defined?(Socket::TCP_DEFER_ACCEPT)
+    @binder.parse ["tcp://127.0.0.1:0?reuse_port=true&defer_accept=5"], @log_writer
+
+    @binder.reopen_reuse_port_listeners
+
+    assert @binder.defer_accept?(@binder.ios.first)
+  end
+
+  def test_binder_ssl_reopen_reuse_port_listeners
+    skip_unless :ssl
+    skip_if :jruby
+    skip "SO_REUSEPORT not supported" unless defined?(Socket::SO_REUSEPORT)
+    @binder.parse ["ssl://127.0.0.1:0?#{ssl_query}&reuse_port=true"], @log_writer
+    ssl = @binder.ios.first
+    ctx = ssl_context_for_binder
+
+    @binder.reopen_reuse_port_listeners
+
+    assert ssl.closed?
+    new_ssl = @binder.ios.first
+    assert_kind_of Puma::MiniSSL::Server, new_ssl
+    assert_same ctx, ssl_context_for_binder
+    assert_equal "https", @binder.env(new_ssl)["HTTPS"]
+    assert new_ssl.to_io.getsockopt(Socket::SOL_SOCKET, Socket::SO_REUSEPORT).bool
+  end
+
   def test_binder_ssl_defaults_to_true_low_latency
     skip_unless :ssl
     skip_if :jruby
@@ -0,0 +1,95 @@
+# frozen_string_literal: true
+
+require_relative "helper"
+
+require "puma/client"
+
+class TestBufferPool < PumaTest
+  parallelize_me!
+
+  def setup
+    @pool = Puma::BufferPool.new 2, 1024, 4096
+  end
+
+  def test_take_from_empty_pool
+    buffer = @pool.take
+
+    assert_equal Encoding::BINARY, buffer.encoding
+    refute buffer.frozen?
+    refute_same buffer, @pool.take
+  end
+
+  def test_put_and_take
+    buffer = @pool.take
+    @pool.put buffer
+
+    assert_equal 1, @pool.size
+    assert_same buffer, @pool.take
+    assert_equal 0, @pool.size
+  end
+
+  def test_size_is_limited
+    buffers = Array.new(3) { @pool.take }
+    buffers.each { |b| @pool.put b }
+
+    assert_equal 2, @pool.size
+  end
+
+  def test_large_buffers_are_dropped
+    @pool.put(@pool.take << "a" * 5000)
+
+    assert_equal 0, @pool.size
+  end
+
+  def test_client_reads_into_pooled_buffer
+    skip_unless :unix
+    rd, wr = UNIXSocket.pair
+    client = Puma::Client.new rd, {}
+    client.buffer_pool = @pool
+    client.supported_http_methods = :any
+    buffer = @pool.take
+    @pool.put buffer
+
+    wr.write "GET /a HTTP/1.1\r\nHost: a.com\r\n\r\n"
+    assert client.try_to_finish
+    assert_same buffer, client.instance_variable_get(:@pooled_buffer)
+    assert_equal 0, @pool.size
+
+    client.reset
+    assert_equal 1, @pool.size
+
+    wr.write "GET /b HTTP/1.1\r\nHost: b.com\r\n\r\n"
+    env = client.env
+    assert client.try_to_finish
+    assert_same buffer, client.instance_variable_get(:@pooled_buffer)
+    assert_equal "/b", env["REQUEST_PATH"]
+    assert_equal "b.com", env["HTTP_HOST"]
+
+    client.close
+    assert_equal 1, @pool.size
+  ensure
+    wr&.close
+    rd&.close
+  end
+
+  def test_client_waiting_for_data_releases_buffer
+    skip_unless :unix
+    rd, wr = UNIXSocket.pair
+    client = Puma::Client.new rd, {}
+    client.buffer_pool = @pool
+    client.supported_http_methods = :any
+    @pool.put @pool.take
+
+    refute client.try_to_finish
+    assert_nil client.instance_variable_get(:@pooled_buffer)
+    assert_equal 1, @pool.size
+
+    wr.write "GET /a HTTP/1.1\r\nHost: a.com\r\n\r\n"
+    assert client.try_to_finish
+    assert_equal 0, @pool.size
+  ensure
+    client&.close
+    wr&.close
+    rd&.close
+  end
+end
@@ -0,0 +1,129 @@
+# frozen_string_literal: true
+
+require_relative "helper"
+
+require "puma/puma_http11"
+require "puma/client"
+
+class TestChunkedDecoder < PumaTest
+  parallelize_me!
+
+  BODY = "5\r\nHello\r\n6;name=value\r\n World\r\n0\r\n\r\n"
+
+  def setup
+    skip_if :jruby
+    @decoder = Puma::ChunkedDecoder.new Puma::Client::MAX_CHUNK_HEADER_SIZE,
+      Puma::Client::MAX_CHUNK_EXCESS
+  end
+
+  def decode(data)
+    out = String.new
+    [@decoder.decode(data, out), out]
+  end
+
+  def test_decode
+    assert_equal [BODY.bytesize, "Hello World"], decode(BODY)
+    assert @decoder.finished?
+  end
+
+  def test_decode_returns_bytes_used
+    used, out = decode "#{BODY}GET / HTTP/1.1\r\n"
+
+    assert_equal BODY.bytesize, used
+    assert_equal "Hello World", out
+  end
+
+  def test_decode_split_at_every_byte
+    (1...BODY.bytesize).each do |i|
+      @decoder.reset
+      used1, out1 = decode BODY.byteslice(0, i)
+      used2, out2 = decode BODY.byteslice(i..-1)
+
+      assert_nil used1, "split at #{i}"
+      assert_equal BODY.bytesize - i, used2, "split at #{i}"
+      assert_equal "Hello World", out1 + out2, "split at #{i}"
+    end
+  end
+
+  def test_decode_byte_by_byte
+    out = String.new
+    used = nil
+    BODY.each_char { |c| used = @decoder.decode(c, out) }
+
+    assert_equal 1, used
+    assert_equal "Hello World", out
+  end
+
+  def test_trailers_are_skipped
+    body = "3\r\nabc\r\n0\r\nX-Checksum: 1\r\nX-Other: 2\r\n\r\n"
+
+    assert_equal [body.bytesize, "abc"], decode(body)
+  end
+
+  def test_size_whitespace_and_case
+    assert_equal [nil, "abcdefghij"], decode("  A \r\nabcdefghij\r\n")
+    assert_equal [nil, "0123456789ABCDEF"], decode("0010;x\r\n0123456789ABCDEF\r\n")
+  end
+
+  def test_invalid_size
+    ["5.01", "+5", "5 bad", "0xA", "5 ;ext", "g"].each do |size|
+      @decoder.reset
+      e = assert_raises(Puma::HttpParserError) { decode "#{size}\r\nHello\r\n0\r\n\r\n" }
+      assert_equal "Invalid chunk size: '#{size.sub(/ ;ext\z/, ' ')}'", e.message
+    end
+  end
+
+  def test_empty_size
+    ["\r\n\r\n", ";ext\r\n"].each do |body|
+      @decoder.reset
+      e = assert_raises(Puma::HttpParserError) { decode body }
+      assert_equal "Chunk size cannot be empty or nil", e.message
+    end
+  end
+
+  def test_size_too_large
+    e = assert_raises(Puma::HttpParserError) { decode "1#{'0' * 15}\r\n" }
+    assert_start_with e.message, "Invalid chunk size"
+
+    @decoder.reset
+    assert_nil decode("#{'0' * 20}F\r\n").first
+  end
+
+  def test_size_mismatch
+    e = assert_raises(Puma::HttpParserError) { decode "4\r\nWorld\r\n" }
+    assert_equal "Chunk size mismatch", e.message
+
+    @decoder.reset
+    decode "6\r\nWorld"
+    e = assert_raises(Puma::HttpParserError) { decode "\r\n0\r\n\r\n" }
+    assert_equal "Chunk size mismatch", e.message
+  end
+
+  def test_chunk_header_size
+    decode "1;"
+    e = assert_raises(Puma::HttpParserError) do
+      decode "x" * Puma::Client::MAX_CHUNK_HEADER_SIZE
+    end
+    assert_equal "maximum size of chunk header exceeded", e.message
+  end
+
+  def test_chunk_excess
+    chunk = "1;#{'x' * 1000}\r\na\r\n"
+    e = assert_raises(Puma::HttpParserError) do
+      decode chunk * (Puma::Client::MAX_CHUNK_EXCESS / 1000 + 1)
+    end
+    assert_equal "Maximum chunk excess detected", e.message
+
+    # body bytes offset the extension bytes
+    @decoder.reset
+    chunk = "#{1000.to_s 16};#{'x' * 1000}\r\n#{'a' * 1000}\r\n"
+    assert_nil decode(chunk * 20).first
+  end
+
+  def test_reset
+    decode "5\r\nHel"
+    @decoder.reset
+
+    assert_equal [BODY.bytesize, "Hello World"], decode(BODY)
+  end
+end
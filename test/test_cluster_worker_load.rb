@@ -0,0 +1,142 @@
+# frozen_string_literal: true
+
+require_relative "helper"
+
+require "puma/puma_http11"
+require "puma/cluster_worker_load"
+
+class TestClusterWorkerLoad < PumaTest
+  parallelize_me!
+
+  def setup
+    skip "Puma::SharedTable needs mmap" unless Puma::ClusterWorkerLoad.available?
+    @load = Puma::ClusterWorkerLoad.new 4
+  end
+
+  def test_rows_start_cleared
+    assert_equal 4, @load.rows
+    4.times { |i| assert_nil @load[i] }
+
+    @load.index = 0
+    assert @load.least_loaded?(100)
+  end
+
+  def test_publish
+    @load.index = 2
+    @load.publish 3, 1, 7
+
+    assert_equal({ busy_threads: 3, backlog: 1, reactor_size: 7 }, @load[2])
+  end
+
+  def test_publish_stats
+    stats = { backlog: 1, running: 2, pool_capacity: 3, busy_threads: 4, io_threads: 0,
+      backlog_max: 5, gvl_wait_time: 12.345, gvl_waiting: 0.5, max_threads: 5, requests_count: 10,
+      direct_requests_count: 8, reactor_max: 6 }
+    @load.index = 1
+    @load.publish_stats stats
+
+    assert_equal stats, @load.stats(1, Process.pid)
+    assert_nil @load.stats(1, Process.pid + 1)
+    assert_nil @load.stats(2, Process.pid)
+    assert_nil @load.stats(4, Process.pid)
+
+    @load.publish 2, 0, 0
+    @load.requests_count = 11
+    assert_equal stats.merge(backlog: 0, busy_threads: 2, requests_count: 11),
+      @load.stats(1, Process.pid)
+  end
+
+  def test_publish_stats_keeps_max_until_reset
+    @load.index = 0
+    @load.publish_stats backlog_max: 5, reactor_max: 2
+    @load.publish_stats backlog_max: 1, reactor_max: 3
+
+    stats = @load.stats 0, Process.pid
+    assert_equal [5, 3], stats.values_at(:backlog_max, :reactor_max)
+
+    @load.reset_max 0
+    stats = @load.stats 0, Process.pid
+    assert_equal [0, 0], stats.values_at(:backlog_max, :reactor_max)
+  end
+
+  def test_least_loaded_within_margin
+    @load.index = 1
+    @load.publish 0, 0, 0
+    @load.index = 0
+
+    assert @load.least_loaded?(0)
+    assert @load.least_loaded?(Puma::ClusterWorkerLoad::MARGIN)
+    refute @load.least_loaded?(Puma::ClusterWorkerLoad::MARGIN + 1)
+
+    @load.clear 1
+    assert @load.least_loaded?(Puma::ClusterWorkerLoad::MARGIN + 1)
+  end
+
+  def test_index_outside_table
+    @load.index = 4
+    assert_nil @load.index
+    @load.clear 4
+  end
+
+  def test_shared_with_forked_workers
+    skip_unless :fork
+    @load.index = 0
+    @load.publish 5, 0, 0
+
+    pid = fork do
+      @load.index = 1
+      @load.publish 1, 2, 3
+      exit! 0
+    end
+    Process.wait pid
+
+    assert_equal({ busy_threads: 1, backlog: 2, reactor_size: 3 }, @load[1])
+    refute @load.least_loaded?(5)
+
+    pid = fork do
+      @load.index = 2
+      @load.publish_stats requests_count: 7
+      exit! 0
+    end
+    Process.wait pid
+
+    assert_equal 7, @load.stats(2, pid)[:requests_count]
+  end
+end
+
+class TestSharedTable < PumaTest
+  parallelize_me!
+
+  def setup
+    skip "Puma::SharedTable needs mmap" unless defined?(Puma::SharedTable)
+    @table = Puma::SharedTable.new 3, 2
+  end
+
+  def test_cells
+    assert_equal [3, 2], [@table.rows, @table.cols]
+    assert_equal [0, 0], @table.row(2)
+
+    @table[2, 1] = -(2**40)
+    @table.store 0, [1, 2]
+    assert_equal(-(2**40), @table[2, 1])
+    assert_equal [1, 2], @table.row(0)
+  end
+
+  def test_bounds
+    assert_raises(IndexError) { @table[3, 0] }
+    assert_raises(IndexError) { @table[0, -1] = 1 }
+    assert_raises(IndexError) { @table.store 0, [1, 2, 3] }
+    assert_raises(ArgumentError) { Puma::SharedTable.new 0, 1 }
+  end
+
+  def test_min_skips_negative_values_and_row
+    @table[0, 1] = 4
+    @table[1, 1] = -1
+    @table[2, 1] = 6
+
+    assert_equal 4, @table.min(1)
+    assert_equal 6, @table.min(1, 0)
+    @table[2, 1] = -1
+    assert_nil @table.min(1, 0)
+  end
+end
@@ -0,0 +1,97 @@
+# frozen_string_literal: true
+
+require_relative "helper"
+
+require "puma/compression"
+require "puma/puma_http11"
+require "tmpdir"
+require "zlib"
+
+class TestCompression < PumaTest
+  parallelize_me!
+
+  def setup
+    @compression = Puma::Compression.new
+  end
+
+  def test_negotiate
+    encodings = %w[zstd gzip]
+
+    assert_equal "zstd", @compression.negotiate("gzip, deflate, br, zstd", encodings)
+    assert_equal "gzip", @compression.negotiate("gzip, deflate, br", encodings)
+    assert_equal "gzip", @compression.negotiate("zstd;q=0.5, GZIP", encodings)
+    assert_equal "gzip", @compression.negotiate("zstd;q=0, *", encodings)
+    assert_equal "zstd", @compression.negotiate("*;q=0.1", encodings)
+    assert_nil @compression.negotiate("br, identity", encodings)
+    assert_nil @compression.negotiate("gzip;q=0", encodings)
+    assert_nil @compression.negotiate("", encodings)
+    assert_nil @compression.negotiate(nil, encodings)
+  end
+
+  def test_compressible
+    assert @compression.compressible?("content-type" => "text/html; charset=utf-8")
+    assert @compression.compressible?("Content-Type" => "application/json")
+    refute @compression.compressible?("content-type" => "image/png")
+    refute @compression.compressible?({})
+    refute @compression.compressible?("content-type" => "text/css", "content-encoding" => "br")
+    refute @compression.compressible?("content-type" => "text/css", "cache-control" => "public, no-transform")
+
+    json_only = Puma::Compression.new types: %w[application/json]
+    refute json_only.compressible?("content-type" => "text/html")
+  end
+
+  def test_sibling
+    Dir.mktmpdir do |dir|
+      path = File.join dir, "app.js"
+      File.write path, "js"
+      File.write "#{path}.gz", "gz"
+      File.write "#{path}.br", "br"
+
+      assert_equal ["br", "#{path}.br"], @compression.sibling(path, "gzip, br")
+      assert_equal ["gzip", "#{path}.gz"], @compression.sibling(path, "gzip, zstd")
+      assert_nil @compression.sibling(path, "zstd")
+      assert_nil @compression.sibling(path, nil)
+    end
+  end
+
+  def test_compress
+    skip "Puma::Compressor isn't available" unless defined?(Puma::Compressor)
+    out = @compression.compress ["a" * 2_000, "", "b" * 2_000], "gzip"
+    assert_equal "a" * 2_000 + "b" * 2_000, Zlib.gunzip(out)
+  end
+
+  def test_body
+    skip "Puma::Compressor isn't available" unless defined?(Puma::Compressor)
+    inner = ["one", nil, "two"].each
+    closed = false
+    inner.define_singleton_method(:close) { closed = true }
+
+    body = Puma::Compression::Body.new inner, Puma::Compressor.new("gzip"), true
+    parts = []
+    body.each { |part| parts << part }
+    body.close
+
+    # each part is flushed, and the end of the stream follows
+    assert_equal 3, parts.length
+    assert_equal "onetwo", Zlib.gunzip(parts.join)
+    assert closed
+  end
+
+  def test_body_of_file
+    skip "Puma::Compressor isn't available" unless defined?(Puma::Compressor)
+    str = "x" * 200_000
+    Dir.mktmpdir do |dir|
+      path = File.join dir, "page.html"
+      File.write path, str
+      file = File.open path, "rb"
+      body = Puma::Compression::Body.new file, Puma::Compressor.new("gzip"), false
+      out = +""
+      body.each { |part| out << part }
+      body.close
+
+      refute file.closed?
+      file.close
+      assert_equal str, Zlib.gunzip(out)
+    end
+  end
+end
@@ -0,0 +1,84 @@
+# frozen_string_literal: true
+
+require_relative "helper"
+
+require "puma/puma_http11"
+require "zlib"
+
+class TestCompressor < PumaTest
+  parallelize_me!
+
+  def setup
+    skip "Puma::Compressor isn't available" unless defined?(Puma::Compressor)
+  end
+
+  def test_gzip
+    c = Puma::Compressor.new "gzip"
+    out = c.compress("hello ") + c.compress("world") + c.finish
+
+    assert_equal "hello world", Zlib.gunzip(out)
+  end
+
+  def test_flush_outputs_all_input
+    c = Puma::Compressor.new "gzip"
+    out = c.compress "first part", true
+
+    # the stream isn't ended, but what was flushed can be decompressed
+    inflate = Zlib::Inflate.new 16 + Zlib::MAX_WBITS
+    assert_equal "first part", inflate.inflate(out)
+    out << c.finish("second part")
+    assert_equal "first partsecond part", Zlib.gunzip(out)
+  end
+
+  def test_large_input_without_gvl
+    str = Random.bytes(64 * 1024).unpack1('H*') * 4
+    c = Puma::Compressor.new "gzip", 1
+    out = c.compress(str) + c.finish
+
+    assert_operator out.bytesize, :<, str.bytesize
+    assert_equal str, Zlib.gunzip(out)
+  end
+
+  def test_threads_compress_at_once
+    str = "abcdefghij" * 100_000
+    outs = Array.new(4) do
+      Thread.new do
+        c = Puma::Compressor.new "gzip"
+        c.compress(str) + c.finish
+      end
+    end.map(&:value)
+
+    outs.each { |out| assert_equal str, Zlib.gunzip(out) }
+  end
+
+  def test_input_modifiable_after_compressing
+    str = +"x" * 100_000
+    c = Puma::Compressor.new "gzip"
+    out = c.compress str
+    str << "y"
+    assert_equal "x" * 100_000, Zlib.gunzip(out + c.finish)
+  end
+
+  def test_finished_stream_raises
+    c = Puma::Compressor.new "gzip"
+    c.finish
+    assert_raises(Puma::Compressor::Error) { c.compress "more" }
+    c.close
+  end
+
+  def test_encodings
+    assert_includes Puma::Compressor::ENCODINGS, "gzip"
+    assert Puma::Compressor::ENCODINGS.frozen?
+    assert_raises(ArgumentError) { Puma::Compressor.new "deflate" }
+  end
+
+  def test_zstd
+    skip "Puma was built without zstd" unless Puma::Compressor::ENCODINGS.include? "zstd"
+    c = Puma::Compressor.new "zstd"
+    out = c.compress("hello zstd " * 1_000) + c.finish
+
+    # the zstd frame magic number
+    assert_equal "\x28\xB5\x2F\xFD".b, out.byteslice(0, 4)
+    assert_operator out.bytesize, :<, 1_000
+  end
+end
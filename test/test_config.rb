@@ -298,6 +298,61 @@ class TestConfigFile < PumaTest
     assert ssl_binding.include?("&ssl_cipher_filter=#{cipher_filter}")
   end
 
+  def test_ssl_bind_with_ktls
+    skip_if :jruby
+    skip_unless :ssl
+
+    conf = Puma::Configuration.new do |c|
+      c.ssl_bind "0.0.0.0", "9292", {
+        cert: "cert",
+        key: "key",
+        ktls: true,
+      }
+    end
+
+    conf.clamp
+
+    ssl_binding = conf.options[:binds].first
+    assert ssl_binding.end_with?("&ktls=true")
+  end
+
+  def test_ssl_bind_with_reuse_port
+    skip_if :jruby
+    skip_unless :ssl
+
+    conf = Puma::Configuration.new do |c|
+      c.ssl_bind "0.0.0.0", "9292", {
+        cert: "cert",
+        key: "key",
+        reuse_port: true,
+      }
+    end
+
+    conf.clamp
+
+    ssl_binding = conf.options[:binds].first
+    assert ssl_binding.end_with?("&reuse_port=true")
+  end
+
+  def test_ssl_bind_with_defer_accept_and_fastopen
+    skip_if :jruby
+    skip_unless :ssl
+
+    conf = Puma::Configuration.new do |c|
+      c.ssl_bind "0.0.0.0", "9292", {
+        cert: "cert",
+        key: "key",
+        defer_accept: 2,
+        fastopen: 64,
+      }
+    end
+
+    conf.clamp
+
+    ssl_binding = conf.options[:binds].first
+    assert ssl_binding.end_with?("&defer_accept=2&fastopen=64")
+  end
+
   def test_ssl_bind_with_ciphersuites
     skip_if :jruby
     skip_unless :ssl
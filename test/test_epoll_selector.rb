@@ -0,0 +1,106 @@
+# frozen_string_literal: true
+
+require_relative "helper"
+
+require "puma/puma_http11"
+
+class TestEPollSelector < PumaTest
+  parallelize_me!
+
+  def setup
+    skip "Puma::EPollSelector is Linux only" unless defined?(Puma::EPollSelector)
+    @selector = Puma::EPollSelector.new
+    @rd, @wr = IO.pipe
+  end
+
+  def teardown
+    @selector&.close
+    @rd&.close
+    @wr&.close
+  end
+
+  def select(timeout = 0)
+    values = []
+    count = @selector.select(timeout) { |v| values << v }
+    assert_equal values.length, count
+    values
+  end
+
+  def test_select_yields_readable_values
+    rd2, wr2 = IO.pipe
+    @selector.register @rd, :one
+    @selector.register rd2, :two
+
+    assert_equal [], select
+    wr2.write "a"
+    assert_equal [:two], select
+    @wr.write "a"
+    assert_equal [:one, :two], select.sort
+  ensure
+    rd2&.close
+    wr2&.close
+  end
+
+  def test_select_timeout
+    @selector.register @rd, :one
+
+    t_st = Process.clock_gettime Process::CLOCK_MONOTONIC
+    assert_equal [], select(0.05)
+    assert_operator Process.clock_gettime(Process::CLOCK_MONOTONIC) - t_st, :>=, 0.04
+  end
+
+  def test_wakeup
+    thread = Thread.new { @selector.select { } }
+    sleep 0.05
+    @selector.wakeup
+
+    assert_equal 0, thread.join(5)&.value
+  end
+
+  def test_deregister
+    @selector.register @rd, :one
+    @wr.write "a"
+
+    assert_equal :one, @selector.deregister(@rd)
+    assert_nil @selector.deregister(@rd)
+    assert @selector.empty?
+    assert_equal [], select
+  end
+
+  def test_deregister_closed_io
+    @selector.register @rd, :one
+    @rd.close
+
+    assert_equal :one, @selector.deregister(@rd)
+    assert @selector.empty?
+  end
+
+  def test_register_errors
+    @selector.register @rd, :one
+    assert_raises(ArgumentError) { @selector.register @rd, :two }
+
+    @wr.close
+    assert_raises(ArgumentError) { @selector.register @wr, :two }
+  end
+
+  def test_fd_reused_after_close_without_deregister
+    @selector.register @rd, :one
+    @rd.close
+    @wr.close
+    @rd, @wr = IO.pipe
+
+    @selector.register @rd, :two
+    @wr.write "a"
+    assert_equal [:two], select
+  end
+
+  def test_close
+    @selector.register @rd, :one
+    @selector.close
+
+    assert @selector.closed?
+    assert @selector.empty?
+    assert_raises(IOError) { @selector.wakeup }
+    assert_raises(IOError) { @selector.select(0) { } }
+  end
+end
@@ -0,0 +1,74 @@
+# frozen_string_literal: true
+
+require_relative "helper"
+
+require "puma/puma_http11"
+
+class TestGVLMeter < PumaTest
+  parallelize_me!
+
+  def setup
+    skip "Puma::GVLMeter needs Ruby 3.3" unless defined?(Puma::GVLMeter)
+    @meter = Puma::GVLMeter.new
+  end
+
+  def busy_threads(count, seconds)
+    Array.new(count) do
+      Thread.new do
+        @meter.track_current_thread
+        t_end = Process.clock_gettime(Process::CLOCK_MONOTONIC) + seconds
+        nil while Process.clock_gettime(Process::CLOCK_MONOTONIC) < t_end
+      end
+    end.each(&:join)
+  end
+
+  def test_starts_at_zero
+    assert_equal 0, @meter.waits
+    assert_equal 0.0, @meter.wait_time
+    assert_equal 0.0, @meter.run_time
+  end
+
+  def test_contended_threads
+    busy_threads 3, 0.3
+
+    assert_operator @meter.waits, :>, 0
+    assert_operator @meter.wait_time, :>, 0.1
+    assert_operator @meter.run_time, :>, 0.2
+  end
+
+  def test_threads_not_tracked
+    busy_threads 1, 0.05
+    waits = @meter.waits
+    run_time = @meter.run_time
+
+    Thread.new { 3.times { sleep 0.01 } }.join
+    assert_equal waits, @meter.waits
+    assert_equal run_time, @meter.run_time
+  end
+
+  def test_thread_moves_to_another_meter
+    other = Puma::GVLMeter.new
+    Thread.new do
+      @meter.track_current_thread
+      sleep 0.01
+      other.track_current_thread
+      3.times { sleep 0.01 }
+    end.join
+
+    assert_operator @meter.waits, :>=, 1
+    assert_operator other.waits, :>=, 3
+  end
+
+  def test_meter_freed_before_its_threads
+    queue = Queue.new
+    thread = Thread.new do
+      Puma::GVLMeter.new.track_current_thread
+      queue.pop
+      sleep 0.01
+    end
+    sleep 0.01
+    GC.start
+    queue << true
+    assert thread.join(5)
+  end
+end
@@ -294,4 +294,100 @@ class Http11ParserTest < TestIntegration
 
     assert_equal "Valid\tValue", req['HTTP_DUMMY']
   end
+
+  def test_long_header_values
+    parser = Puma::HttpParser.new
+    req = {}
+    long = "#{'a' * 70}\t#{'b' * 57} \xC3\xA9"
+    http = "GET / HTTP/1.1\r\nX-Long: #{long}\r\nX-Empty:\r\nX-Short: 1\r\n\r\n"
+
+    nread = parser.execute(req, http.b, 0)
+
+    assert_equal http.bytesize, nread
+    assert_equal long.b, req['HTTP_X_LONG']
+    assert_equal "", req['HTTP_X_EMPTY']
+    assert_equal "1", req['HTTP_X_SHORT']
+  end
+
+  def test_long_header_value_split_across_reads
+    parser = Puma::HttpParser.new
+    req = {}
+    long = 'v' * 100
+    http = "GET / HTTP/1.1\r\nX-Long: #{long}\r\n\r\n"
+
+    # like Client, append to the same buffer, the parser upcases field names in place
+    buffer = http[0, 40]
+    nread = parser.execute(req, buffer, 0)
+    assert_equal 40, nread
+    refute parser.finished?
+
+    buffer << http[40..-1]
+    parser.execute(req, buffer, nread)
+    assert parser.finished?
+    assert_equal long, req['HTTP_X_LONG']
+  end
+
+  def test_invalid_byte_in_long_header_value
+    [0, 15, 16, 31, 32, 63, 99].each do |pos|
+      ["\n", "\x00", "\x7F"].each do |bad|
+        parser = Puma::HttpParser.new
+        val = +('v' * 100)
+        val[pos] = bad
+        http = "GET / HTTP/1.1\r\nX-Long: a#{val}\r\n\r\n"
+
+        assert_raises(Puma::HttpParserError, "#{bad.inspect} at #{pos}") do
+          parser.execute({}, http, 0)
+        end
+      end
+    end
+  end
+
+  def test_common_header_keys
+    parser = Puma::HttpParser.new
+    req = {}
+    http = "GET / HTTP/1.1\r\nHost: localhost\r\nContent-Length: 0\r\nContent-Type: text/plain\r\n" \
+      "Accept-Encoding: gzip\r\nAccept-Language: en\r\nIf-Match: *\r\nIf-Range: x\r\nTE: trailers\r\n" \
+      "Acceptx: no\r\nX-Request-Id: 1\r\n\r\n"
+
+    parser.execute(req, http, 0)
+
+    assert_equal "localhost", req["HTTP_HOST"]
+    assert_equal "0", req["CONTENT_LENGTH"]
+    assert_equal "text/plain", req["CONTENT_TYPE"]
+    assert_equal "gzip", req["HTTP_ACCEPT_ENCODING"]
+    assert_equal "en", req["HTTP_ACCEPT_LANGUAGE"]
+    assert_equal "*", req["HTTP_IF_MATCH"]
+    assert_equal "x", req["HTTP_IF_RANGE"]
+    assert_equal "trailers", req["HTTP_TE"]
+    assert_equal "no", req["HTTP_ACCEPTX"]
+    assert_equal "1", req["HTTP_X_REQUEST_ID"]
+    assert req.keys.all?(&:frozen?)
+  end
+
+  def test_uncommon_header_key_cache
+    skip_if :jruby
+
+    parser = Puma::HttpParser.new
+    http = "GET / HTTP/1.1\r\nHost: localhost\r\nX-Request-Id: 1\r\nTraceparent: 00-01\r\n\r\n"
+
+    req = {}
+    parser.execute(req, +http, 0)
+    assert_equal({ hits: 0, misses: 2 }, parser.field_cache_stats)
+
+    parser.reset
+    req2 = {}
+    parser.execute(req2, +http, 0)
+    assert_equal({ hits: 2, misses: 2 }, parser.field_cache_stats)
+
+    assert_equal "1", req2["HTTP_X_REQUEST_ID"]
+    assert_equal "00-01", req2["HTTP_TRACEPARENT"]
+    assert_same req.keys.last, req2.keys.last
+
+    GC.verify_compaction_references(expand_heap: true, toward: :empty) if GC.respond_to?(:verify_compaction_references)
+
+    parser.reset
+    req3 = {}
+    parser.execute(req3, +http, 0)
+    assert_equal "00-01", req3["HTTP_TRACEPARENT"]
+  end
 end
@@ -52,6 +52,23 @@ class TestIntegrationCluster < TestIntegration
       signal: :USR1, unix: true, config: "preload_app! false"
   end
 
+  def test_reuse_port_listener_per_worker
+    skip_if :jruby
+    skip "SO_REUSEPORT not supported" unless defined?(Socket::SO_REUSEPORT)
+
+    cli_server "-w #{workers} -t 1:1 test/rackup/hello.ru", no_bind: true, config: <<~CONFIG
+      preload_app! false
+      bind 'tcp://#{HOST}:#{bind_port}?reuse_port=true'
+    CONFIG
+
+    get_worker_pids 0
+    10.times { assert_equal 'Hello World', read_body(connect) }
+
+    Process.kill :USR1, @pid
+    get_worker_pids 1
+    10.times { assert_equal 'Hello World', read_body(connect) }
+  end
+
   def test_pre_existing_unix
     skip_unless :unix
 
@@ -243,8 +243,11 @@ class TestIntegrationPumactl < TestIntegration
       'pool_capacity'  => max_threads,
       'busy_threads'   => 0,
       'backlog_max' => 0,
+      'gvl_wait_time'  => Float,
+      'gvl_waiting'    => Float,
       'max_threads'    => max_threads,
       'requests_count' => 0,
+      'direct_requests_count' => 0,
       'reactor_max'    => 0,
     }
 
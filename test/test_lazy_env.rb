@@ -0,0 +1,120 @@
+# frozen_string_literal: true
+
+require_relative "helper"
+
+require "puma/puma_http11"
+require "puma/lazy_env"
+
+class TestLazyEnv < PumaTest
+  parallelize_me!
+
+  HTTP = "GET /path?a=1 HTTP/1.1\r\nHost: localhost:9292\r\nX-Trace: abc\r\n" \
+    "Accept:  text/html \r\nX-Dup: 1\r\nContent-Length: 0\r\nX-Dup: 2\r\n\r\n"
+
+  def setup
+    skip_if :jruby
+  end
+
+  def parse(http = HTTP)
+    parser = Puma::HttpParser.new
+    parser.lazy_env = true
+    env = Puma::LazyEnv["rack.version" => [3]]
+    buffer = http.b
+    parser.execute env, buffer, 0
+    assert parser.finished?
+    env.lazy_headers buffer, parser.lazy_spans
+    env
+  end
+
+  def test_parser_records_spans
+    parser = Puma::HttpParser.new
+    parser.lazy_env = true
+    req = {}
+    parser.execute req, HTTP.b, 0
+
+    assert_equal "GET", req["REQUEST_METHOD"]
+    assert_equal "/path", req["REQUEST_PATH"]
+    # duplicate headers are joined when parsed
+    assert_equal "1, 2", req["HTTP_X_DUP"]
+    refute req.key?("HTTP_HOST")
+
+    spans = parser.lazy_spans
+    span = spans["HTTP_ACCEPT"]
+    assert_equal "text/html", HTTP.byteslice(span >> 32, span & 0xffff_ffff)
+    assert_equal %w[HTTP_HOST HTTP_X_TRACE HTTP_ACCEPT CONTENT_LENGTH], spans.keys
+
+    parser.reset
+    assert_nil parser.lazy_spans
+  end
+
+  def test_values_created_on_read
+    env = parse
+
+    assert env.key?("HTTP_X_TRACE")
+    assert_equal 11, env.size
+    assert_equal 4, env.instance_variable_get(:@lazy_spans).size
+
+    assert_equal "abc", env["HTTP_X_TRACE"]
+    assert_equal Encoding::BINARY, env["HTTP_X_TRACE"].encoding
+    assert_equal "text/html", env.fetch("HTTP_ACCEPT")
+    assert_equal ["localhost:9292", "0"], env.values_at("HTTP_HOST", "CONTENT_LENGTH")
+    assert_nil env.instance_variable_get(:@lazy_spans)
+    assert_nil env.instance_variable_get(:@lazy_data)
+  end
+
+  def test_each_key_only_creates_read_values
+    env = parse
+    keys = []
+    env.each_key { |k| keys << k }
+
+    assert_equal 11, keys.size
+    assert_includes keys, "HTTP_HOST"
+    assert_nil env["HTTP_MISSING"]
+    assert_equal 4, env.instance_variable_get(:@lazy_spans).size
+  end
+
+  def test_hash_methods_see_all_values
+    env = parse
+    h = env.to_h
+
+    assert_instance_of Hash, h
+    assert_equal "localhost:9292", h["HTTP_HOST"]
+    assert_equal "text/html", h["HTTP_ACCEPT"]
+
+    env = parse
+    assert_equal "abc", env.select { |k, _| k.start_with? "HTTP_X" }["HTTP_X_TRACE"]
+
+    env = parse
+    assert_equal "0", env.merge("a" => 1)["CONTENT_LENGTH"]
+
+    env = parse
+    assert_equal "abc", env.to_a.assoc("HTTP_X_TRACE").last
+  end
+
+  def test_store_and_delete
+    env = parse
+    env["HTTP_HOST"] = "example.com"
+    assert_equal "example.com", env["HTTP_HOST"]
+
+    assert_equal "abc", env.delete("HTTP_X_TRACE")
+    refute env.key?("HTTP_X_TRACE")
+    assert_equal 10, env.size
+  end
+
+  def test_dup_is_independent
+    env = parse
+    copy = env.dup
+
+    assert_instance_of Puma::LazyEnv, copy
+    assert_equal "abc", copy["HTTP_X_TRACE"]
+    copy["HTTP_X_TRACE"] = "changed"
+    assert_equal "abc", env["HTTP_X_TRACE"]
+  end
+
+  def test_no_headers
+    env = parse "GET / HTTP/1.0\r\n\r\n"
+
+    assert_nil env.instance_variable_get(:@lazy_spans)
+    assert_equal "GET", env["REQUEST_METHOD"]
+  end
+end
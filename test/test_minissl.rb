@@ -90,5 +90,102 @@ class TestMiniSSL < PumaTest
 
       assert_raises(Errno::ENOENT) { ctx.key_password }
     end
+
+    def test_engine_read_returns_all_records
+      skip_unless :unix
+      require "openssl"
+
+      ctx = Puma::MiniSSL::Context.new
+      ctx.key  = File.expand_path "../examples/puma/puma_keypair.pem", __dir__
+      ctx.cert = File.expand_path "../examples/puma/cert_puma.pem", __dir__
+      ctx.verify_mode = Puma::MiniSSL::VERIFY_NONE
+      engine = Puma::MiniSSL::Engine.server Puma::MiniSSL::SSLContext.new(ctx)
+
+      rd, wr = UNIXSocket.pair
+      client_ctx = OpenSSL::SSL::SSLContext.new
+      client_ctx.verify_mode = OpenSSL::SSL::VERIFY_NONE
+      client = OpenSSL::SSL::SSLSocket.new wr, client_ctx
+
+      thread = Thread.new { client.connect }
+
+      # the handshake only, no application data is sent yet
+      until !engine.init? && !thread.alive?
+        next unless rd.wait_readable 0.05
+        engine.inject rd.read_nonblock(100_000)
+        engine.read
+        while (data = engine.extract)
+          rd.write data
+        end
+      end
+      thread.join
+
+      # 50 kB is at least 4 TLS records
+      body = Random.bytes 50_000
+      Thread.new { client.write body }.join
+
+      engine.inject rd.read_nonblock(100_000) while rd.wait_readable 0.05
+
+      buffer = String.new
+      assert_same buffer, engine.read(buffer)
+      assert_equal body, buffer
+      assert_equal Encoding::BINARY, buffer.encoding
+      assert_nil engine.read
+    ensure
+      client&.close
+      rd&.close
+    end
+
+    def test_engine_write_large_string
+      skip_unless :unix
+      require "openssl"
+
+      ctx = Puma::MiniSSL::Context.new
+      ctx.key  = File.expand_path "../examples/puma/puma_keypair.pem", __dir__
+      ctx.cert = File.expand_path "../examples/puma/cert_puma.pem", __dir__
+      ctx.verify_mode = Puma::MiniSSL::VERIFY_NONE
+      engine = Puma::MiniSSL::Engine.server Puma::MiniSSL::SSLContext.new(ctx)
+
+      rd, wr = UNIXSocket.pair
+      client_ctx = OpenSSL::SSL::SSLContext.new
+      client_ctx.verify_mode = OpenSSL::SSL::VERIFY_NONE
+      client = OpenSSL::SSL::SSLSocket.new wr, client_ctx
+
+      thread = Thread.new { client.connect }
+      while thread.alive?
+        next unless rd.wait_readable 0.05
+        engine.inject rd.read_nonblock(100_000)
+        engine.read
+        while (data = engine.extract)
+          rd.write data
+        end
+      end
+      thread.join
+
+      # the client's Finished message
+      engine.inject rd.read_nonblock(100_000) while rd.wait_readable 0.05
+      engine.read
+      while (data = engine.extract)
+        rd.write data
+      end
+      refute engine.init?
+
+      # encrypted and extracted without the GVL, up to 256 kB at once
+      body = Random.bytes 1_000_000
+      reader = Thread.new { client.read body.bytesize }
+      data = body
+      until data.empty?
+        wrote = engine.write data
+        assert_equal [data.bytesize, 262_144].min, wrote
+        while (enc = engine.extract)
+          rd.write enc
+        end
+        data = data.byteslice(wrote..-1)
+      end
+
+      assert_equal body, reader.value
+    ensure
+      client&.close
+      rd&.close
+    end
   end
 end if ::Puma::HAS_SSL
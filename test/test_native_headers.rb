@@ -0,0 +1,163 @@
+# frozen_string_literal: true
+
+require_relative "helper"
+
+require "puma/server"
+
+# Checks that `Puma::NativeHeaders` writes the same bytes, and finds the same
+# values, as the Ruby code in `Puma::Response#str_headers`.
+class TestNativeHeaders < PumaTest
+  parallelize_me!
+
+  def setup
+    skip "Puma::NativeHeaders isn't available" unless Puma::Response::NATIVE_HEADERS
+    @server = Puma::Server.new ->(_) { [200, {}, []] }, nil, {log_writer: Puma::LogWriter.strings}
+  end
+
+  def str_headers(headers, status: 200, env: {}, force_keep_alive: true, info: nil, cache: nil)
+    env = {"REQUEST_METHOD" => "GET", "SERVER_PROTOCOL" => "HTTP/1.1"}.merge env
+    io_buffer = Puma::IOBuffer.new
+    @server.instance_variable_set :@header_cache, cache
+    resp_info = @server.send :str_headers, env, status, headers, nil, io_buffer, force_keep_alive, info
+    [io_buffer.read_and_reset, resp_info]
+  end
+
+  def assert_same_headers(headers, cache: nil, **opts)
+    ruby, ruby_info = str_headers headers, **opts
+    native, info = str_headers headers, info: Puma::Response::Info.new, cache: cache, **opts
+
+    assert_instance_of Puma::Response::Info, info
+    assert_equal ruby, native
+    Puma::Response::Info.members.each do |m|
+      assert_equal [m, ruby_info[m] || nil], [m, info[m] || nil]
+    end
+    native
+  end
+
+  def test_headers
+    out = assert_same_headers({"Content-Type" => "text/plain", "X-Count" => 3, "x-nil" => nil})
+    assert_equal "HTTP/1.1 200 OK\r\ncontent-type: text/plain\r\nx-count: 3\r\nx-nil: \r\n", out
+  end
+
+  def test_status_lines
+    [100, 201, 204, 304, 404, 500, 599].each do |status|
+      assert_same_headers({"x" => "y"}, status: status)
+      assert_same_headers({"x" => "y"}, status: status, env: {"SERVER_PROTOCOL" => "HTTP/1.0"})
+    end
+    assert_includes assert_same_headers({}, status: 599), "599 CUSTOM\r\n"
+  end
+
+  def test_connection
+    assert_same_headers({}, env: {"HTTP_CONNECTION" => "Close"})
+    assert_same_headers({}, force_keep_alive: false)
+    out = assert_same_headers({}, env: {"SERVER_PROTOCOL" => "HTTP/1.0", "HTTP_CONNECTION" => "Keep-Alive"})
+    assert_equal "HTTP/1.0 200 OK\r\nconnection: keep-alive\r\n", out
+  end
+
+  def test_head_request
+    assert_same_headers({"content-length" => "5"}, env: {"REQUEST_METHOD" => "HEAD"})
+  end
+
+  def test_multiline_and_array_values
+    out = assert_same_headers({"set-cookie" => "a=1\nb=2\n\nc=3\n\n", "vary" => ["accept", "origin"],
+      "x-empty" => "", "x-newlines" => "\n\n", "x-list" => []})
+    assert_includes out, "set-cookie: a=1\r\nset-cookie: b=2\r\nset-cookie: \r\nset-cookie: c=3\r\n"
+    assert_includes out, "vary: accept\r\nvary: origin\r\n"
+  end
+
+  def test_illegal_keys_and_values
+    out = assert_same_headers({"x bad" => "1", "x(bad)" => "2", "x-bad-value" => "a\rb",
+      "x-tab" => "a\tb", "x-ok" => "ok\n\x01no", "x-array" => ["ok", "no\x1f"]})
+    assert_equal "HTTP/1.1 200 OK\r\nx-tab: a\tb\r\nx-ok: ok\r\nx-array: ok\r\n", out
+  end
+
+  def test_special_keys
+    hijack = ->(io) {}
+    assert_same_headers({"Content-Length" => "42", "Rack.Hijack" => hijack, "rack.foo" => "x",
+      "Status" => "200", "statuses" => "1"})
+    assert_same_headers({"content-length" => 7})
+    assert_same_headers({"content-length" => "4\r2"})
+    assert_same_headers({"content-length" => "2", "Transfer-Encoding" => "gzip"})
+    assert_same_headers({"transfer-encoding" => "chunked"}, env: {"SERVER_PROTOCOL" => "HTTP/1.0"})
+  end
+
+  def test_long_and_non_ascii_keys
+    assert_same_headers({"X-#{'A' * 200}" => "1", "X-Ä-Header" => "2"})
+  end
+
+  def test_reused_info
+    info = Puma::Response::Info.new
+    str_headers({"content-length" => "3", "rack.hijack" => -> {}}, info: info)
+    _, info = str_headers({}, info: info)
+    assert_nil info.content_length
+    assert_nil info.response_hijack
+    refute info.no_body
+  end
+
+  def test_status_lines_of_all_codes
+    Puma::HTTP_STATUS_CODES.each do |status, reason|
+      out = assert_same_headers({}, status: status, env: {"HTTP_CONNECTION" => "close"})
+      assert_equal "HTTP/1.1 #{status} #{reason}\r\nconnection: close\r\n", out
+      out = assert_same_headers({}, status: status, env: {"SERVER_PROTOCOL" => "HTTP/1.0"})
+      assert_equal "HTTP/1.0 #{status} #{reason}\r\n", out
+    end
+  end
+
+  def test_line_cache
+    cache = Puma::NativeHeaders::LineCache.new 8
+    headers = {"Content-Type" => "text/html; charset=utf-8", "Vary" => "accept\nx\x01y".freeze,
+      "x-dynamic" => +"not frozen", "Cache-Control" => "no-store"}
+
+    first = assert_same_headers headers, cache: cache
+    assert_equal 0, cache.hits
+    assert_equal 3, cache.misses
+    assert_equal first, assert_same_headers(headers, cache: cache)
+    assert_equal 3, cache.hits
+    assert_equal 3, cache.misses
+  end
+
+  def test_line_cache_skips_special_headers
+    cache = Puma::NativeHeaders::LineCache.new 8
+    headers = {"content-length" => "10", "transfer-encoding" => "gzip", "rack.hijack" => "x", "status" => "200"}
+
+    2.times { assert_same_headers headers, cache: cache }
+    assert_equal 0, cache.hits
+  end
+
+  def test_line_cache_evicts_least_recently_used
+    cache = Puma::NativeHeaders::LineCache.new 2
+    a = {"a" => "1"}
+    b = {"b" => "2"}
+    c = {"c" => "3"}
+
+    [a, b, a, c].each { |h| assert_same_headers h, cache: cache }
+    assert_equal 1, cache.hits
+
+    assert_same_headers a, cache: cache
+    assert_equal 2, cache.hits
+    assert_same_headers b, cache: cache
+    assert_equal 2, cache.hits
+    assert_equal 4, cache.misses
+  end
+
+  def test_line_cache_keeps_strings_alive
+    cache = Puma::NativeHeaders::LineCache.new 64
+    32.times { |i| str_headers({"x-#{i}".freeze => "v#{i}".freeze}, info: Puma::Response::Info.new, cache: cache) }
+    GC.start
+    GC.compact if GC.respond_to?(:compact)
+    32.times { |i| assert_same_headers({"x-#{i}".freeze => "v#{i}".freeze}, cache: cache) }
+    assert_equal 0, cache.hits
+  end
+
+  def test_line_cache_size
+    assert_equal 3, Puma::NativeHeaders::LineCache.new(3).size
+    assert_raises(ArgumentError) { Puma::NativeHeaders::LineCache.new 0 }
+  end
+
+  def test_falls_back_for_symbol_keys
+    headers = {"x" => "1", x_sym: "2"}
+    out, info = str_headers(headers, info: Puma::Response::Info.new)
+    assert_instance_of Hash, info
+    assert_equal str_headers(headers).first, out
+  end
+end
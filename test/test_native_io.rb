@@ -0,0 +1,146 @@
+# frozen_string_literal: true
+
+require_relative "helper"
+require_relative "helpers/tmp_path"
+
+require "puma/puma_http11"
+require "securerandom"
+
+class TestNativeIO < PumaTest
+  include TmpPath
+  parallelize_me!
+
+  def setup
+    skip_if :jruby
+    skip_unless :unix
+    @rd, @wr = UNIXSocket.pair
+  end
+
+  def teardown
+    @rd&.close
+    @wr&.close
+    clean_tmp_paths
+  end
+
+  def test_writev
+    strs = ["HTTP/1.1 200 OK\r\n\r\n", "Hello", "", " World"]
+
+    assert_equal 30, Puma::NativeIO.writev(@wr, strs, 1)
+    assert_equal strs.join, @rd.read_nonblock(64)
+  end
+
+  def test_writev_more_strings_than_iov_max
+    strs = Array.new(3000) { |i| i.to_s }
+
+    reader = Thread.new { @rd.read strs.join.bytesize }
+    assert_equal strs.join.bytesize, Puma::NativeIO.writev(@wr, strs, 5)
+    assert_equal strs.join, reader.value
+  end
+
+  def test_writev_waits_after_partial_writes
+    strs = ["a" * 300_000, "b" * 1_000_000, "c"]
+    expected = strs.join
+
+    reader = Thread.new do
+      sleep 0.1
+      @rd.read expected.bytesize
+    end
+    assert_equal expected.bytesize, Puma::NativeIO.writev(@wr, strs, 5)
+    assert_equal expected, reader.value
+  end
+
+  def test_writev_large_string_changed_while_waiting
+    str = "a" * 4_000_000
+
+    reader = Thread.new do
+      sleep 0.1
+      @rd.read str.bytesize
+    end
+    writer = Thread.new { Puma::NativeIO.writev @wr, [str], 5 }
+    sleep 0.05
+    # the bytes not written yet are the ones of the String when called
+    str.replace "b" * 4_000_000
+    assert_equal 4_000_000, writer.value
+    assert_equal "a" * 4_000_000, reader.value
+  end
+
+  def test_writev_timeout
+    assert_nil Puma::NativeIO.writev(@wr, ["a" * 4_000_000], 0.1)
+  end
+
+  def test_writev_closed_peer
+    @rd.close
+    assert_raises(Errno::EPIPE) { Puma::NativeIO.writev @wr, ["a"], 1 }
+  end
+
+  def test_sendfile
+    skip unless Puma::NativeIO.respond_to?(:sendfile)
+    data = SecureRandom.random_bytes 2_000_000
+    tf = tempfile_create "test_sendfile", data
+
+    reader = Thread.new { @rd.read 1_500_000 }
+    assert_equal 1_500_000, Puma::NativeIO.sendfile(@wr, tf, 100_000, 1_500_000, 5)
+    assert_equal data.byteslice(100_000, 1_500_000), reader.value
+    assert_equal 0, tf.pos
+  ensure
+    tf&.close
+  end
+
+  def test_sendfile_past_end_of_file
+    skip unless Puma::NativeIO.respond_to?(:sendfile)
+    tf = tempfile_create "test_sendfile_past_end_of_file", "Hello World"
+
+    assert_equal 6, Puma::NativeIO.sendfile(@wr, tf, 5, 100, 1)
+    assert_equal " World", @rd.read_nonblock(64)
+  ensure
+    tf&.close
+  end
+
+  def test_sendfile_timeout
+    skip unless Puma::NativeIO.respond_to?(:sendfile)
+    tf = tempfile_create "test_sendfile_timeout", "a" * 4_000_000
+
+    assert_nil Puma::NativeIO.sendfile(@wr, tf, 0, 4_000_000, 0.1)
+  ensure
+    tf&.close
+  end
+
+  def test_writev_requires_strings
+    assert_raises(TypeError) { Puma::NativeIO.writev @wr, ["a", 1], 1 }
+  end
+
+  def test_accept
+    skip unless Puma::NativeIO.respond_to?(:accept)
+    server = TCPServer.new "127.0.0.1", 0
+    assert_equal [], Puma::NativeIO.accept(server, 8)
+
+    clients = Array.new(3) { TCPSocket.new "127.0.0.1", server.addr[1] }
+    socks = Puma::NativeIO.accept server, 2
+    assert_equal [TCPSocket, TCPSocket], socks.map(&:class)
+    assert socks.all?(&:close_on_exec?)
+
+    socks.concat Puma::NativeIO.accept(server, 8)
+    assert_equal 3, socks.length
+    clients.first.syswrite "a"
+    assert_equal "a", socks.first.read_nonblock(1)
+  ensure
+    socks&.each(&:close)
+    clients&.each(&:close)
+    server&.close
+  end
+
+  def test_accept_unix
+    skip unless Puma::NativeIO.respond_to?(:accept)
+    path = tmp_path ".sock"
+    server = UNIXServer.new path
+    client = UNIXSocket.new path
+
+    socks = Puma::NativeIO.accept server, 8
+    assert_equal [UNIXSocket], socks.map(&:class)
+    assert_raises(TypeError) { Puma::NativeIO.accept @rd, 8 }
+  ensure
+    socks&.each(&:close)
+    client&.close
+    server&.close
+  end
+end
@@ -7,6 +7,7 @@ require "puma/events"
 require "puma/server"
 require "nio"
 require "ipaddr"
+require "zlib"
 
 class WithoutBacktraceError < StandardError
   def backtrace; nil; end
@@ -126,6 +127,27 @@ class TestPumaServer < PumaTest
     tf&.close
   end
 
+  def test_file_range_body
+    random_bytes = SecureRandom.random_bytes(4096 * 32)
+
+    tf = tempfile_create("test_file_range_body", random_bytes)
+    path = tf.path
+
+    # like Rack::Files::BaseIterator for a single range
+    obj = Object.new
+    obj.singleton_class.send(:define_method, :path) { path }
+    obj.singleton_class.send(:define_method, :ranges) { [1_000..99_999] }
+    obj.singleton_class.send(:define_method, :each) { raise "each called" }
+
+    server_run { |env| [206, {"content-length" => "99000"}, obj] }
+
+    body = send_http_read_resp_body
+
+    assert_equal random_bytes.byteslice(1_000..99_999), body
+  ensure
+    tf&.close
+  end
+
   def test_pipe_body_http11
     random_bytes = SecureRandom.random_bytes(4096)
 
@@ -1756,6 +1778,225 @@ class TestPumaServer < PumaTest
     assert_empty @log_writer.stderr.string
   end
 
+  # connections queued before the server runs are accepted in one batch
+  def test_accept_batch
+    @server = Puma::Server.new ->(_) { [200, {}, ["ok"]] }, @events, log_writer: @log_writer
+    @bind_port = (@server.add_tcp_listener @host, 0).addr[1]
+    sockets = Array.new(20) { send_http }
+
+    @server.run
+    sockets.each { |socket| assert_equal "ok", socket.read_body }
+    assert_equal 20, @server.requests_count
+  end
+
+  def test_direct_requests_count
+    server_run { [200, {}, ["ok"]] }
+
+    # the request arrives after the connection waits in the reactor
+    socket = new_socket
+    sleep 0.2
+    assert_equal "ok", socket.send_http(GET_11).read_body
+    assert_equal [1, 0], [@server.requests_count, @server.direct_requests_count]
+  end
+
+  def test_direct_requests_count_defer_accept
+    skip "TCP_DEFER_ACCEPT not supported" unless defined?(Socket::TCP_DEFER_ACCEPT)
+    @server = Puma::Server.new ->(_) { [200, {}, ["ok"]] }, @events, log_writer: @log_writer
+    @bind_port = (@server.binder.add_tcp_listener @host, 0, defer_accept: 5).addr[1]
+    @server.run
+
+    # the connection is accepted once the request arrives
+    socket = new_socket
+    sleep 0.2
+    assert_equal "ok", socket.send_http(GET_11).read_body
+    assert_equal [1, 1], [@server.requests_count, @server.direct_requests_count]
+  end
+
+  def test_adaptive_threads
+    skip "Puma::GVLMeter needs Ruby 3.3" unless Puma::QueueDelayController.available?
+    server_run(max_threads: 4, adaptive_threads: 0.01) { [200, {}, ["ok"]] }
+
+    assert_equal "ok", send_http_read_resp_body(GET_11)
+    assert_equal 0.01, @pool.queue_delay.target
+    assert_operator @pool.gvl_meter.waits, :>, 0
+  end
+
+  def test_compression_array_body
+    skip "Puma::Compressor isn't available" unless defined?(Puma::Compressor)
+    html = "<p>#{'hello ' * 1_000}</p>"
+    server_run(compression: true) do
+      [200, {"content-type" => "text/html", "content-length" => html.bytesize.to_s, "etag" => '"v1"'}, [html]]
+    end
+
+    response = send_http_read_response "GET / HTTP/1.1\r\nHost: test.com\r\nAccept-Encoding: gzip\r\n\r\n"
+    headers = response.headers_hash
+    assert_equal "gzip", headers["content-encoding"]
+    assert_equal "accept-encoding", headers["vary"]
+    assert_equal 'W/"v1"', headers["etag"]
+    assert_equal response.body.bytesize, headers["content-length"].to_i
+    assert_equal html, Zlib.gunzip(response.body)
+
+    response = send_http_read_response GET_11
+    refute response.headers_hash.key?("content-encoding")
+    assert_equal '"v1"', response.headers_hash["etag"]
+    assert_equal "accept-encoding", response.headers_hash["vary"]
+    assert_equal html, response.body
+  end
+
+  def test_compression_streamed_body
+    skip "Puma::Compressor isn't available" unless defined?(Puma::Compressor)
+    server_run(compression: true) { [200, {"content-type" => "application/json"}, %w[{"a": 1, "b": 2}].each] }
+
+    response = send_http_read_response "GET / HTTP/1.1\r\nHost: test.com\r\nAccept-Encoding: gzip\r\n\r\n"
+    assert_equal "gzip", response.headers_hash["content-encoding"]
+    assert_equal "chunked", response.headers_hash["transfer-encoding"]
+    assert_equal '{"a":1,"b":2}', Zlib.gunzip(response.decode_body)
+
+    # chunked isn't allowed
+    response = send_http_read_response "GET / HTTP/1.0\r\nAccept-Encoding: gzip\r\n\r\n"
+    refute response.headers_hash.key?("content-encoding")
+    assert_equal '{"a":1,"b":2}', response.body
+  end
+
+  def test_compression_skipped
+    skip "Puma::Compressor isn't available" unless defined?(Puma::Compressor)
+    bodies = {
+      "/small" => [200, {"content-type" => "text/plain"}, ["small"]],
+      "/png" => [200, {"content-type" => "image/png"}, ["x" * 2_000]],
+      "/encoded" => [200, {"content-type" => "text/plain", "content-encoding" => "br"}, ["x" * 2_000]],
+      "/partial" => [206, {"content-type" => "text/plain"}, ["x" * 2_000]],
+    }
+    server_run(compression: {min_size: 100}) { |env| bodies[env["PATH_INFO"]] }
+
+    bodies.each do |path, (status, _, body)|
+      response = send_http_read_response "GET #{path} HTTP/1.1\r\nHost: test.com\r\nAccept-Encoding: gzip\r\n\r\n"
+      assert_equal "HTTP/1.1 #{status} #{Puma::HTTP_STATUS_CODES[status]}", response.status
+      refute_equal "gzip", response.headers_hash["content-encoding"], path
+      assert_equal body.first, response.body, path
+    end
+  end
+
+  def test_compression_precompressed_sibling
+    tf = tempfile_create("test_compression.js", "js" * 1_000)
+    File.write "#{tf.path}.gz", "precompressed"
+    obj = Object.new
+    obj.singleton_class.send(:define_method, :to_path) { tf.path }
+    obj.singleton_class.send(:define_method, :each) { raise "each called" }
+
+    server_run(compression: true) { [200, {"content-type" => "application/javascript"}, obj] }
+
+    response = send_http_read_response "GET / HTTP/1.1\r\nHost: test.com\r\nAccept-Encoding: br, gzip\r\n\r\n"
+    assert_equal "gzip", response.headers_hash["content-encoding"]
+    assert_equal "13", response.headers_hash["content-length"]
+    assert_equal "precompressed", response.body
+
+    response = send_http_read_response "GET / HTTP/1.1\r\nHost: test.com\r\nAccept-Encoding: identity\r\n\r\n"
+    assert_equal "js" * 1_000, response.body
+  ensure
+    File.unlink "#{tf.path}.gz" if tf && File.exist?("#{tf.path}.gz")
+    tf&.close
+  end
+
+  def test_compression_head
+    skip "Puma::Compressor isn't available" unless defined?(Puma::Compressor)
+    tf = tempfile_create("test_compression.js", "js" * 1_000)
+    File.write "#{tf.path}.gz", "precompressed"
+    obj = Object.new
+    obj.singleton_class.send(:define_method, :to_path) { tf.path }
+    obj.singleton_class.send(:define_method, :each) { raise "each called" }
+    html = "<p>#{'hello ' * 1_000}</p>"
+
+    server_run(compression: true) do |env|
+      if env["PATH_INFO"] == "/file"
+        [200, {"content-type" => "application/javascript", "etag" => '"v1"'}, obj]
+      else
+        [200, {"content-type" => "text/html", "content-length" => html.bytesize.to_s, "etag" => '"v1"'}, [html]]
+      end
+    end
+
+    %w[/file /array].each do |path|
+      get = send_http_read_response("GET #{path} HTTP/1.1\r\nHost: test.com\r\nAccept-Encoding: gzip\r\nConnection: close\r\n\r\n").headers_hash
+      head = send_http_read_response "HEAD #{path} HTTP/1.1\r\nHost: test.com\r\nAccept-Encoding: gzip\r\nConnection: close\r\n\r\n"
+      assert_equal "", head.body, path
+      head = head.headers_hash
+      assert_equal "gzip", head["content-encoding"], path
+      if path == "/file"
+        assert_equal get, head
+      else
+        # the compressed length isn't known without compressing the body
+        assert_equal get.except("content-length"), head
+      end
+    end
+  ensure
+    File.unlink "#{tf.path}.gz" if tf && File.exist?("#{tf.path}.gz")
+    tf&.close
+  end
+
+  def test_static_file_cache
+    tf = tempfile_create("test_static_file_cache.css", "body { color: red }")
+    calls = 0
+    obj = Object.new
+    obj.singleton_class.send(:define_method, :to_path) { tf.path }
+    obj.singleton_class.send(:define_method, :each) { raise "each called" }
+
+    server_run(static_file_cache: {prefixes: ["/assets/"]}) do
+      calls += 1
+      [200, {"content-type" => "text/css", "cache-control" => "public, max-age=60"}, obj]
+    end
+
+    response = send_http_read_response "GET /assets/app.css HTTP/1.1\r\nHost: test.com\r\n\r\n"
+    headers = response.headers_hash
+    assert_equal "body { color: red }", response.body
+    assert_equal "19", headers["content-length"]
+    etag = headers["etag"]
+    assert_equal format('"%x-%x"', File.mtime(tf.path).to_i, 19), etag
+    assert_equal File.mtime(tf.path).httpdate, headers["last-modified"]
+
+    response = send_http_read_response "GET /assets/app.css HTTP/1.1\r\nHost: test.com\r\nIf-None-Match: #{etag}\r\n\r\n"
+    assert_equal "HTTP/1.1 304 Not Modified", response.status
+    assert_equal etag, response.headers_hash["etag"]
+    assert_equal "public, max-age=60", response.headers_hash["cache-control"]
+    assert_equal "", response.body
+    assert_equal 1, calls
+
+    # not under a prefix, the app answers
+    response = send_http_read_response "GET /app.css HTTP/1.1\r\nHost: test.com\r\nIf-None-Match: #{etag}\r\n\r\n"
+    assert_equal "HTTP/1.1 200 OK", response.status
+    assert_equal 2, calls
+  ensure
+    tf&.close
+  end
+
+  def test_static_file_cache_compression
+    skip "Puma::Compressor isn't available" unless defined?(Puma::Compressor)
+    css = "body { color: red }\n" * 100
+    tf = tempfile_create("test_static_file_cache.css", css)
+    obj = Object.new
+    obj.singleton_class.send(:define_method, :to_path) { tf.path }
+    obj.singleton_class.send(:define_method, :each) { raise "each called" }
+
+    server_run(compression: true, static_file_cache: {}) { [200, {"content-type" => "text/css"}, obj] }
+
+    get = nil
+    2.times do
+      response = send_http_read_response "GET / HTTP/1.1\r\nHost: test.com\r\nAccept-Encoding: gzip\r\n\r\n"
+      get = headers = response.headers_hash
+      assert_equal "gzip", headers["content-encoding"]
+      assert_equal "accept-encoding", headers["vary"]
+      assert_start_with headers["etag"], "W/"
+      assert_equal css, Zlib.gunzip(response.body)
+    end
+
+    head = send_http_read_response("HEAD / HTTP/1.1\r\nHost: test.com\r\nAccept-Encoding: gzip\r\nConnection: close\r\n\r\n").headers_hash
+    assert_equal get, head.except("connection")
+
+    cache = @server.instance_variable_get :@static_file_cache
+    assert_equal 1, cache.size
+    assert_operator cache.bytes, :>, css.bytesize
+  ensure
+    tf&.close
+  end
+
   # see      https://github.com/puma/puma/issues/2390
   # fixed by https://github.com/puma/puma/pull/2279
   #
@@ -1830,6 +2071,29 @@ class TestPumaServer < PumaTest
     assert_equal selector.backend, backend
   end
 
+  def test_native_io_selector
+    skip "Puma::EPollSelector is Linux only" unless defined?(Puma::EPollSelector)
+    server_run(io_selector_backend: :native) { [200, {}, ["Hello"]] }
+
+    selector = @server.instance_variable_get(:@reactor).instance_variable_get(:@selector)
+    assert_kind_of Puma::EPollSelector, selector
+
+    # request split across reads, then a keep-alive request
+    socket = new_socket
+    socket << "GET / HTTP/1.1\r\n"
+    sleep 0.1
+    socket << "Host: a.com\r\n\r\n"
+    assert_equal 'Hello', socket.read_body
+    sleep 0.1
+    socket << GET_11
+    assert_equal 'Hello', socket.read_body
+  end
+
+  def test_native_io_selector_timeout_in_data_phase
+    skip "Puma::EPollSelector is Linux only" unless defined?(Puma::EPollSelector)
+    test_timeout_in_data_phase(io_selector_backend: :native)
+  end
+
   def test_drain_on_shutdown(drain=true)
     num_connections = 10
 
@@ -1864,6 +2128,48 @@ class TestPumaServer < PumaTest
     test_drain_on_shutdown false
   end
 
+  def test_reuse_port_drained_on_shutdown
+    skip_if :jruby
+    skip "SO_REUSEPORT not supported" unless defined?(Socket::SO_REUSEPORT)
+    wait = Queue.new
+    app = ->(_) { wait.pop; [200, {}, ["DONE"]] }
+    @server = Puma::Server.new app, @events, {log_writer: @log_writer, max_threads: 1, queue_requests: false}
+    binder = @server.binder
+    @bind_port = binder.add_tcp_listener(@host, 0, reuse_port: true).addr[1]
+    @server.run
+
+    connections = Array.new(10) { send_http GET_10 }
+    @server.stop
+    wait.close
+    connections.each { |s| assert_match 'DONE', s.read_body }
+    assert_empty binder.reuse_port_ios
+  end
+
+  def test_reuse_port_drain_leaves_shared_listeners
+    skip_if :jruby
+    skip "SO_REUSEPORT not supported" unless defined?(Socket::SO_REUSEPORT)
+    wait = Queue.new
+    app = ->(_) { wait.pop; [200, {}, ["DONE"]] }
+    @server = Puma::Server.new app, @events, {log_writer: @log_writer, max_threads: 1,
+      queue_requests: false, drain_on_shutdown: false}
+    @bind_port = @server.binder.add_tcp_listener(@host, 0, reuse_port: true).addr[1]
+    shared_port = @server.binder.add_tcp_listener(@host, 0).addr[1]
+    @server.run
+
+    reuse_port = Array.new(5) { send_http GET_10 }
+    shared = Array.new(5) { send_http GET_10, port: shared_port }
+    sleep 0.1
+    @server.stop
+    wait.close
+    reuse_port.each { |s| assert_match 'DONE', s.read_body }
+    served = shared.count do |s|
+      s.wait_readable(1) && s.read_body.include?('DONE')
+    rescue Errno::ECONNRESET
+      false
+    end
+    assert_operator served, :<, shared.length
+  end
+
   def test_remote_address_header
     server_run(remote_address: :header, remote_address_header: 'HTTP_X_REMOTE_IP') do |env|
       [200, {}, [env['REMOTE_ADDR']]]
@@ -2185,7 +2491,7 @@ class TestPumaServer < PumaTest
   end
 
   def test_stats_ok_before_run
-    assert_equal({max_threads: @server.max_threads, requests_count: 0}, @server.stats)
+    assert_equal({max_threads: @server.max_threads, requests_count: 0, direct_requests_count: 0}, @server.stats)
   end
 
   def test_update_thread_pool_min_max
@@ -8,6 +8,7 @@ require_relative "helper"
 
 if ::Puma::HAS_SSL
   require "puma/minissl"
+  require "digest"
   require_relative "helpers/test_puma/puma_socket"
 
   if ENV['PUMA_TEST_DEBUG']
@@ -77,6 +78,12 @@ class TestPumaServerSSL < PumaTest
     assert_equal "https", send_http_read_resp_body(ctx: new_ctx)
   end
 
+  def test_accept_batch
+    start_server
+    bodies = Array.new(10) { Thread.new { send_http_read_resp_body ctx: new_ctx } }.map(&:value)
+    assert_equal ["https"] * 10, bodies
+  end
+
   def test_request_wont_block_thread
     start_server
     # Open a connection and give enough data to trigger a read, then wait
@@ -124,6 +131,45 @@ class TestPumaServerSSL < PumaTest
     assert_equal "https\na=1&b=2", body
   end
 
+  def test_ktls
+    skip_if :jruby
+    skip("OpenSSL doesn't support kTLS") unless Puma::MiniSSL::HAS_KTLS
+
+    start_server { |ctx| ctx.ktls = true }
+    upload = Random.bytes 200_000
+    file = Tempfile.create "puma_ktls"
+    file.write("x" * 2_000_000)
+    file.flush
+
+    @server.app = proc do |env|
+      body = env['rack.input'].read
+      # Array body for POST, File body, written with IO.copy_stream, for GET
+      env['REQUEST_METHOD'] == 'POST' ? [200, {}, [Digest::SHA256.hexdigest(body)]] :
+        [200, {'content-length' => file.size.to_s}, File.open(file.path, 'rb')]
+    end
+
+    req = "POST / HTTP/1.1\r\nHost: test.com\r\nContent-Length: #{upload.bytesize}\r\n\r\n"
+    assert_equal Digest::SHA256.hexdigest(upload), send_http_read_resp_body("#{req}#{upload}", ctx: new_ctx)
+
+    assert_equal 2_000_000, send_http_read_resp_body(ctx: new_ctx).bytesize
+  ensure
+    file&.close
+    File.unlink file.path if file
+  end
+
+  def test_large_upload
+    start_server
+    @server.app = proc { |env| [200, {}, [Digest::SHA256.hexdigest(env['rack.input'].read)]] }
+
+    upload = Random.bytes 2_000_000
+    req = "POST / HTTP/1.1\r\nHost: test.com\r\nContent-Type: application/octet-stream\r\n" \
+      "Content-Length: #{upload.bytesize}\r\n\r\n"
+
+    body = send_http_read_resp_body "#{req}#{upload}", ctx: new_ctx
+
+    assert_equal Digest::SHA256.hexdigest(upload), body
+  end
+
   def rejection(server_ctx, min_max, ssl_version)
     if server_ctx
       start_server(&server_ctx)
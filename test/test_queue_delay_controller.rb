@@ -0,0 +1,81 @@
+# frozen_string_literal: true
+
+require_relative "helper"
+
+require "puma/puma_http11"
+require "puma/queue_delay_controller"
+
+class TestQueueDelayController < PumaTest
+  parallelize_me!
+
+  def setup
+    skip "Puma::GVLMeter needs Ruby 3.3" unless Puma::QueueDelayController.available?
+    @controller = Puma::QueueDelayController.new 0.01, Puma::GVLMeter.new
+  end
+
+  def stub_sample(p99, gvl_waiting, gvl_threads = nil)
+    @controller.define_singleton_method(:sample) { [p99, gvl_waiting, gvl_threads] }
+  end
+
+  def test_sample_p99
+    assert_nil @controller.sample[0]
+
+    99.times { @controller.record 0.001, 0.01 }
+    @controller.record 0.1, 0.01
+    p99, gvl_waiting, gvl_threads = @controller.sample
+    assert_operator p99, :>=, 0.001
+    assert_operator p99, :<, 0.0012
+    assert_operator gvl_waiting, :>=, 0
+    assert_nil gvl_threads # no thread is tracked
+
+    @controller.record 0.1, 0.01
+    assert_operator @controller.sample[0], :>=, 0.1
+    assert_nil @controller.sample[0]
+  end
+
+  def test_record_out_of_range
+    @controller.record 0, 0
+    @controller.record(-1, 0)
+    assert_equal 0.0, @controller.sample[0]
+
+    @controller.record 1_000_000, 0
+    assert_operator @controller.sample[0], :>, 3600
+  end
+
+  def test_adapt_shrinks_when_gvl_saturated
+    stub_sample 1.0, 1.5
+    assert_equal 4, @controller.adapt(5, 5, 1, 5)
+
+    stub_sample 1.0, 2.5
+    assert_equal 3, @controller.adapt(5, 5, 1, 5)
+    assert_equal 1, @controller.adapt(5, 3, 1, 5)
+    assert_equal 2, @controller.adapt(5, 3, 2, 5)
+    assert_equal 1, @controller.adapt(1, 1, 1, 5)
+  end
+
+  def test_adapt_grows_when_requests_wait_on_io
+    stub_sample 0.05, 0.1
+    assert_equal 3, @controller.adapt(2, 2, 1, 16)
+    assert_equal 10, @controller.adapt(8, 8, 1, 16)
+    assert_equal 16, @controller.adapt(16, 16, 1, 16)
+
+    # the pool can still add threads up to max
+    assert_equal 8, @controller.adapt(8, 5, 1, 16)
+  end
+
+  def test_adapt_grows_up_to_threads_keeping_gvl_busy
+    stub_sample 0.05, 0.1, 3.2
+    assert_equal 5, @controller.adapt(4, 4, 1, 16)
+    assert_equal 5, @controller.adapt(5, 5, 1, 16)
+    assert_equal 8, @controller.adapt(8, 8, 1, 16)
+  end
+
+  def test_adapt_holds
+    stub_sample 0.005, 0.1
+    assert_equal 4, @controller.adapt(4, 4, 1, 16)
+
+
+    stub_sample nil, 0.0
+    assert_equal 4, @controller.adapt(4, 0, 1, 16)
+  end
+end
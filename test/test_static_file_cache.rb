@@ -0,0 +1,268 @@
+# frozen_string_literal: true
+
+require_relative "helper"
+
+require "puma/static_file_cache"
+require "puma/io_buffer"
+require "puma/puma_http11"
+require "fileutils"
+require "tmpdir"
+require "zlib"
+
+class TestStaticFileCache < PumaTest
+  parallelize_me!
+
+  def setup
+    @dir = Dir.mktmpdir
+    @path = File.join @dir, "app.css"
+    File.write @path, "body { color: red }"
+    @cache = Puma::StaticFileCache.new
+  end
+
+  def teardown
+    @cache.clear
+    FileUtils.rm_rf @dir
+  end
+
+  def env(uri = "/assets/app.css", **headers)
+    {
+      "REQUEST_METHOD" => "GET",
+      "REQUEST_PATH" => uri.split("?").first,
+      "REQUEST_URI" => uri,
+      "HTTP_HOST" => "test.com",
+    }.merge(headers.transform_keys { |k| "HTTP_#{k.upcase}" })
+  end
+
+  # what Puma::Response does for a cached file
+  def respond(req, headers = {})
+    entry = @cache.fetch req, @path
+    io_buffer = Puma::IOBuffer.new
+    @cache.write_headers req, entry, headers, io_buffer, false, false
+    [entry, io_buffer.read_and_reset]
+  end
+
+  def test_fetch
+    entry = @cache.fetch env, @path
+    assert_equal ["body { color: red }"], entry.body
+    assert entry.body.frozen? && entry.body[0].frozen?
+    assert_equal 19, entry.bytesize
+    mtime = File.mtime @path
+    assert_equal format('"%x-%x"', mtime.to_i, 19), entry.etag
+    assert_equal "W/#{entry.etag}", entry.weak_etag
+    assert_equal mtime.httpdate, entry.last_modified
+
+    assert_same entry, @cache.fetch(env, @path)
+    assert_equal 1, @cache.size
+    assert_equal 19, @cache.bytes
+  end
+
+  def test_fetch_skipped
+    assert_nil @cache.fetch(env, File.join(@dir, "missing.css"))
+    assert_nil @cache.fetch(env, @dir)
+
+    File.write @path, "x" * 101
+    small = Puma::StaticFileCache.new max_file_size: 100
+    assert_nil small.fetch(env, @path)
+
+    prefixed = Puma::StaticFileCache.new prefixes: ["/packs/"]
+    assert_nil prefixed.fetch(env, @path)
+    assert prefixed.fetch(env("/packs/app.css"), @path)
+  end
+
+  def test_eviction
+    paths = Array.new(3) { |i| File.join(@dir, "#{i}.js").tap { |fn| File.write fn, "#{i}" * 10 } }
+    cache = Puma::StaticFileCache.new max_entries: 2
+    paths.each { |fn| cache.fetch env, fn }
+    assert_equal 2, cache.size
+    assert_equal 20, cache.bytes
+
+    cache = Puma::StaticFileCache.new max_bytes: 25
+    paths.each { |fn| cache.fetch env, fn }
+    assert_equal 2, cache.size
+    cache.clear
+    assert_equal 0, cache.bytes
+  end
+
+  def test_changed_file_dropped
+    entry = @cache.fetch env, @path
+    File.write @path, "body { color: blue }"
+    # without inotify, files are checked once a second
+    entry.checked_at -= Puma::StaticFileCache::STAT_INTERVAL unless defined?(Puma::FileWatcher)
+
+    changed = @cache.fetch env, @path
+    refute_same entry, changed
+    assert_equal ["body { color: blue }"], changed.body
+    assert_equal 1, @cache.size
+  end
+
+  def test_write_headers
+    entry, lines = respond env
+    assert_equal "etag: #{entry.etag}\r\nlast-modified: #{entry.last_modified}\r\n", lines
+
+    io_buffer = Puma::IOBuffer.new
+    @cache.write_headers env, entry, {"ETag" => '"app"'}, io_buffer, true, false
+    assert_equal "last-modified: #{entry.last_modified}\r\n", io_buffer.read_and_reset
+
+    @cache.write_headers env, entry, {}, io_buffer, true, false
+    assert io_buffer.read_and_reset.start_with?("etag: #{entry.weak_etag}\r\n")
+  end
+
+  def test_not_modified
+    entry, _ = respond env, {"cache-control" => "public, max-age=31536000", "content-type" => "text/css"}
+
+    status, headers, body = @cache.not_modified env(if_none_match: entry.etag)
+    assert_equal 304, status
+    assert_equal [], body
+    assert_equal({
+      "cache-control" => "public, max-age=31536000",
+      "last-modified" => entry.last_modified,
+      "etag" => entry.etag,
+    }, headers)
+    assert headers.frozen?
+
+    assert_equal entry.weak_etag, @cache.not_modified(env(if_none_match: %("x", #{entry.weak_etag})))[1]["etag"]
+    assert_equal 304, @cache.not_modified(env(if_none_match: "*"))[0]
+    assert_equal 304, @cache.not_modified(env(if_modified_since: entry.last_modified))[0]
+    assert_equal 304, @cache.not_modified(env(if_modified_since: (entry.mtime + 60).httpdate))[0]
+
+    # If-Modified-Since is ignored with If-None-Match
+    assert_nil @cache.not_modified(env(if_none_match: '"other"', if_modified_since: entry.last_modified))
+    assert_nil @cache.not_modified(env(if_modified_since: (entry.mtime - 60).httpdate))
+    assert_nil @cache.not_modified(env(if_modified_since: "yesterday"))
+    assert_nil @cache.not_modified(env)
+    assert_nil @cache.not_modified(env(if_none_match: entry.etag).merge("REQUEST_METHOD" => "POST"))
+    # only URIs answered with the file
+    assert_nil @cache.not_modified(env("/assets/app.css?v=2", if_none_match: entry.etag))
+    assert_nil @cache.not_modified(env(if_none_match: entry.etag).merge("HTTP_HOST" => "other.com"))
+  end
+
+  def test_not_modified_app_validators
+    respond env, {"etag" => 'W/"app"', "last-modified" => "Tue, 01 Oct 2024 00:00:00 GMT"}
+
+    headers = @cache.not_modified(env(if_none_match: '"app"'))[1]
+    assert_equal 'W/"app"', headers["etag"]
+    assert_equal "Tue, 01 Oct 2024 00:00:00 GMT", headers["last-modified"]
+  end
+
+  def test_not_modified_encoded_app_etag
+    entry = @cache.fetch env, @path
+    @cache.write_headers env, entry, {"etag" => '"app"'}, Puma::IOBuffer.new, true, true
+
+    assert_equal 'W/"app"', @cache.not_modified(env(if_none_match: 'W/"app"'))[1]["etag"]
+    assert_equal '"app"', @cache.not_modified(env(if_none_match: '"app"'))[1]["etag"]
+  end
+
+  def test_not_modified_unshared_response
+    [
+      {"cache-control" => "private, max-age=60"},
+      {"cache-control" => "no-store"},
+      {"vary" => "accept-encoding, cookie"},
+      {"vary" => "*"},
+    ].each do |headers|
+      cache = Puma::StaticFileCache.new
+      entry = cache.fetch env, @path
+      cache.write_headers env, entry, headers, Puma::IOBuffer.new, false, false
+      assert_nil cache.not_modified(env(if_none_match: entry.etag)), headers.inspect
+      cache.clear
+    end
+
+    entry, _ = respond env, {"vary" => "Accept-Encoding"}
+    assert_equal 304, @cache.not_modified(env(if_none_match: entry.etag))[0]
+  end
+
+  def test_not_modified_credentials
+    entry, _ = respond env(authorization: "Basic dXNlcjpwYXNz")
+    assert_nil @cache.not_modified(env(if_none_match: entry.etag))
+    respond env(cookie: "session=1")
+    assert_nil @cache.not_modified(env(if_none_match: entry.etag))
+
+    respond env
+    assert_equal 304, @cache.not_modified(env(if_none_match: entry.etag))[0]
+    assert_nil @cache.not_modified(env(if_none_match: entry.etag, authorization: "Basic dXNlcjpwYXNz"))
+    assert_nil @cache.not_modified(env(if_none_match: entry.etag, cookie: "session=1"))
+  end
+
+  def test_not_modified_after_change
+    entry, _ = respond env
+    File.write @path, "body { color: blue }"
+    entry.checked_at -= Puma::StaticFileCache::STAT_INTERVAL unless defined?(Puma::FileWatcher)
+
+    assert_nil @cache.not_modified(env(if_none_match: entry.etag))
+  end
+
+  def test_variant
+    skip "Puma::Compressor isn't available" unless defined?(Puma::Compressor)
+    File.write @path, "body { color: red }\n" * 100
+    cache = Puma::StaticFileCache.new compression: Puma::Compression.new
+    entry = cache.fetch env, @path
+
+    encoding, body = cache.variant entry, "gzip"
+    assert_equal "gzip", encoding
+    assert_equal entry.body[0], Zlib.gunzip(body[0])
+    assert_same body, cache.variant(entry, "gzip")[1]
+    assert_equal entry.bytesize + body[0].bytesize, cache.bytes
+
+    assert_nil cache.variant(entry, "identity")
+    cache.clear
+  end
+
+  def test_variant_sibling
+    File.write "#{@path}.br", "brotli"
+    cache = Puma::StaticFileCache.new compression: Puma::Compression.new
+    entry = cache.fetch env, @path
+
+    assert_equal ["br", ["brotli"]], cache.variant(entry, "gzip, br")
+    File.write "#{@path}.br", "changed"
+    entry.checked_at -= Puma::StaticFileCache::STAT_INTERVAL unless defined?(Puma::FileWatcher)
+    refute_same entry, cache.fetch(env, @path)
+    cache.clear
+  end
+end
+
+class TestFileWatcher < PumaTest
+  parallelize_me!
+
+  def setup
+    skip "Puma::FileWatcher isn't available" unless defined?(Puma::FileWatcher)
+    @dir = Dir.mktmpdir
+    @watcher = Puma::FileWatcher.new
+  end
+
+  def teardown
+    @watcher&.close
+    FileUtils.rm_rf @dir if @dir
+  end
+
+  def test_changes
+    a = File.join(@dir, "a").tap { |fn| File.write fn, "a" }
+    b = File.join(@dir, "b").tap { |fn| File.write fn, "b" }
+    wd_a = @watcher.watch a
+    wd_b = @watcher.watch b
+    refute_equal wd_a, wd_b
+    assert_nil @watcher.changes
+
+    File.write a, "aa"
+    assert_equal [wd_a], @watcher.changes
+    assert_nil @watcher.changes
+
+    File.rename b, a
+    assert_equal [wd_a, wd_b].sort, @watcher.changes.sort
+  end
+
+  def test_unwatch
+    a = File.join(@dir, "a").tap { |fn| File.write fn, "a" }
+    wd = @watcher.watch a
+    @watcher.unwatch wd
+    @watcher.changes
+    File.write a, "aa"
+    assert_nil @watcher.changes
+    @watcher.unwatch wd
+  end
+
+  def test_errors
+    assert_raises(Errno::ENOENT) { @watcher.watch File.join(@dir, "missing") }
+    @watcher.close
+    assert_raises(IOError) { @watcher.changes }
+    @watcher.close
+  end
+end
@@ -12,13 +12,14 @@ class TestThreadPool < PumaTest
     @pool.shutdown(1) if defined?(@pool)
   end
 
-  def new_pool(min, max, max_io_threads: 0, pool_shutdown_grace_time: nil, &block)
+  def new_pool(min, max, max_io_threads: 0, pool_shutdown_grace_time: nil, adaptive_threads: nil, &block)
     block = proc { } unless block
     options = {
       min_threads: min,
       max_threads: max,
       max_io_threads: max_io_threads,
       pool_shutdown_grace_time: pool_shutdown_grace_time,
+      adaptive_threads: adaptive_threads,
     }
     @pool = Puma::ThreadPool.new("tst", options, &block)
   end
@@ -416,6 +417,143 @@ class TestThreadPool < PumaTest
     assert_equal 0, pool.backlog
   end
 
+  def test_counters_read_without_mutex
+    pool = new_pool(1, 2)
+    locked = Queue.new
+    release = Queue.new
+    holder = Thread.new { pool.with_mutex { locked << true; release.pop } }
+    locked.pop
+
+    counters = Thread.new { [pool.backlog, pool.backlog_max, pool.busy_threads, pool.pool_capacity] }
+    assert_equal [0, 0, 0, 2], counters.join(5)&.value
+  ensure
+    release << true
+    holder&.join
+  end
+
+  def test_wait_for_less_busy
+    release = Queue.new
+    pool = new_pool(0, 2) { release.pop }
+    pool << 1
+
+    t_st = Process.clock_gettime Process::CLOCK_MONOTONIC
+    pool.wait_for_less_busy 1, 0.05
+    assert_operator Process.clock_gettime(Process::CLOCK_MONOTONIC) - t_st, :>=, 0.04
+
+    waiter = Thread.new { pool.wait_for_less_busy 1, 10 }
+    sleep 0.05
+    release << true
+    assert waiter.join(5)
+
+    t_st = Process.clock_gettime Process::CLOCK_MONOTONIC
+    pool.wait_for_less_busy 1, 10
+    assert_operator Process.clock_gettime(Process::CLOCK_MONOTONIC) - t_st, :<, 1
+  end
+
+  def test_concat
+    release = Queue.new
+    done = Queue.new
+    pool = new_pool(0, 2) do |_, work|
+      release.pop
+      done << work
+    end
+
+    pool.concat [1, 2, 3]
+    assert_equal 2, pool.spawned
+
+    3.times { release << true }
+    assert_equal [1, 2, 3], Array.new(3) { done.pop }.sort
+  end
+
+  def test_adaptive_threads_records_queue_delay
+    skip "Puma::GVLMeter needs Ruby 3.3" unless Puma::QueueDelayController.available?
+
+    release = Queue.new
+    done = Queue.new
+    pool = new_pool(0, 1, adaptive_threads: 0.01) do |_, work|
+      release.pop
+      done << work
+    end
+
+    pool << 1
+    pool.concat [2, 3]
+    sleep 0.1
+    3.times { release << true }
+
+    assert_equal [1, 2, 3], Array.new(3) { done.pop }
+    assert_operator pool.queue_delay.sample[0], :>=, 0.05
+  end
+
+  def test_adapt_stops_threads_over_max_with_work_queued
+    skip "Puma::GVLMeter needs Ruby 3.3" unless Puma::QueueDelayController.available?
+
+    release = Queue.new
+    done = Queue.new
+    pool = new_pool(1, 4, adaptive_threads: 0.01) do |_, work|
+      release.pop
+      done << work
+    end
+    pool.queue_delay.define_singleton_method(:sample) { [0.0, 2.0] }
+
+    6.times { |i| pool << i }
+    assert_equal 4, pool.spawned
+
+    pool.adapt
+    assert_equal 2, pool.max
+    6.times { release << true }
+    assert_equal 6.times.to_a, Array.new(6) { done.pop }.sort
+    Timeout.timeout(1) { sleep 0.01 until pool.spawned == 2 }
+    assert_equal 2, pool.spawned
+
+    pool.queue_delay.define_singleton_method(:sample) { [1.0, 0.0] }
+    3.times { pool << 0 }
+    pool.adapt
+    assert_equal 3, pool.max
+    assert_equal 3, pool.spawned
+    3.times { release << true }
+  end
+
+  def test_adapt_floor_is_one_thread
+    skip "Puma::GVLMeter needs Ruby 3.3" unless Puma::QueueDelayController.available?
+
+    pool = new_pool(0, 2, adaptive_threads: 0.01)
+    pool.queue_delay.define_singleton_method(:sample) { [nil, 5.0] }
+
+    3.times { pool.adapt }
+    assert_equal 1, pool.max
+
+    pool.max = 3
+    assert_equal 3, pool.max
+  end
+
+  def test_stats_gvl_wait
+    pool = new_pool(3, 3) do
+      t_end = Process.clock_gettime(Process::CLOCK_MONOTONIC) + 0.3
+      nil while Process.clock_gettime(Process::CLOCK_MONOTONIC) < t_end
+    end
+    stats = pool.stats
+    assert_equal [0.0, 0.0], stats.values_at(:gvl_wait_time, :gvl_waiting) unless pool.gvl_meter
+
+    skip "Puma::GVLMeter needs Ruby 3.3" unless pool.gvl_meter
+    3.times { pool << 1 }
+    sleep 0.4
+
+    stats = pool.stats
+    assert_operator stats[:gvl_wait_time], :>, 0.1
+    assert_operator stats[:gvl_waiting], :>, 0.2
+    assert_operator pool.stats[:gvl_waiting], :<, 0.1
+  end
+
+  def test_all_work_done_with_backlog
+    done = Queue.new
+    pool = new_pool(8, 8) { |_, work| done << work }
+
+    2_000.times { |i| pool << i }
+    pool.shutdown(-1)
+
+    assert_equal 2_000.times.to_a, Array.new(done.size) { done.pop }.sort
+  end
+
   def test_pool_capacity_never_negative
     pool = mutex_pool(5,5) do
       th = Thread.current
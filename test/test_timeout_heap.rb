@@ -0,0 +1,93 @@
+# frozen_string_literal: true
+
+require_relative "helper"
+
+require "puma/timeout_heap"
+
+class TestTimeoutHeap < PumaTest
+  parallelize_me!
+
+  Client = Struct.new :timeout_at
+
+  def setup
+    @heap = Puma::TimeoutHeap.new
+  end
+
+  def test_empty
+    assert @heap.empty?
+    assert_nil @heap.next_timeout_at
+    assert_equal [], @heap.pop_expired(100)
+  end
+
+  def test_pop_expired_in_order
+    clients = [5, 3, 9, 1, 7, 3].map { |t| Client.new t }
+    clients.each { |c| @heap.add c }
+
+    assert_equal 6, @heap.size
+    assert_equal 1, @heap.next_timeout_at
+    assert_equal [1, 3, 3, 5], @heap.pop_expired(6).map(&:timeout_at)
+    assert_equal 7, @heap.next_timeout_at
+    assert_equal 2, @heap.size
+  end
+
+  def test_random_order
+    times = Array.new(1_000) { rand }
+    times.each { |t| @heap.add Client.new(t) }
+
+    assert_equal times.sort, @heap.pop_expired(1).map(&:timeout_at)
+    assert @heap.empty?
+  end
+
+  def test_delete
+    a, b, c = Client.new(1), Client.new(2), Client.new(3)
+    [a, b, c].each { |cl| @heap.add cl }
+
+    assert_same a, @heap.delete(a)
+    assert_nil @heap.delete(a)
+    refute @heap.include?(a)
+    assert_equal 2, @heap.size
+    assert_equal 2, @heap.next_timeout_at
+    assert_equal [b, c], @heap.pop_expired(3)
+  end
+
+  def test_readd_after_delete
+    a = Client.new 1
+    @heap.add a
+    @heap.delete a
+    a.timeout_at = 5
+    @heap.add a
+
+    assert_equal [], @heap.pop_expired(4)
+    assert_equal [a], @heap.pop_expired(5)
+  end
+
+  def test_timeout_moved_later
+    a, b = Client.new(1), Client.new(2)
+    @heap.add a
+    @heap.add b
+    a.timeout_at = 3
+
+    assert_equal [b], @heap.pop_expired(2)
+    assert @heap.include?(a)
+    assert_equal 3, @heap.next_timeout_at
+    assert_equal [a], @heap.pop_expired(3)
+  end
+
+  def test_stale_entries_are_compacted
+    clients = Array.new(100) { |i| Client.new i }
+    1_000.times do
+      clients.each { |c| @heap.delete c; @heap.add c }
+    end
+
+    assert_operator @heap.instance_variable_get(:@heap).length, :<=, 2 * 100 + 64
+    assert_equal clients, @heap.pop_expired(100)
+  end
+
+  def test_each
+    clients = [3, 1, 2].map { |t| Client.new t }
+    clients.each { |c| @heap.add c }
+    @heap.delete clients[0]
+
+    assert_equal clients[1..2].sort_by(&:timeout_at), @heap.to_enum(:each).sort_by(&:timeout_at)
+  end
+end